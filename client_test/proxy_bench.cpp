@@ -0,0 +1,162 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Throughput and latency of classify requests through jubaclassifier_proxy.
+//
+// Run it against a proxy started with and without --io_threads to compare
+// the event loop per RPC thread with the shared one.  If the proxy runs on
+// this host, set PROXY_PID to also report its threads and sockets.
+//
+//   proxy_bench [clients (16)] [seconds (10)] [batch size (1)]
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <jubatus/client/classifier_client.hpp>
+#include "util.hpp"
+
+using std::string;
+using std::vector;
+using jubatus::classifier::client::classifier;
+
+namespace {
+
+double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct worker {
+  double deadline;
+  size_t batch;
+  vector<double> latencies;
+  size_t errors;
+};
+
+void* run_worker(void* arg) {
+  worker* w = static_cast<worker*>(arg);
+  classifier cli(host(), port(), cluster_name(), timeout());
+
+  vector<jubatus::client::common::datum> data(w->batch);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i].add_number("x", static_cast<double>(i));
+  }
+
+  while (now() < w->deadline) {
+    const double start = now();
+    try {
+      cli.classify(data);
+      w->latencies.push_back(now() - start);
+    } catch (const std::exception&) {
+      ++w->errors;
+    }
+  }
+  return NULL;
+}
+
+double percentile(const vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min(sorted.size() - 1,
+                         static_cast<size_t>(sorted.size() * p / 100))];
+}
+
+// prints threads and sockets of the proxy process
+void print_proxy_resources(const string& pid) {
+  std::ifstream status(("/proc/" + pid + "/status").c_str());
+  string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 8, "Threads:") == 0) {
+      std::cout << "proxy " << line << std::endl;
+    }
+  }
+
+  const string fd_dir = "/proc/" + pid + "/fd";
+  DIR* dir = opendir(fd_dir.c_str());
+  if (!dir) {
+    return;
+  }
+  size_t sockets = 0;
+  while (struct dirent* e = readdir(dir)) {
+    char target[256];
+    const string path = fd_dir + "/" + e->d_name;
+    const ssize_t len = readlink(path.c_str(), target, sizeof(target) - 1);
+    if (len > 0) {
+      target[len] = '\0';
+      if (string(target).compare(0, 7, "socket:") == 0) {
+        ++sockets;
+      }
+    }
+  }
+  closedir(dir);
+  std::cout << "proxy Sockets:\t" << sockets << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const size_t clients = argc > 1 ? std::strtoul(argv[1], NULL, 0) : 16;
+  const double seconds = argc > 2 ? std::strtod(argv[2], NULL) : 10;
+  const size_t batch = argc > 3 ? std::strtoul(argv[3], NULL, 0) : 1;
+
+  vector<worker> workers(clients);
+  vector<pthread_t> threads(clients);
+  const double start = now();
+  for (size_t i = 0; i < clients; ++i) {
+    workers[i].deadline = start + seconds;
+    workers[i].batch = batch;
+    workers[i].errors = 0;
+    pthread_create(&threads[i], NULL, &run_worker, &workers[i]);
+  }
+
+  // resources are measured while all clients are connected
+  if (const char* pid = std::getenv("PROXY_PID")) {
+    sleep(1);
+    print_proxy_resources(pid);
+  }
+
+  vector<double> latencies;
+  size_t errors = 0;
+  for (size_t i = 0; i < clients; ++i) {
+    pthread_join(threads[i], NULL);
+    latencies.insert(latencies.end(), workers[i].latencies.begin(),
+                     workers[i].latencies.end());
+    errors += workers[i].errors;
+  }
+  const double elapsed = now() - start;
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("clients %zu, batch %zu, %.1f sec\n", clients, batch, elapsed);
+  std::printf("requests %zu (errors %zu), %.1f req/sec\n",
+              latencies.size(), errors, latencies.size() / elapsed);
+  std::printf("latency msec: p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+              percentile(latencies, 50) * 1e3,
+              percentile(latencies, 95) * 1e3,
+              percentile(latencies, 99) * 1e3,
+              latencies.empty() ? 0 : latencies.back() * 1e3);
+  return 0;
+}
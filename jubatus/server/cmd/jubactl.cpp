@@ -14,6 +14,9 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
+#include <iomanip>
+#include <map>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -24,6 +27,7 @@
 
 #include "jubatus/core/common/exception.hpp"
 #include "../third_party/cmdline/cmdline.h"
+#include "../common/cht.hpp"
 #include "../common/zk.hpp"
 #include "../common/membership.hpp"
 #include "../common/logger/logger.hpp"
@@ -51,6 +55,10 @@ void send2server(
     const string& id,
     const string& zkhosts);
 void status(const string& type, const string& name, const string& zkhosts);
+void show_cht(
+    jubatus::server::common::lock_service& z,
+    const string& type,
+    const string& name);
 
 int main(int argc, char** argv)
 try {
@@ -96,6 +104,32 @@ try {
       "[start] zookeeper time out (sec)", false, 10);
   p.add<int>("interconnect_timeout", 'R',
       "[start] interconnect time out between servers (sec)", false, 10);
+  p.add<int>("mixer_fanout", '\0',
+      "[start] fan-out of the mix tree (tree_mixer only)", false, 4);
+  p.add<std::string>("mix_compression", '\0',
+      "[start] compression of MIX payloads (none, lz4, zstd[:level])",
+      false, "none");
+  p.add<std::string>("mix_quantization", '\0',
+      "[start] lossy quantization of diffs (none, fp16, int8)", false, "none");
+  p.add<double>("mix_sparsify_threshold", '\0',
+      "[start] zero diff values smaller than this in magnitude", false, 0.0);
+  p.add<int>("mix_sparsify_top_k", '\0',
+      "[start] send only this many diff values of the largest magnitude",
+      false, 0);
+  p.add<int>("coalesce_window", '\0',
+      "[start] time to gather concurrent train requests (msec)", false, 0);
+  p.add<int>("coalesce_max_batch", '\0',
+      "[start] maximum number of train requests gathered", false, 16);
+  p.add<int>("batch_threads", '\0',
+      "[start] worker threads to split large batches", false, 0);
+  p.add<int>("batch_min_split", '\0',
+      "[start] minimum number of data in a batch to split it", false, 64);
+  p.add<int>("cht_weight", '\0',
+      "[start] share of keys of the server in the consistent hash ring "
+      "(0: from CPU cores and memory of each server)", false, 1);
+  p.add<int>("rebalance_rate", '\0',
+      "[start] rows per second to move when CHT members change "
+      "(0: disabled)", false, 0);
 
   p.add("debug", 'd', "debug mode (obsolete)");
 
@@ -212,6 +246,19 @@ void send2supervisor(
     server_option.interval_count = argv.get<int>("interval_count");
     server_option.zookeeper_timeout = argv.get<int>("zookeeper_timeout");
     server_option.interconnect_timeout = argv.get<int>("interconnect_timeout");
+    server_option.mixer_fanout = argv.get<int>("mixer_fanout");
+    server_option.mix_compression = argv.get<std::string>("mix_compression");
+    server_option.mix_quantization =
+        argv.get<std::string>("mix_quantization");
+    server_option.mix_sparsify_threshold =
+        argv.get<double>("mix_sparsify_threshold");
+    server_option.mix_sparsify_top_k = argv.get<int>("mix_sparsify_top_k");
+    server_option.coalesce_window = argv.get<int>("coalesce_window");
+    server_option.coalesce_max_batch = argv.get<int>("coalesce_max_batch");
+    server_option.batch_threads = argv.get<int>("batch_threads");
+    server_option.batch_min_split = argv.get<int>("batch_min_split");
+    server_option.cht_weight = argv.get<int>("cht_weight");
+    server_option.rebalance_rate = argv.get<int>("rebalance_rate");
   }
 
   ls_->list(jubatus::server::common::JUBAVISOR_BASE_PATH, list);
@@ -303,4 +350,42 @@ void status(const string& type, const string& name, const string& zkhosts) {
   std::string path;
   jubatus::server::common::build_actor_path(path, type, name);
   show(*ls_, path + "/nodes", name);
+  show_cht(*ls_, type, name);
+}
+
+// shows how many keys each server owns as the first node of the CHT
+void show_cht(
+    jubatus::server::common::lock_service& z,
+    const string& type,
+    const string& name) {
+  typedef jubatus::server::common::cht_ring cht_ring;
+  jubatus::util::lang::shared_ptr<const cht_ring> ring;
+  try {
+    ring = cht_ring::load(z, type, name);
+  } catch (const jubatus::core::common::exception::jubatus_exception&) {
+    // the server does not use CHT
+    return;
+  }
+
+  std::map<cht_ring::node_type, cht_ring::node_share> shares;
+  ring->get_shares(shares);
+  cout << "\033[34mCHT key share of " << name << ":\033[0m" << endl;
+  double max_share = 0;
+  for (std::map<cht_ring::node_type, cht_ring::node_share>::const_iterator
+           it = shares.begin(); it != shares.end(); ++it) {
+    const cht_ring::node_share& s = it->second;
+    // weight is the number of virtual nodes for each unit of it
+    const double weight =
+        static_cast<double>(s.vnodes) / jubatus::server::common::NUM_VSERV;
+    cout << it->first.first << "_" << it->first.second
+         << "\tweight " << weight
+         << "\tshare " << std::fixed << std::setprecision(2)
+         << s.share * 100 << "%" << endl;
+    cout.unsetf(std::ios::fixed);
+    max_share = std::max(max_share, s.share / s.vnodes);
+  }
+  // the most loaded server compared with the ideal share for its weight
+  cout << "imbalance: " << std::fixed << std::setprecision(2)
+       << max_share * ring->size() << endl;
+  cout.unsetf(std::ios::fixed);
 }
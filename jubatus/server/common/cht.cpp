@@ -18,16 +18,25 @@
 
 #include <stdlib.h>
 #include <algorithm>
+#include <map>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
 #include "jubatus/util/data/digest/md5.h"
+#include "jubatus/util/lang/bind.h"
 #include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/util/lang/weak_ptr.h"
 #include "jubatus/core/common/exception.hpp"
+#include "cached_zk.hpp"
 #include "membership.hpp"
 #include "logger/logger.hpp"
 
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::shared_ptr;
+using jubatus::util::lang::weak_ptr;
 
 namespace jubatus {
 namespace server {
@@ -73,15 +82,31 @@ cht::~cht() {
 }
 
 // register_node :: node -> bool;
-// creates /jubatus/actors/<name>/cht/<hash(ip_port)> with contents ip_port
-void cht::register_node(const std::string& ip, int port) {
+// creates /jubatus/actors/<name>/cht/<hash(ip_port_i)> with contents ip_port
+void cht::register_node(const std::string& ip, int port, unsigned int weight) {
   std::string path;
   build_actor_path(path, type_, name_);
   path += "/cht";
 
-  for (unsigned int i = 0; i < NUM_VSERV; ++i) {
+  const std::string loc = build_loc_str(ip, port);
+
+  // virtual nodes registered before (e.g. with the previous weight, or by
+  // the previous process whose session has not expired yet) are replaced
+  std::vector<std::string> list;
+  lock_service_->list(path, list);
+  for (size_t i = 0; i < list.size(); ++i) {
+    std::string entry_loc;
+    if (lock_service_->read(path + "/" + list[i], entry_loc)
+        && entry_loc == loc && lock_service_->remove(path + "/" + list[i])) {
+      DLOG(INFO) << "cht node removed: " << path + "/" + list[i];
+    }
+  }
+
+  // i-th virtual node has the same hash regardless of the weight
+  const unsigned int num_vserv = NUM_VSERV * std::max(weight, 1u);
+  for (unsigned int i = 0; i < num_vserv; ++i) {
     std::string hashpath = path + "/" + make_hash(build_loc_str(ip, port, i));
-    if (!lock_service_->create(hashpath, build_loc_str(ip, port), true)) {
+    if (!lock_service_->create(hashpath, loc, true)) {
       throw JUBATUS_EXCEPTION(
         core::common::exception::runtime_error("Failed to register cht node")
         << core::common::exception::error_api_func("lock_service::create")
@@ -109,59 +134,273 @@ bool cht::find(
     std::vector<std::pair<std::string, int> >& out,
     size_t n) {
   out.clear();
-  std::vector<std::string> hlist;
-  if (!get_hashlist_(key, hlist)) {
-    throw JUBATUS_EXCEPTION(core::common::not_found(
-        "failed to fetch list of CHT entry: " + key));
-  }
-  std::string hash = make_hash(key);
+  cht_ring::load(*lock_service_, type_, name_)->find(key, out, n);
+  return !out.empty();
+}
+
+shared_ptr<const cht_ring> cht_ring::load(
+    lock_service& ls,
+    const std::string& type,
+    const std::string& name) {
   std::string path;
-  build_actor_path(path, type_, name_);
+  build_actor_path(path, type, name);
   path += "/cht";
 
-  std::vector<std::string>::iterator node0 = std::lower_bound(hlist.begin(),
-                                                              hlist.end(),
-                                                              hash);
+  std::vector<std::string> hlist;
+  if (!ls.list(path, hlist) || hlist.empty()) {
+    throw JUBATUS_EXCEPTION(core::common::not_found(
+        "failed to fetch list of CHT entry: " + path));
+  }
 
-  size_t idx = static_cast<int>(node0 - hlist.begin()) % hlist.size();
-  std::string loc;
-  for (size_t i = 0; i < n; ++i) {
-    std::string ip;
-    int port;
-    if (lock_service_->read(path + "/" + hlist[idx], loc)) {
-      revert(loc, ip, port);
-      out.push_back(make_pair(ip, port));
-    } else {
-      // TODO(kuenishi): output log
+  std::vector<std::pair<std::string, std::string> > entries;
+  entries.reserve(hlist.size());
+  for (size_t i = 0; i < hlist.size(); ++i) {
+    std::string loc;
+    if (!ls.read(path + "/" + hlist[i], loc)) {
       throw JUBATUS_EXCEPTION(core::common::not_found(
-          "failed to read CHT entry: " + path));
+          "failed to read CHT entry: " + path + "/" + hlist[i]));
     }
-    idx++;
-    idx %= hlist.size();
+    entries.push_back(std::make_pair(hlist[i], loc));
+  }
+  return shared_ptr<const cht_ring>(new cht_ring(entries));
+}
+
+cht_ring::cht_ring(
+    const std::vector<std::pair<std::string, std::string> >& entries) {
+  std::vector<std::pair<hash_value, node_type> > ring;
+  ring.reserve(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    hash_value h;
+    node_type node;
+    if (!parse_hash(entries[i].first, h)
+        || !revert(entries[i].second, node.first, node.second)) {
+      LOG(WARNING) << "ignoring malformed CHT entry: "
+                   << entries[i].first << " (" << entries[i].second << ")";
+      continue;
+    }
+    ring.push_back(std::make_pair(h, node));
+  }
+  std::sort(ring.begin(), ring.end());
+
+  hashes_.reserve(ring.size());
+  nodes_.reserve(ring.size());
+  for (size_t i = 0; i < ring.size(); ++i) {
+    hashes_.push_back(ring[i].first);
+    nodes_.push_back(ring[i].second);
   }
-  return !hlist.size();
 }
 
-/**
- * Get list of CHT entries in my cluster.
- * Returns true when succeed to fetch one or more CHT entries.
- */
-bool cht::get_hashlist_(
+void cht_ring::get_shares(std::map<node_type, node_share>& out) const {
+  out.clear();
+  for (size_t i = 0; i < hashes_.size(); ++i) {
+    // keys between the previous hash and this one belong to this node
+    const double prev = position(hashes_[i == 0 ? hashes_.size() - 1 : i - 1]);
+    double share = position(hashes_[i]) - prev;
+    if (share <= 0) {
+      share += 1.0;
+    }
+    node_share& s = out[nodes_[i]];
+    ++s.vnodes;
+    s.share += share;
+  }
+}
+
+void cht_ring::find(
     const std::string& key,
-    std::vector<std::string>& hlist) {
-  hlist.clear();
-  std::string path;
-  build_actor_path(path, type_, name_);
-  path += "/cht";
+    std::vector<node_type>& out,
+    size_t n) const {
+  out.clear();
+  if (hashes_.empty()) {
+    return;
+  }
 
-  if (!lock_service_->list(path, hlist) || hlist.empty()) {
-    return false;
+  hash_value hash;
+  parse_hash(make_hash(key), hash);
+  size_t idx = std::lower_bound(hashes_.begin(), hashes_.end(), hash)
+      - hashes_.begin();
+  for (size_t i = 0; i < n; ++i) {
+    idx %= hashes_.size();
+    out.push_back(nodes_[idx]);
+    ++idx;
   }
+}
 
-  std::sort(hlist.begin(), hlist.end());
+// hashes are 32 digits of hex, so comparing them as 128-bit integers gives
+// the same order as comparing the strings
+bool cht_ring::parse_hash(const std::string& hex, hash_value& out) {
+  if (hex.size() != 32) {
+    return false;
+  }
+  uint64_t v[2] = { 0, 0 };
+  for (size_t i = 0; i < hex.size(); ++i) {
+    const char c = hex[i];
+    uint64_t d;
+    if ('0' <= c && c <= '9') {
+      d = c - '0';
+    } else if ('a' <= c && c <= 'f') {
+      d = c - 'a' + 10;
+    } else if ('A' <= c && c <= 'F') {
+      d = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    v[i / 16] = (v[i / 16] << 4) | d;
+  }
+  out.high = v[0];
+  out.low = v[1];
   return true;
 }
 
+double cht_ring::position(const hash_value& h) {
+  return (h.high + h.low / 18446744073709551616.0) / 18446744073709551616.0;
+}
+
+class cached_cht::state {
+ public:
+  state(
+      shared_ptr<lock_service> ls,
+      const std::string& type,
+      const std::string& name)
+      : lock_service_(ls),
+        type_(type),
+        name_(name),
+        watching_(false) {
+    build_actor_path(path_, type, name);
+    path_ += "/cht";
+  }
+
+  void set_self(const weak_ptr<state>& self) {
+    self_ = self;
+  }
+
+  shared_ptr<const cht_ring> get() {
+    {
+      scoped_lock lk(m_);
+      if (ring_ && watching_) {
+        return ring_;
+      }
+    }
+
+    refresh(false);
+
+    scoped_lock lk(m_);
+    if (!ring_) {
+      throw JUBATUS_EXCEPTION(core::common::not_found(
+          "failed to fetch list of CHT entry: " + path_));
+    }
+    return ring_;
+  }
+
+  static void on_event(
+      weak_ptr<state> w,
+      int type,
+      int zk_state,
+      const std::string& path) {
+    shared_ptr<state> s = w.lock();
+    if (!s) {
+      // cached_cht has been destructed; stop watching
+      return;
+    }
+    DLOG(INFO) << "CHT watcher got event (" << type << "): " << path;
+    {
+      scoped_lock lk(s->m_);
+      s->watching_ = false;
+    }
+    s->refresh(true);
+  }
+
+  void refresh(bool force) {
+    scoped_lock update_lk(update_m_);
+    bool watching;
+    {
+      scoped_lock lk(m_);
+      if (!force && ring_ && watching_) {
+        // refreshed by another thread
+        return;
+      }
+      watching = watching_;
+    }
+
+    // set the watcher before listing, not to miss changes in between
+    bool bound = false;
+    if (!watching) {
+      bound = lock_service_->bind_child_watcher(path_,
+          jubatus::util::lang::bind(&state::on_event, self_,
+              jubatus::util::lang::_1, jubatus::util::lang::_2,
+              jubatus::util::lang::_3));
+    }
+
+    // the list cache of cached_zk may be reloaded after this watcher is
+    // called for the same event
+    if (cached_zk* czk = dynamic_cast<cached_zk*>(lock_service_.get())) {
+      czk->reload_cache(path_);
+    }
+
+    shared_ptr<const cht_ring> ring;
+    try {
+      ring = cht_ring::load(*lock_service_, type_, name_);
+    } catch (const core::common::exception::jubatus_exception& e) {
+      LOG(WARNING) << "failed to load CHT: " << e.what();
+    }
+
+    scoped_lock lk(m_);
+    if (bound) {
+      watching_ = true;
+    }
+    if (ring) {
+      ring_ = ring;
+    }
+  }
+
+ private:
+  const shared_ptr<lock_service> lock_service_;
+  const std::string type_;
+  const std::string name_;
+  std::string path_;
+  weak_ptr<state> self_;
+
+  jubatus::util::concurrent::mutex update_m_;
+  jubatus::util::concurrent::mutex m_;
+  shared_ptr<const cht_ring> ring_;
+  bool watching_;
+};
+
+cached_cht::cached_cht(
+    shared_ptr<lock_service> ls,
+    const std::string& type,
+    const std::string& name)
+    : state_(new state(ls, type, name)) {
+  state_->set_self(state_);
+}
+
+cached_cht::~cached_cht() {
+}
+
+shared_ptr<const cht_ring> cached_cht::get_ring() {
+  return state_->get();
+}
+
+void cached_cht::reload() {
+  state_->refresh(true);
+}
+
+bool cached_cht::find(
+    const std::string& host,
+    int port,
+    std::vector<std::pair<std::string, int> >& out,
+    size_t s) {
+  return find(build_loc_str(host, port), out, s);
+}
+
+bool cached_cht::find(
+    const std::string& key,
+    std::vector<std::pair<std::string, int> >& out,
+    size_t n) {
+  out.clear();
+  get_ring()->find(key, out, n);
+  return !out.empty();
+}
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
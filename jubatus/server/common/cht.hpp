@@ -17,6 +17,7 @@
 #ifndef JUBATUS_SERVER_COMMON_CHT_HPP_
 #define JUBATUS_SERVER_COMMON_CHT_HPP_
 
+#include <stdint.h>
 #include <cstdlib>
 #include <string>
 #include <utility>
@@ -24,6 +25,7 @@
 #include <map>
 
 #include "jubatus/util/lang/cast.h"
+#include "jubatus/util/lang/noncopyable.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "lock_service.hpp"
@@ -33,10 +35,69 @@ namespace server {
 namespace common {
 
 // TODO(kashihara): Is the value reasonable for cht?
+// virtual nodes of a server for each unit of its weight
 static const unsigned int NUM_VSERV = 8;
 
 std::string make_hash(const std::string& key);
 
+/**
+ * Immutable snapshot of the entries in <name>/cht, sorted by their hashes.
+ */
+class cht_ring {
+ public:
+  typedef std::pair<std::string, int> node_type;
+
+  // loads all entries from the lock service
+  static jubatus::util::lang::shared_ptr<const cht_ring> load(
+      lock_service& ls,
+      const std::string& type,
+      const std::string& name);
+
+  struct node_share {
+    node_share()
+        : vnodes(0),
+          share(0) {
+    }
+
+    size_t vnodes;
+    double share;  // fraction of keys of which the node is the first one
+  };
+
+  // entries are pairs of hash and location (ip_port)
+  explicit cht_ring(
+      const std::vector<std::pair<std::string, std::string> >& entries);
+
+  size_t size() const {
+    return hashes_.size();
+  }
+
+  void get_shares(std::map<node_type, node_share>& out) const;
+
+  // find(hash) :: key -> [node]
+  //   where  hash(node0) <= hash(key) < hash(node1) < hash(node2) < ...
+  void find(
+      const std::string& key,
+      std::vector<node_type>& out,
+      size_t n) const;
+
+ private:
+  struct hash_value {
+    uint64_t high;
+    uint64_t low;
+
+    bool operator<(const hash_value& v) const {
+      return high < v.high || (high == v.high && low < v.low);
+    }
+  };
+
+  static bool parse_hash(const std::string& hex, hash_value& out);
+  // position of the hash in the ring, in [0, 1)
+  static double position(const hash_value& h);
+
+  std::vector<hash_value> hashes_;
+  std::vector<node_type> nodes_;
+};
+
 class cht {
  public:
   // run just once in starting up the process: creates <name>/cht directory.
@@ -54,7 +115,10 @@ class cht {
 
   // node :: ip_port
   // register_node :: node -> bool;
-  void register_node(const std::string&, int);
+  // registers NUM_VSERV * weight virtual nodes.  Registering the node
+  // again changes its weight: virtual nodes are added or removed, so only
+  // keys of those virtual nodes move to or from other servers.
+  void register_node(const std::string&, int, unsigned int weight = 1);
 
   template<typename T>
   bool find(
@@ -79,13 +143,58 @@ class cht {
       size_t);
 
  private:
-  bool get_hashlist_(const std::string& key, std::vector<std::string>&);
-
   const std::string type_;
   const std::string name_;
   jubatus::util::lang::shared_ptr<lock_service> lock_service_;
 };
 
+/**
+ * CHT which keeps the ring in memory.
+ *
+ * The ring is loaded on the first lookup and reloaded by a child watcher of
+ * <name>/cht, so lookups need no access to the lock service as long as the
+ * watcher is alive.  The directory need not exist at construction.
+ */
+class cached_cht : jubatus::util::lang::noncopyable {
+ public:
+  cached_cht(
+      jubatus::util::lang::shared_ptr<lock_service>,
+      const std::string& type,
+      const std::string& name);
+
+  ~cached_cht();
+
+  template<typename T>
+  bool find(
+      const T& t,
+      std::vector<std::pair<std::string, int> >& ret,
+      size_t s) {
+    std::string k = jubatus::util::lang::lexical_cast<std::string>(t);
+    return find(k, ret, s);
+  }
+
+  bool find(
+      const std::string& host,
+      int port,
+      std::vector<std::pair<std::string, int> >&,
+      size_t);
+
+  bool find(
+      const std::string&,
+      std::vector<std::pair<std::string, int> >&,
+      size_t);
+
+  // current snapshot of the ring
+  jubatus::util::lang::shared_ptr<const cht_ring> get_ring();
+
+  // reloads the ring now, e.g. when other membership has changed
+  void reload();
+
+ private:
+  class state;
+  jubatus::util::lang::shared_ptr<state> state_;
+};
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
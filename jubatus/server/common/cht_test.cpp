@@ -14,11 +14,20 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 #include <gtest/gtest.h>
+#include "jubatus/util/lang/cast.h"
 #include "cht.hpp"
+#include "membership.hpp"
 
+using std::make_pair;
+using std::pair;
 using std::string;
+using std::vector;
 
 namespace jubatus {
 namespace server {
@@ -32,6 +41,116 @@ TEST(cht, make_hash) {
   ASSERT_NE(hash, hash3);
 }
 
+namespace {
+
+typedef vector<pair<string, string> > entries_t;
+
+entries_t make_entries(size_t servers) {
+  entries_t entries;
+  for (size_t s = 0; s < servers; ++s) {
+    const int port = 9199 + static_cast<int>(s);
+    for (unsigned int i = 0; i < NUM_VSERV; ++i) {
+      entries.push_back(make_pair(
+          make_hash(build_loc_str("192.168.0.1", port, i)),
+          build_loc_str("192.168.0.1", port)));
+    }
+  }
+  return entries;
+}
+
+// the algorithm of the string-based ring of older versions
+vector<pair<string, int> > find_by_strings(
+    entries_t entries,
+    const string& key,
+    size_t n) {
+  std::sort(entries.begin(), entries.end());
+  vector<string> hlist;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    hlist.push_back(entries[i].first);
+  }
+  size_t idx = std::lower_bound(hlist.begin(), hlist.end(), make_hash(key))
+      - hlist.begin();
+  vector<pair<string, int> > ret;
+  for (size_t i = 0; i < n; ++i) {
+    idx %= hlist.size();
+    string ip;
+    int port;
+    revert(entries[idx].second, ip, port);
+    ret.push_back(make_pair(ip, port));
+    ++idx;
+  }
+  return ret;
+}
+
+}  // namespace
+
+TEST(cht_ring, same_as_string_order) {
+  const entries_t entries = make_entries(5);
+  cht_ring ring(entries);
+  ASSERT_EQ(entries.size(), ring.size());
+
+  for (int k = 0; k < 1000; ++k) {
+    const string key = "key" + jubatus::util::lang::lexical_cast<string>(k);
+    vector<pair<string, int> > out;
+    ring.find(key, out, 2);
+    EXPECT_EQ(find_by_strings(entries, key, 2), out) << key;
+  }
+}
+
+TEST(cht_ring, empty) {
+  cht_ring ring((entries_t()));
+  vector<pair<string, int> > out;
+  ring.find("key", out, 2);
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(cht_ring, ignores_malformed_entry) {
+  entries_t entries = make_entries(1);
+  entries.push_back(make_pair("not_a_hash", "192.168.0.1_9200"));
+  cht_ring ring(entries);
+  EXPECT_EQ(NUM_VSERV, ring.size());
+
+  vector<pair<string, int> > out;
+  ring.find("key", out, 3);
+  ASSERT_EQ(3u, out.size());
+  for (size_t i = 0; i < out.size(); ++i) {
+    EXPECT_EQ(9199, out[i].second);
+  }
+}
+
+TEST(cht_ring, shares) {
+  // the second server has the weight of 4
+  entries_t entries = make_entries(2);
+  for (unsigned int i = NUM_VSERV; i < NUM_VSERV * 4; ++i) {
+    entries.push_back(make_pair(
+        make_hash(build_loc_str("192.168.0.1", 9200, i)),
+        build_loc_str("192.168.0.1", 9200)));
+  }
+  cht_ring ring(entries);
+
+  std::map<cht_ring::node_type, cht_ring::node_share> shares;
+  ring.get_shares(shares);
+  ASSERT_EQ(2u, shares.size());
+  const cht_ring::node_share& s1 = shares[make_pair("192.168.0.1", 9199)];
+  const cht_ring::node_share& s2 = shares[make_pair("192.168.0.1", 9200)];
+  EXPECT_EQ(NUM_VSERV, s1.vnodes);
+  EXPECT_EQ(NUM_VSERV * 4, s2.vnodes);
+  EXPECT_DOUBLE_EQ(1.0, s1.share + s2.share);
+  EXPECT_LT(s1.share, s2.share);
+
+  // shares are fractions of keys
+  const int keys = 10000;
+  int found = 0;
+  for (int k = 0; k < keys; ++k) {
+    vector<pair<string, int> > out;
+    ring.find("key" + jubatus::util::lang::lexical_cast<string>(k), out, 1);
+    if (out[0].second == 9199) {
+      ++found;
+    }
+  }
+  EXPECT_NEAR(s1.share, static_cast<double>(found) / keys, 0.02);
+}
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
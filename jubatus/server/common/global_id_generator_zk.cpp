@@ -14,22 +14,66 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
+#include <exception>
+#include <limits>
 #include <string>
 
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/bind.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "jubatus/core/common/exception.hpp"
 #include "global_id_generator_base.hpp"
 #include "global_id_generator_zk.hpp"
+#include "logger/logger.hpp"
+
+using jubatus::util::concurrent::scoped_lock;
 
 namespace jubatus {
 namespace server {
 namespace common {
 
-global_id_generator_zk::global_id_generator_zk() {
+namespace {
+
+// one write to ZooKeeper for this number of IDs
+const uint64_t ID_BLOCK_SIZE = 10000;
+
+// blocks below the minimum ID are leased one by one up to this number,
+// and the prefix is advanced to skip more
+const uint64_t MAX_SKIPPED_BLOCKS = 16;
+
+// the version of a ZooKeeper node, returned by create_id, is 32 bits
+const int PREFIX_SHIFT = 32;
+
+}  // namespace
+
+global_id_generator_zk::global_id_generator_zk()
+    : block_size_(ID_BLOCK_SIZE),
+      next_(0),
+      end_(0),
+      min_id_(0),
+      prefix_(0),
+      prefetching_(false),
+      has_prefetched_(false),
+      prefetched_(0) {
+}
+
+global_id_generator_zk::global_id_generator_zk(uint64_t block_size)
+    : block_size_(std::max<uint64_t>(block_size, 1)),
+      next_(0),
+      end_(0),
+      min_id_(0),
+      prefix_(0),
+      prefetching_(false),
+      has_prefetched_(false),
+      prefetched_(0) {
 }
 
 global_id_generator_zk::~global_id_generator_zk() {
+  if (prefetcher_) {
+    prefetcher_->join();
+  }
 }
 
 void global_id_generator_zk::set_ls(
@@ -46,19 +90,102 @@ void global_id_generator_zk::set_ls(
 }
 
 uint64_t global_id_generator_zk::generate() {
+  scoped_lock lk(m_);
+  while (next_ == end_) {
+    if (has_prefetched_) {
+      has_prefetched_ = false;
+      use_block(prefetched_);
+    } else if (prefetching_) {
+      prefetched_cond_.wait(m_);
+    } else {
+      use_block(lease(prefix_));
+    }
+  }
+  const uint64_t id = next_++;
+
+  if (1 < block_size_ && !prefetching_ && !has_prefetched_ &&
+      end_ - next_ <= block_size_ / 2) {
+    // the previous prefetcher has finished since prefetching_ is false
+    if (prefetcher_) {
+      prefetcher_->join();
+    }
+    prefetcher_.reset(new jubatus::util::concurrent::thread(
+        jubatus::util::lang::bind(
+            &global_id_generator_zk::prefetch, this, prefix_)));
+    prefetching_ = true;
+    prefetcher_->start();
+  }
+  return id;
+}
+
+void global_id_generator_zk::reset(uint64_t min_id) {
+  scoped_lock lk(m_);
+  min_id_ = std::max(min_id_, min_id);
+  next_ = std::min(std::max(next_, min_id_), end_);
+}
+
+uint64_t global_id_generator_zk::lease(uint32_t prefix) {
   uint64_t res;
   if ( !ls_ ) {
     throw JUBATUS_EXCEPTION(
       core::common::exception::runtime_error("lock_service is not given"));
   }
-  if (ls_->create_id(path_, 0, res)) {
-    return res;
+  if (ls_->create_id(path_, prefix, res)) {
+    if (res >= std::numeric_limits<uint64_t>::max() / block_size_) {
+      throw JUBATUS_EXCEPTION(
+          jubatus::core::common::exception::runtime_error(
+              "global IDs are exhausted"));
+    }
+    return res * block_size_;
   } else {
     throw JUBATUS_EXCEPTION(
         jubatus::core::common::exception::runtime_error("Failed to create id"));
   }
 }
 
+void global_id_generator_zk::prefetch(uint32_t prefix) {
+  uint64_t begin = 0;
+  bool leased = false;
+  try {
+    begin = lease(prefix);
+    leased = true;
+  } catch (const std::exception& e) {
+    // generate() leases a block by itself
+    LOG(WARNING) << "failed to prefetch IDs: " << e.what();
+  }
+
+  scoped_lock lk(m_);
+  prefetching_ = false;
+  if (leased) {
+    has_prefetched_ = true;
+    prefetched_ = begin;
+  }
+  prefetched_cond_.notify_all();
+}
+
+void global_id_generator_zk::use_block(uint64_t begin) {
+  end_ = begin + block_size_;
+  // the whole block is skipped if it is less than min_id_
+  next_ = std::min(std::max(begin, min_id_), end_);
+  if (next_ == end_ && (min_id_ - end_) / block_size_ > MAX_SKIPPED_BLOCKS) {
+    advance_prefix();
+  }
+}
+
+void global_id_generator_zk::advance_prefix() {
+  // blocks leased with the prefix are not less than min_id_
+  const uint64_t min_block = (min_id_ + block_size_ - 1) / block_size_;
+  const uint64_t prefix = ((min_block - 1) >> PREFIX_SHIFT) + 1;
+  if (prefix > std::numeric_limits<uint32_t>::max()) {
+    throw JUBATUS_EXCEPTION(jubatus::core::common::exception::runtime_error(
+        "global IDs are exhausted"));
+  }
+  if (prefix_ < prefix) {
+    LOG(INFO) << "global IDs skip to the prefix " << prefix;
+    prefix_ = static_cast<uint32_t>(prefix);
+  }
+}
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
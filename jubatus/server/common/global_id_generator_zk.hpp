@@ -20,6 +20,10 @@
 #include <stdint.h>
 #include <string>
 
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/scoped_ptr.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "global_id_generator_base.hpp"
@@ -29,9 +33,29 @@ namespace jubatus {
 namespace server {
 namespace common {
 
+/**
+ * Generates IDs unique in a cluster.
+ *
+ * Each server leases a block of block_size IDs with one write to
+ * ZooKeeper (lock_service::create_id returns n, and the block is
+ * [n * block_size, (n + 1) * block_size)), and hands them out locally.
+ * The next block is leased in background when half of the current one
+ * is used.
+ *
+ * IDs are unique in the cluster as long as all servers use the same
+ * block_size, and those generated by a server are increasing.  IDs of
+ * different servers are not ordered by time, and unused IDs of a block
+ * are skipped when the server stops.  block_size = 1 generates the same
+ * IDs as writing ZooKeeper for each ID.
+ *
+ * The counter in ZooKeeper cannot be set, so reset() to an ID far ahead
+ * of it advances the prefix of create_id instead (blocks become
+ * prefix * 2^32 + n), which skips at least 2^32 blocks at once.
+ */
 class global_id_generator_zk: public global_id_generator_base {
  public:
   global_id_generator_zk();
+  explicit global_id_generator_zk(uint64_t block_size);
   virtual ~global_id_generator_zk();
 
   uint64_t generate();
@@ -40,9 +64,31 @@ class global_id_generator_zk: public global_id_generator_base {
       jubatus::util::lang::shared_ptr<lock_service>& ls,
       const std::string& path_prefix);
 
+  // IDs generated later are not less than min_id (e.g. IDs in a loaded
+  // model may have been leased from another ZooKeeper)
+  void reset(uint64_t min_id);
+
  private:
+  uint64_t lease(uint32_t prefix);
+  void prefetch(uint32_t prefix);
+  void use_block(uint64_t begin);
+  void advance_prefix();
+
+  const uint64_t block_size_;
   std::string path_;
   jubatus::util::lang::shared_ptr<lock_service> ls_;
+
+  jubatus::util::concurrent::mutex m_;
+  jubatus::util::concurrent::condition prefetched_cond_;
+  uint64_t next_;
+  uint64_t end_;
+  uint64_t min_id_;
+  uint32_t prefix_;
+  bool prefetching_;
+  bool has_prefetched_;
+  uint64_t prefetched_;
+  jubatus::util::lang::scoped_ptr<jubatus::util::concurrent::thread>
+      prefetcher_;
 };
 
 }  // namespace common
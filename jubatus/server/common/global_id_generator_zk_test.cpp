@@ -0,0 +1,181 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <set>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "global_id_generator_zk.hpp"
+
+using std::string;
+using std::vector;
+using jubatus::util::lang::shared_ptr;
+
+namespace jubatus {
+namespace server {
+namespace common {
+
+namespace {
+
+// counts create_id like versions of a ZooKeeper node
+class counter_stub : public lock_service {
+ public:
+  counter_stub()
+      : version_(0) {
+  }
+
+  void force_close() {}
+  bool create(const string&, const string&, bool) {
+    return true;
+  }
+  bool set(const string&, const string&) {
+    return true;
+  }
+  bool remove(const string&) {
+    return true;
+  }
+  bool exists(const string&) {
+    return true;
+  }
+  bool bind_watcher(
+      const string&,
+      jubatus::util::lang::function<void(int, int, string)>&) {
+    return true;
+  }
+  bool bind_child_watcher(
+      const string&,
+      const jubatus::util::lang::function<void(int, int, string)>&) {
+    return true;
+  }
+  bool bind_delete_watcher(
+      const string&,
+      jubatus::util::lang::function<void(string)>&) {
+    return true;
+  }
+  bool create_seq(const string&, string&) {
+    return true;
+  }
+  bool create_id(const string&, uint32_t prefix, uint64_t& res) {
+    jubatus::util::concurrent::scoped_lock lk(m_);
+    res = (static_cast<uint64_t>(prefix) << 32) | ++version_;
+    return true;
+  }
+  bool list(const string&, vector<string>&) {
+    return true;
+  }
+  bool hd_list(const string&, string&) {
+    return true;
+  }
+  bool read(const string&, string&) {
+    return true;
+  }
+  void push_cleanup(const jubatus::util::lang::function<void()>&) {}
+  void run_cleanup() {}
+  const string& get_hosts() const {
+    return hosts_;
+  }
+  const string type() const {
+    return "stub";
+  }
+  const string get_connected_host_and_port() const {
+    return "";
+  }
+
+  uint64_t version() {
+    jubatus::util::concurrent::scoped_lock lk(m_);
+    return version_;
+  }
+
+ private:
+  jubatus::util::concurrent::mutex m_;
+  uint64_t version_;
+  string hosts_;
+};
+
+}  // namespace
+
+TEST(global_id_generator_zk, block_size_one) {
+  shared_ptr<lock_service> ls(new counter_stub);
+  global_id_generator_zk gen(1);
+  gen.set_ls(ls, "/test");
+  EXPECT_EQ(1u, gen.generate());
+  EXPECT_EQ(2u, gen.generate());
+  EXPECT_EQ(3u, gen.generate());
+}
+
+TEST(global_id_generator_zk, unique_among_servers) {
+  counter_stub* stub = new counter_stub;
+  shared_ptr<lock_service> ls(stub);
+  global_id_generator_zk gen1(10);
+  global_id_generator_zk gen2(10);
+  gen1.set_ls(ls, "/test");
+  gen2.set_ls(ls, "/test");
+
+  std::set<uint64_t> ids;
+  uint64_t last1 = 0, last2 = 0;
+  for (int i = 0; i < 100; ++i) {
+    const uint64_t id1 = gen1.generate();
+    const uint64_t id2 = gen2.generate();
+    EXPECT_TRUE(ids.insert(id1).second);
+    EXPECT_TRUE(ids.insert(id2).second);
+    // increasing in each server
+    EXPECT_LT(last1, id1);
+    EXPECT_LT(last2, id2);
+    last1 = id1;
+    last2 = id2;
+  }
+  // one write for each block (and prefetched ones)
+  EXPECT_GE(22u, stub->version());
+}
+
+TEST(global_id_generator_zk, reset) {
+  shared_ptr<lock_service> ls(new counter_stub);
+  global_id_generator_zk gen(10);
+  gen.set_ls(ls, "/test");
+  EXPECT_EQ(10u, gen.generate());
+
+  gen.reset(15);
+  EXPECT_EQ(15u, gen.generate());
+  gen.reset(35);
+  EXPECT_LE(35u, gen.generate());
+  // never goes back
+  gen.reset(0);
+  EXPECT_LT(35u, gen.generate());
+}
+
+TEST(global_id_generator_zk, reset_far_ahead) {
+  counter_stub* stub = new counter_stub;
+  shared_ptr<lock_service> ls(stub);
+  global_id_generator_zk gen(10);
+  gen.set_ls(ls, "/test");
+  const uint64_t first = gen.generate();
+
+  const uint64_t min_id = 1000000000000ULL;
+  gen.reset(min_id);
+  const uint64_t id = gen.generate();
+  EXPECT_LE(min_id, id);
+  EXPECT_LT(first, id);
+  EXPECT_LT(id, gen.generate());
+  // not a write for each skipped block
+  EXPECT_GE(5u, stub->version());
+}
+
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,129 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "keyword_matcher.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace jubatus {
+namespace server {
+namespace common {
+
+namespace {
+
+const size_t ROOT = 0;
+
+}  // namespace
+
+keyword_matcher::keyword_matcher() {
+  build();
+}
+
+keyword_matcher::keyword_matcher(const std::vector<std::string>& keywords)
+    : keywords_(keywords) {
+  build();
+}
+
+void keyword_matcher::match(
+    const std::string& text,
+    std::vector<size_t>& found) const {
+  found.clear();
+  // empty keywords
+  found.insert(found.end(),
+      nodes_[ROOT].outputs.begin(), nodes_[ROOT].outputs.end());
+
+  size_t state = ROOT;
+  for (size_t i = 0; i < text.size(); ++i) {
+    state = transition(state, text[i]);
+    for (size_t s = state; s != ROOT; s = nodes_[s].output_link) {
+      found.insert(found.end(),
+          nodes_[s].outputs.begin(), nodes_[s].outputs.end());
+    }
+  }
+
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+}
+
+void keyword_matcher::build() {
+  nodes_.assign(1, node());
+  nodes_[ROOT].fail = ROOT;
+  nodes_[ROOT].output_link = ROOT;
+
+  // trie of keywords
+  for (size_t i = 0; i < keywords_.size(); ++i) {
+    size_t state = ROOT;
+    for (size_t j = 0; j < keywords_[i].size(); ++j) {
+      const char c = keywords_[i][j];
+      std::map<char, size_t>::const_iterator it = nodes_[state].next.find(c);
+      if (it != nodes_[state].next.end()) {
+        state = it->second;
+      } else {
+        // nodes_ may be reallocated, so the index is taken first
+        const size_t child = nodes_.size();
+        nodes_.push_back(node());
+        nodes_[state].next[c] = child;
+        state = child;
+      }
+    }
+    nodes_[state].outputs.push_back(i);
+  }
+
+  // failure links in breadth-first order, so those of shallower nodes are
+  // set before they are followed
+  std::deque<size_t> queue;
+  for (std::map<char, size_t>::const_iterator it = nodes_[ROOT].next.begin();
+       it != nodes_[ROOT].next.end(); ++it) {
+    nodes_[it->second].fail = ROOT;
+    nodes_[it->second].output_link = ROOT;
+    queue.push_back(it->second);
+  }
+  while (!queue.empty()) {
+    const size_t parent = queue.front();
+    queue.pop_front();
+    for (std::map<char, size_t>::const_iterator it =
+             nodes_[parent].next.begin();
+         it != nodes_[parent].next.end(); ++it) {
+      const size_t child = it->second;
+      const size_t fail = transition(nodes_[parent].fail, it->first);
+      nodes_[child].fail = fail;
+      nodes_[child].output_link =
+          nodes_[fail].outputs.empty() ? nodes_[fail].output_link : fail;
+      queue.push_back(child);
+    }
+  }
+}
+
+size_t keyword_matcher::transition(size_t state, char c) const {
+  while (true) {
+    std::map<char, size_t>::const_iterator it = nodes_[state].next.find(c);
+    if (it != nodes_[state].next.end()) {
+      return it->second;
+    }
+    if (state == ROOT) {
+      return ROOT;
+    }
+    state = nodes_[state].fail;
+  }
+}
+
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,69 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_COMMON_KEYWORD_MATCHER_HPP_
+#define JUBATUS_SERVER_COMMON_KEYWORD_MATCHER_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace jubatus {
+namespace server {
+namespace common {
+
+/**
+ * Finds all of a set of keywords in a text in one pass (Aho-Corasick).
+ *
+ * Keywords are matched as substrings, like std::string::find, so an empty
+ * keyword is found in any text.  Matching takes time linear in the length
+ * of the text and the number of occurrences, regardless of the number of
+ * keywords.
+ */
+class keyword_matcher {
+ public:
+  keyword_matcher();
+  explicit keyword_matcher(const std::vector<std::string>& keywords);
+
+  const std::vector<std::string>& keywords() const {
+    return keywords_;
+  }
+
+  // indices of keywords found in text, in ascending order without
+  // duplicates
+  void match(const std::string& text, std::vector<size_t>& found) const;
+
+ private:
+  struct node {
+    std::map<char, size_t> next;
+    size_t fail;
+    // the nearest node on the failure path with outputs, or 0 (the root)
+    size_t output_link;
+    std::vector<size_t> outputs;
+  };
+
+  void build();
+  size_t transition(size_t state, char c) const;
+
+  std::vector<std::string> keywords_;
+  std::vector<node> nodes_;
+};
+
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_COMMON_KEYWORD_MATCHER_HPP_
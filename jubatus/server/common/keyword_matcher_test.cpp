@@ -0,0 +1,108 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "keyword_matcher.hpp"
+
+using std::string;
+using std::vector;
+
+namespace jubatus {
+namespace server {
+namespace common {
+
+TEST(keyword_matcher, overlapping) {
+  vector<string> keywords;
+  keywords.push_back("he");
+  keywords.push_back("she");
+  keywords.push_back("his");
+  keywords.push_back("hers");
+  keyword_matcher m(keywords);
+
+  vector<size_t> found;
+  m.match("ushers", found);
+  ASSERT_EQ(3u, found.size());
+  EXPECT_EQ(0u, found[0]);
+  EXPECT_EQ(1u, found[1]);
+  EXPECT_EQ(3u, found[2]);
+
+  m.match("hi", found);
+  EXPECT_TRUE(found.empty());
+}
+
+TEST(keyword_matcher, duplicates_and_empty) {
+  vector<string> keywords;
+  keywords.push_back("a");
+  keywords.push_back("");
+  keywords.push_back("a");
+  keyword_matcher m(keywords);
+
+  vector<size_t> found;
+  m.match("aaa", found);
+  ASSERT_EQ(3u, found.size());
+  EXPECT_EQ(0u, found[0]);
+  EXPECT_EQ(1u, found[1]);
+  EXPECT_EQ(2u, found[2]);
+
+  m.match("", found);
+  ASSERT_EQ(1u, found.size());
+  EXPECT_EQ(1u, found[0]);
+
+  keyword_matcher none;
+  none.match("aaa", found);
+  EXPECT_TRUE(found.empty());
+}
+
+TEST(keyword_matcher, same_as_find) {
+  std::srand(testing::UnitTest::GetInstance()->random_seed());
+
+  // short strings of a small alphabet, to have many partial matches
+  vector<string> keywords;
+  for (size_t i = 0; i < 50; ++i) {
+    string k;
+    const size_t size = 1 + std::rand() % 4;
+    for (size_t j = 0; j < size; ++j) {
+      k.push_back('a' + std::rand() % 3);
+    }
+    keywords.push_back(k);
+  }
+  keyword_matcher m(keywords);
+
+  for (size_t n = 0; n < 100; ++n) {
+    string text;
+    const size_t size = std::rand() % 20;
+    for (size_t j = 0; j < size; ++j) {
+      text.push_back('a' + std::rand() % 3);
+    }
+
+    vector<size_t> expected;
+    for (size_t i = 0; i < keywords.size(); ++i) {
+      if (text.find(keywords[i]) != string::npos) {
+        expected.push_back(i);
+      }
+    }
+    vector<size_t> found;
+    m.match(text, found);
+    EXPECT_EQ(expected, found) << text;
+  }
+}
+
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,157 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "rpc_connection_pool.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+#include "../logger/logger.hpp"
+
+namespace msgpack {
+namespace rpc {
+extern const object TIMEOUT_ERROR;
+extern const object CONNECT_ERROR;
+}  // namespace rpc
+}  // namespace msgpack
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+
+namespace jubatus {
+namespace server {
+namespace common {
+namespace mprpc {
+
+rpc_connection_pool& rpc_connection_pool::shared() {
+  // intentionally leaked; the event loop threads of the pool may still be
+  // running while static objects are destructed at exit
+  static rpc_connection_pool* instance = new rpc_connection_pool();
+  return *instance;
+}
+
+rpc_connection_pool::rpc_connection_pool()
+    : evictions_(0) {
+  // run the event loop in background threads so that futures can be joined
+  // from multiple threads at once
+  // Note: mpio's event loop start() requires thread_num > 1.
+  pool_.start(2);
+}
+
+msgpack::rpc::session rpc_connection_pool::get_session(
+    const string& host,
+    uint16_t port) {
+  msgpack::rpc::session s = pool_.get_session(host, port);
+
+  scoped_lock lk(m_);
+  peer_state& peer = peers_[peer_t(host, port)];
+  peer.session = s;
+  ++peer.calls;
+  return s;
+}
+
+void rpc_connection_pool::report(
+    const string& host,
+    uint16_t port,
+    msgpack::rpc::session& session,
+    const msgpack::object& error) {
+  if (!is_transport_error(error)) {
+    scoped_lock lk(m_);
+    peer_map_t::iterator it = peers_.find(peer_t(host, port));
+    if (it != peers_.end()) {
+      it->second.consecutive_failures = 0;
+    }
+    return;
+  }
+
+  // the connection may be broken; do not reuse it
+  pool_.remove_session(session);
+
+  scoped_lock lk(m_);
+  peer_state& peer = peers_[peer_t(host, port)];
+  ++peer.failures;
+  if (++peer.consecutive_failures == UNHEALTHY_THRESHOLD) {
+    LOG(WARNING) << "peer " << host << ":" << port << " failed "
+                 << peer.consecutive_failures << " times in a row";
+  }
+}
+
+void rpc_connection_pool::retain(
+    const vector<std::pair<string, int> >& members) {
+  set<peer_t> alive;
+  for (size_t i = 0; i < members.size(); ++i) {
+    alive.insert(peer_t(members[i].first, members[i].second));
+  }
+
+  vector<msgpack::rpc::session> evicted;
+  {
+    scoped_lock lk(m_);
+    for (peer_map_t::iterator it = peers_.begin(); it != peers_.end(); ) {
+      if (alive.count(it->first)) {
+        ++it;
+        continue;
+      }
+      DLOG(INFO) << "evict sessions to " << it->first.first << ":"
+                 << it->first.second;
+      evicted.push_back(it->second.session);
+      peers_.erase(it++);
+      ++evictions_;
+    }
+  }
+
+  for (size_t i = 0; i < evicted.size(); ++i) {
+    pool_.remove_session(evicted[i]);
+  }
+}
+
+void rpc_connection_pool::get_status(map<string, string>& status) const {
+  scoped_lock lk(m_);
+  uint64_t calls = 0;
+  uint64_t failures = 0;
+  size_t unhealthy = 0;
+  for (peer_map_t::const_iterator it = peers_.begin();
+       it != peers_.end(); ++it) {
+    calls += it->second.calls;
+    failures += it->second.failures;
+    if (it->second.consecutive_failures >= UNHEALTHY_THRESHOLD) {
+      ++unhealthy;
+    }
+  }
+  status["connection_pool.peers"] = lexical_cast<string>(peers_.size());
+  status["connection_pool.unhealthy_peers"] = lexical_cast<string>(unhealthy);
+  status["connection_pool.calls"] = lexical_cast<string>(calls);
+  status["connection_pool.failures"] = lexical_cast<string>(failures);
+  status["connection_pool.evictions"] = lexical_cast<string>(evictions_);
+}
+
+bool rpc_connection_pool::is_transport_error(const msgpack::object& error) {
+  return error == msgpack::rpc::TIMEOUT_ERROR
+      || error == msgpack::rpc::CONNECT_ERROR;
+}
+
+}  // namespace mprpc
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,153 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_COMMON_MPRPC_RPC_CONNECTION_POOL_HPP_
+#define JUBATUS_SERVER_COMMON_MPRPC_RPC_CONNECTION_POOL_HPP_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <msgpack.hpp>
+#include <jubatus/msgpack/rpc/session_pool.h>
+
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/noncopyable.h"
+
+namespace jubatus {
+namespace server {
+namespace common {
+namespace mprpc {
+
+/**
+ * Process-wide pool of msgpack-rpc sessions used for server-to-server
+ * communication (MIX and CHT replication).
+ *
+ * Sessions are kept per peer and reused across calls, so that the TCP
+ * connection is not re-established for each RPC.  Sessions which failed
+ * with transport errors (connect error or timeout) are dropped from the
+ * pool, and peers which left the cluster are evicted by retain().
+ */
+class rpc_connection_pool : jubatus::util::lang::noncopyable {
+ public:
+  typedef std::pair<std::string, uint16_t> peer_t;
+
+  // number of consecutive transport errors to mark a peer as unhealthy
+  static const unsigned int UNHEALTHY_THRESHOLD = 3;
+
+  static rpc_connection_pool& shared();
+
+  msgpack::rpc::session_pool& pool() {
+    return pool_;
+  }
+
+  // the session is shared by all callers; call methods over it through
+  // call_async so that each call has its own timeout
+  msgpack::rpc::session get_session(const std::string& host, uint16_t port);
+
+  template<typename Args>
+  msgpack::rpc::future call_async(
+      msgpack::rpc::session& session,
+      int timeout_sec,
+      const std::string& method,
+      const Args& args);
+
+  // report the result of the call made with the session;
+  // error is nil for success
+  void report(
+      const std::string& host,
+      uint16_t port,
+      msgpack::rpc::session& session,
+      const msgpack::object& error);
+
+  // drop sessions to peers which are not in members
+  void retain(const std::vector<std::pair<std::string, int> >& members);
+
+  void get_status(std::map<std::string, std::string>& status) const;
+
+  // synchronous call over pooled session; result of the call is reported
+  template<typename Res, typename Args>
+  Res call_apply(
+      const std::string& host,
+      uint16_t port,
+      int timeout_sec,
+      const std::string& method,
+      const Args& args);
+
+ private:
+  rpc_connection_pool();
+
+  struct peer_state {
+    peer_state()
+        : calls(0),
+          failures(0),
+          consecutive_failures(0) {
+    }
+
+    msgpack::rpc::session session;
+    uint64_t calls;
+    uint64_t failures;
+    unsigned int consecutive_failures;
+  };
+
+  typedef std::map<peer_t, peer_state> peer_map_t;
+
+  static bool is_transport_error(const msgpack::object& error);
+
+  msgpack::rpc::session_pool pool_;
+
+  // a future takes the timeout of the session when the call is made
+  jubatus::util::concurrent::mutex call_m_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  peer_map_t peers_;
+  uint64_t evictions_;
+};
+
+template<typename Args>
+msgpack::rpc::future rpc_connection_pool::call_async(
+    msgpack::rpc::session& session,
+    int timeout_sec,
+    const std::string& method,
+    const Args& args) {
+  jubatus::util::concurrent::scoped_lock lk(call_m_);
+  session.set_timeout(timeout_sec);
+  return session.call_apply(method, args);
+}
+
+template<typename Res, typename Args>
+Res rpc_connection_pool::call_apply(
+    const std::string& host,
+    uint16_t port,
+    int timeout_sec,
+    const std::string& method,
+    const Args& args) {
+  msgpack::rpc::session s = get_session(host, port);
+  msgpack::rpc::future f = call_async(s, timeout_sec, method, args);
+  f.join();
+  report(host, port, s, f.error());
+  return f.get<Res>();
+}
+
+}  // namespace mprpc
+}  // namespace common
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_COMMON_MPRPC_RPC_CONNECTION_POOL_HPP_
@@ -15,16 +15,51 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "rpc_mclient.hpp"
+#include <deque>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
 #include "jubatus/util/system/syscall.h"
 #include "../logger/logger.hpp"
 
+using jubatus::util::concurrent::scoped_lock;
+
 namespace jubatus {
 namespace server {
 namespace common {
 namespace mprpc {
+namespace {
+
+// indices of finished futures in order of completion
+class completion_queue {
+ public:
+  void push(msgpack::rpc::future, size_t index) {
+    scoped_lock lk(m_);
+    finished_.push_back(index);
+    c_.notify();
+  }
+
+  size_t pop() {
+    scoped_lock lk(m_);
+    while (finished_.empty()) {
+      c_.wait(m_);
+    }
+    const size_t index = finished_.front();
+    finished_.pop_front();
+    return index;
+  }
+
+ private:
+  jubatus::util::concurrent::mutex m_;
+  jubatus::util::concurrent::condition c_;
+  std::deque<size_t> finished_;
+};
+
+}  // namespace
 
 rpc_result_object rpc_mclient::wait(const std::string& method) {
   rpc_result_object result;
@@ -35,7 +70,7 @@ rpc_result_object rpc_mclient::wait(const std::string& method) {
 
   for (size_t i = 0; i < futures_.size(); ++i) {
     try {
-      result.response.push_back(wait_one(method, futures_[i]));
+      result.response.push_back(wait_reported_(method, i));
       result.error.push_back(
           rpc_error(hosts_[i].first,
                     hosts_[i].second));
@@ -70,6 +105,83 @@ rpc_response_t rpc_mclient::wait_one(
   JUBATUS_MSGPACKRPC_EXCEPTION_DEFAULT_HANDLER(method);
 }
 
+rpc_response_t rpc_mclient::wait_reported_(
+    const std::string& method,
+    size_t i) {
+  try {
+    rpc_response_t response(wait_one(method, futures_[i]));
+    report_(i);
+    return response;
+  } catch (...) {
+    // timeouts and connect errors, which the pool acts on, come here
+    report_(i);
+    throw;
+  }
+}
+
+size_t rpc_mclient::stream_(
+    const std::string& method,
+    const response_handler& handler) {
+  if (hosts_.empty()) {
+    throw JUBATUS_EXCEPTION(rpc_no_client() << error_method(method));
+  }
+
+  std::vector<rpc_error> errors;
+  size_t handled = 0;
+  mp::shared_ptr<completion_queue> queue;
+  if (conn_) {
+    // event loop of the connection pool runs in background, so futures can
+    // notify their completion by callbacks
+    queue.reset(new completion_queue);
+    for (size_t i = 0; i < futures_.size(); ++i) {
+      futures_[i].attach_callback(
+          mp::bind(&completion_queue::push, queue, mp::placeholders::_1, i));
+    }
+  }
+
+  for (size_t n = 0; n < futures_.size(); ++n) {
+    const size_t i = queue ? queue->pop() : n;
+    try {
+      handle_one_(method, i, handler);
+      ++handled;
+    } catch (...) {
+      errors.push_back(
+          rpc_error(hosts_[i].first,
+                    hosts_[i].second,
+                    jubatus::core::common::exception::get_current_exception()));
+    }
+  }
+
+  if (handled == 0) {
+    rpc_no_result e;
+    if (!errors.empty()) {
+      e << error_multi_rpc(errors);
+    }
+    throw JUBATUS_EXCEPTION(e << error_method(method));
+  }
+
+  return handled;
+}
+
+void rpc_mclient::handle_one_(
+    const std::string& method,
+    size_t i,
+    const response_handler& handler) {
+  rpc_response_t response(wait_reported_(method, i));
+
+  // the response owns the zone now; drop the future so that the data is
+  // freed as soon as the handler finishes
+  futures_[i] = msgpack::rpc::future();
+  handler(rpc_error(hosts_[i].first, hosts_[i].second), response);
+}
+
+void rpc_mclient::report_(size_t i) {
+  if (conn_ && futures_[i].is_finished()) {
+    conn_->report(
+        hosts_[i].first, hosts_[i].second, sessions_[i], futures_[i].error());
+  }
+}
+
 std::string create_error_string(const msgpack::object& error) {
   switch (error.type) {
     case msgpack::type::RAW:
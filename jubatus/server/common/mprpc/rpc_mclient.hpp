@@ -30,6 +30,7 @@
 #include "jubatus/util/lang/function.h"
 #include "jubatus/util/lang/noncopyable.h"
 
+#include "rpc_connection_pool.hpp"
 #include "rpc_error.hpp"
 #include "rpc_result.hpp"
 
@@ -108,7 +109,8 @@ class rpc_mclient : jubatus::util::lang::noncopyable {
       : hosts_(hosts),
         timeout_sec_(timeout_sec),
         pool_(NULL),
-        pool_allocated_(false) {
+        pool_allocated_(false),
+        conn_(NULL) {
     init_pool(pool);
   }
 
@@ -118,7 +120,8 @@ class rpc_mclient : jubatus::util::lang::noncopyable {
       msgpack::rpc::session_pool* pool = NULL)
       : timeout_sec_(timeout_sec),
         pool_(NULL),
-        pool_allocated_(false) {
+        pool_allocated_(false),
+        conn_(NULL) {
     hosts_.reserve(hosts.size());
     for (size_t i = 0; i < hosts.size(); ++i) {
       hosts_.push_back(hosts[i]);
@@ -126,6 +129,22 @@ class rpc_mclient : jubatus::util::lang::noncopyable {
     init_pool(pool);
   }
 
+  // use sessions shared in the connection pool;
+  // results of calls are reported to the pool
+  rpc_mclient(
+      const std::vector<std::pair<std::string, int> >& hosts,
+      int timeout_sec,
+      rpc_connection_pool& conn)
+      : timeout_sec_(timeout_sec),
+        pool_(&conn.pool()),
+        pool_allocated_(false),
+        conn_(&conn) {
+    hosts_.reserve(hosts.size());
+    for (size_t i = 0; i < hosts.size(); ++i) {
+      hosts_.push_back(hosts[i]);
+    }
+  }
+
   ~rpc_mclient() {
     if (pool_allocated_ && pool_) {
       delete pool_;
@@ -164,6 +183,21 @@ class rpc_mclient : jubatus::util::lang::noncopyable {
   template<typename A0>
   rpc_result_object call(const std::string&, const A0& a0);
 
+  typedef jubatus::util::lang::function<
+      void(const rpc_error&, rpc_response_t&)> response_handler;
+
+  // Calls the method on all hosts and passes each response to the handler
+  // in order of arrival, so that the caller can process a response while
+  // others are still in flight.  Each response is released after the handler
+  // returns.  Returns the number of responses passed to the handler.
+  // Responses arrive out of order only when connection pool is used;
+  // otherwise they are handled in order of hosts.
+  template<typename A0>
+  size_t call_streaming(
+      const std::string& m,
+      const A0& a0,
+      const response_handler& handler);
+
  private:
   void init_pool(msgpack::rpc::session_pool* pool) {
     if (pool) {
@@ -189,13 +223,23 @@ class rpc_mclient : jubatus::util::lang::noncopyable {
 
   rpc_result_object wait(const std::string& method);
   rpc_response_t wait_one(const std::string& method, msgpack::rpc::future& f);
+  // waits for the i-th response and reports it whether it failed or not
+  rpc_response_t wait_reported_(const std::string& method, size_t i);
+  size_t stream_(const std::string& method, const response_handler& handler);
+  void handle_one_(
+      const std::string& method,
+      size_t i,
+      const response_handler& handler);
+  void report_(size_t i);
 
   host_spec_list_t hosts_;
   int timeout_sec_;
 
   msgpack::rpc::session_pool* pool_;
   bool pool_allocated_;
+  rpc_connection_pool* conn_;
   std::vector<msgpack::rpc::future> futures_;
+  std::vector<msgpack::rpc::session> sessions_;
 };
 
 template<typename Res, typename A0>
@@ -250,11 +294,20 @@ template<typename Args>
 void rpc_mclient::call_(const std::string& m, const Args& args) {
   futures_.clear();
   futures_.reserve(hosts_.size());
+  sessions_.clear();
+  sessions_.reserve(hosts_.size());
   for (host_spec_list_t::iterator itr = hosts_.begin(), end = hosts_.end();
       itr != end; ++itr) {
-    msgpack::rpc::session s = pool_->get_session(itr->first, itr->second);
-    s.set_timeout(timeout_sec_);
-    futures_.push_back(s.call_apply(m, args));
+    if (conn_) {
+      msgpack::rpc::session s = conn_->get_session(itr->first, itr->second);
+      futures_.push_back(conn_->call_async(s, timeout_sec_, m, args));
+      sessions_.push_back(s);
+    } else {
+      msgpack::rpc::session s = pool_->get_session(itr->first, itr->second);
+      s.set_timeout(timeout_sec_);
+      futures_.push_back(s.call_apply(m, args));
+      sessions_.push_back(s);
+    }
   }
 }
 
@@ -290,8 +343,10 @@ rpc_result<Res> rpc_mclient::join_(
   for (size_t i = 0; i < futures_.size(); ++i) {
     try {
       join_one_(method, futures_[i], result, reducer);
+      report_(i);
       ++result_count;
     } catch (...) {
+      report_(i);
       // continue process next result when exception thrown.
       // store exception_thrower to list of errors
       result.error.push_back(
@@ -317,6 +372,15 @@ rpc_result_object rpc_mclient::call(const std::string& m, const A0& a0) {
   return wait(m);
 }
 
+template<typename A0>
+size_t rpc_mclient::call_streaming(
+    const std::string& m,
+    const A0& a0,
+    const response_handler& handler) {
+  call_(m, msgpack::type::tuple<const A0&>(a0));
+  return stream_(m, handler);
+}
+
 std::string create_error_string(const msgpack::object& error);
 
 }  // namespace mprpc
@@ -23,6 +23,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <climits>
 #include <cstdio>
@@ -50,6 +51,12 @@ namespace jubatus {
 namespace server {
 namespace common {
 
+namespace {
+
+const int64_t MEMORY_GB_PER_WEIGHT = 2;
+
+}  // namespace
+
 std::string get_program_name() {
   // WARNING: this code will only work on linux or OS X
 #ifdef __APPLE__
@@ -167,6 +174,21 @@ void get_machine_status(machine_status_t& status) {
   status.vm_share = vm_shr;  // shared
 }
 
+int get_capacity_weight() {
+  const int64_t cores = sysconf(_SC_NPROCESSORS_ONLN);
+  const int64_t pages = sysconf(_SC_PHYS_PAGES);
+  const int64_t page_size = sysconf(_SC_PAGESIZE);
+
+  int64_t weight = std::max<int64_t>(cores, 1);
+  if (0 < pages && 0 < page_size) {
+    // a server with little memory cannot hold a large part of the model
+    const int64_t memory_gb = pages / (1024 * 1024 * 1024 / page_size);
+    weight = std::min(weight, memory_gb / MEMORY_GB_PER_WEIGHT);
+  }
+  return static_cast<int>(
+      std::max<int64_t>(1, std::min<int64_t>(weight, MAX_CAPACITY_WEIGHT)));
+}
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
@@ -44,6 +44,12 @@ void append_server_path(const std::string& argv0);
 
 void get_machine_status(machine_status_t& status);
 
+static const int MAX_CAPACITY_WEIGHT = 64;
+
+// weight of this machine in [1, MAX_CAPACITY_WEIGHT]: the number of CPU
+// cores, limited by the memory (2 GB for each)
+int get_capacity_weight();
+
 }  // namespace common
 }  // namespace server
 }  // namespace jubatus
@@ -56,6 +56,12 @@ TEST(system, get_user_name) {
   EXPECT_NE(std::string(""), user);
 }
 
+TEST(system, get_capacity_weight) {
+  const int weight = jubatus::server::common::get_capacity_weight();
+  EXPECT_LE(1, weight);
+  EXPECT_GE(jubatus::server::common::MAX_CAPACITY_WEIGHT, weight);
+}
+
 TEST(system, get_machine_status) {
   jubatus::server::common::machine_status_t status;
   EXPECT_NO_THROW({
@@ -17,7 +17,11 @@
 #ifndef JUBATUS_SERVER_FRAMEWORK_AGGREGATORS_HPP_
 #define JUBATUS_SERVER_FRAMEWORK_AGGREGATORS_HPP_
 
+#include <algorithm>
 #include <map>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace jubatus {
@@ -44,6 +48,113 @@ std::vector<T> concat(const std::vector<T>& lhs, const std::vector<T>& rhs) {
   return ret;
 }
 
+/*
+ * In-place versions of merge and concat: the result is stored in lhs, and
+ * rhs is left in an unspecified state.  Elements are swapped instead of
+ * copied, so reducing large results does not copy each of them again.
+ */
+template<typename K, typename V>
+void merge_into(std::map<K, V>& lhs, std::map<K, V>& rhs) {
+  if (lhs.size() < rhs.size()) {
+    // insert the smaller one; entries of rhs take precedence
+    lhs.swap(rhs);
+    lhs.insert(rhs.begin(), rhs.end());
+    return;
+  }
+  typename std::map<K, V>::iterator it;
+  for (it = rhs.begin(); it != rhs.end(); ++it) {
+    std::swap(lhs[it->first], it->second);
+  }
+}
+
+template<typename T>
+void concat_into(std::vector<T>& lhs, std::vector<T>& rhs) {
+  if (lhs.empty()) {
+    lhs.swap(rhs);
+    return;
+  }
+  const size_t size = lhs.size();
+  lhs.resize(size + rhs.size());
+  std::swap_ranges(rhs.begin(), rhs.end(), lhs.begin() + size);
+}
+
+/*
+ * Accessors of a scored row for top_k_into and bottom_k_into: either
+ * std::pair<std::string, S> or a type with id and score members.
+ */
+template<typename T>
+const std::string& row_id(const T& r) {
+  return r.id;
+}
+
+template<typename S>
+const std::string& row_id(const std::pair<std::string, S>& r) {
+  return r.first;
+}
+
+template<typename T>
+float row_score(const T& r) {
+  return r.score;
+}
+
+template<typename S>
+S row_score(const std::pair<std::string, S>& r) {
+  return r.second;
+}
+
+template<typename T>
+struct higher_score {
+  bool operator()(const T& lhs, const T& rhs) const {
+    return row_score(lhs) > row_score(rhs);
+  }
+};
+
+template<typename T>
+struct lower_score {
+  bool operator()(const T& lhs, const T& rhs) const {
+    return row_score(lhs) < row_score(rhs);
+  }
+};
+
+/*
+ * Merges scored rows into lhs in the order of Compare, and keeps at most k
+ * of them.  A row returned by more than one server (e.g., replicas) appears
+ * only once.
+ */
+template<typename T, typename Compare>
+void merge_k_into(
+    std::vector<T>& lhs,
+    std::vector<T>& rhs,
+    size_t k,
+    Compare comp) {
+  concat_into(lhs, rhs);
+  std::stable_sort(lhs.begin(), lhs.end(), comp);
+
+  std::set<std::string> ids;
+  size_t n = 0;
+  for (size_t i = 0; i < lhs.size() && n < k; ++i) {
+    if (ids.insert(row_id(lhs[i])).second) {
+      if (n != i) {
+        std::swap(lhs[n], lhs[i]);
+      }
+      ++n;
+    }
+  }
+  lhs.resize(n);
+}
+
+// k rows of the highest scores (e.g., similarities)
+template<typename T>
+void top_k_into(std::vector<T>& lhs, std::vector<T>& rhs, size_t k) {
+  merge_k_into(lhs, rhs, k, higher_score<T>());
+}
+
+// k rows of the lowest scores (e.g., distances)
+template<typename T>
+void bottom_k_into(std::vector<T>& lhs, std::vector<T>& rhs, size_t k) {
+  merge_k_into(lhs, rhs, k, lower_score<T>());
+}
+
 template<typename T>
 T pass(T lhs, T rhs) {
   return lhs;  // TODO( ):
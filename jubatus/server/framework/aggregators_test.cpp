@@ -0,0 +1,137 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "aggregators.hpp"
+
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+TEST(aggregators, merge_into) {
+  map<string, int> lhs, rhs;
+  lhs["a"] = 1;
+  lhs["b"] = 2;
+  lhs["c"] = 3;
+  rhs["c"] = 30;
+  rhs["d"] = 40;
+
+  map<string, int> expected = merge(lhs, rhs);
+  merge_into(lhs, rhs);
+  EXPECT_EQ(expected, lhs);
+  EXPECT_EQ(30, lhs["c"]);
+}
+
+TEST(aggregators, merge_into_smaller_lhs) {
+  map<string, int> lhs, rhs;
+  lhs["c"] = 3;
+  rhs["a"] = 10;
+  rhs["b"] = 20;
+  rhs["c"] = 30;
+
+  map<string, int> expected = merge(lhs, rhs);
+  merge_into(lhs, rhs);
+  EXPECT_EQ(expected, lhs);
+  EXPECT_EQ(30, lhs["c"]);
+}
+
+TEST(aggregators, concat_into) {
+  vector<string> lhs, rhs;
+  rhs.push_back("a");
+  concat_into(lhs, rhs);
+  ASSERT_EQ(1u, lhs.size());
+  EXPECT_EQ("a", lhs[0]);
+
+  rhs.clear();
+  rhs.push_back("b");
+  rhs.push_back("c");
+  vector<string> expected = concat(lhs, rhs);
+  concat_into(lhs, rhs);
+  EXPECT_EQ(expected, lhs);
+}
+
+namespace {
+
+struct scored_row {
+  scored_row()
+      : score(0) {
+  }
+
+  scored_row(const string& id, float score)
+      : id(id),
+        score(score) {
+  }
+
+  string id;
+  float score;
+};
+
+}  // namespace
+
+TEST(aggregators, top_k_into) {
+  vector<pair<string, float> > lhs, rhs;
+  lhs.push_back(make_pair("a", 0.9f));
+  lhs.push_back(make_pair("b", 0.5f));
+  lhs.push_back(make_pair("c", 0.1f));
+  rhs.push_back(make_pair("d", 0.7f));
+  rhs.push_back(make_pair("b", 0.5f));  // replica of b
+  rhs.push_back(make_pair("e", 0.3f));
+
+  top_k_into(lhs, rhs, 3);
+  ASSERT_EQ(3u, lhs.size());
+  EXPECT_EQ("a", lhs[0].first);
+  EXPECT_EQ("d", lhs[1].first);
+  EXPECT_EQ("b", lhs[2].first);
+}
+
+TEST(aggregators, top_k_into_fewer_rows) {
+  vector<pair<string, float> > lhs, rhs;
+  lhs.push_back(make_pair("a", 0.9f));
+  rhs.push_back(make_pair("b", 0.5f));
+
+  top_k_into(lhs, rhs, 10);
+  ASSERT_EQ(2u, lhs.size());
+  EXPECT_EQ("a", lhs[0].first);
+  EXPECT_EQ("b", lhs[1].first);
+}
+
+TEST(aggregators, bottom_k_into) {
+  vector<scored_row> lhs, rhs;
+  lhs.push_back(scored_row("a", 1.0f));
+  lhs.push_back(scored_row("b", 4.0f));
+  rhs.push_back(scored_row("c", 2.0f));
+  rhs.push_back(scored_row("d", 3.0f));
+
+  bottom_k_into(lhs, rhs, 3);
+  ASSERT_EQ(3u, lhs.size());
+  EXPECT_EQ("a", lhs[0].id);
+  EXPECT_EQ("c", lhs[1].id);
+  EXPECT_EQ("d", lhs[2].id);
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
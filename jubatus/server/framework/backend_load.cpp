@@ -0,0 +1,293 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "backend_load.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::concurrent::scoped_rlock;
+using jubatus::util::concurrent::scoped_wlock;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::system::time::get_clock_time;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+// the ejection period grows up to eject_sec * MAX_EJECTION_BACKOFF
+const uint64_t MAX_EJECTION_BACKOFF = 8;
+
+// latency of a server is compared with others after these responses
+const uint64_t MIN_LATENCY_SAMPLES = 5;
+// latency of fewer servers has no meaningful median
+const size_t MIN_LATENCY_SERVERS = 3;
+
+}  // namespace
+
+backend_load::backend_load(
+    double decay,
+    double failure_penalty_sec,
+    int eject_failures,
+    double eject_latency_ratio,
+    double eject_sec)
+    : decay_(decay),
+      failure_penalty_sec_(failure_penalty_sec),
+      eject_failures_(eject_failures),
+      eject_latency_ratio_(eject_latency_ratio),
+      eject_sec_(eject_sec),
+      start_(get_clock_time()) {
+}
+
+void backend_load::begin(const host_type& host) {
+  entry_ptr e = get(host);
+  scoped_lock lk(e->m);
+  ++e->in_flight;
+}
+
+void backend_load::end(
+    const host_type& host,
+    double latency_sec,
+    bool failed,
+    bool refused) {
+  entry_ptr e = get(host);
+  if (failed && !refused) {
+    // timeouts and connection errors; errors answered by the server keep
+    // their measured latency
+    latency_sec = std::max(latency_sec, failure_penalty_sec_);
+  }
+
+  scoped_lock lk(e->m);
+  if (e->in_flight > 0) {
+    --e->in_flight;
+  }
+  ++e->requests;
+  if (failed) {
+    ++e->errors;
+  }
+  if (e->latency == 0) {
+    e->latency = latency_sec;
+  } else {
+    e->latency += decay_ * (latency_sec - e->latency);
+  }
+
+  if (failed && !refused) {
+    ++e->failures_in_row;
+    if (ejection_enabled() && 0 < eject_failures_ && !e->ejected &&
+        static_cast<uint64_t>(eject_failures_) <= e->failures_in_row) {
+      eject(*e, now());
+    }
+  } else {
+    e->failures_in_row = 0;
+    ++e->samples;
+  }
+}
+
+void backend_load::cancel(const host_type& host) {
+  entry_ptr e = get(host);
+  scoped_lock lk(e->m);
+  if (e->in_flight > 0) {
+    --e->in_flight;
+  }
+}
+
+size_t backend_load::choose(
+    const std::vector<host_type>& hosts,
+    jubatus::util::math::random::mtrand& rng) const {
+  if (hosts.size() <= 1) {
+    return 0;
+  }
+  const size_t i = rng(hosts.size());
+  size_t j = rng(hosts.size() - 1);
+  if (i <= j) {
+    ++j;
+  }
+  return less_loaded(hosts[j], hosts[i]) ? j : i;
+}
+
+void backend_load::admit(
+    const std::vector<host_type>& hosts,
+    jubatus::util::math::random::mtrand& rng,
+    std::vector<size_t>& admitted) {
+  admitted.clear();
+  const double t = now();
+
+  std::vector<entry_ptr> entries(hosts.size());
+  std::vector<double> weights(hosts.size(), 1.0);
+  std::vector<double> latencies;
+  for (size_t i = 0; i < hosts.size(); ++i) {
+    entries[i] = find(hosts[i]);
+    if (entries[i]) {
+      entry& e = *entries[i];
+      scoped_lock lk(e.m);
+      weights[i] = update_ejection(e, t);
+      if (!e.ejected && MIN_LATENCY_SAMPLES <= e.samples) {
+        latencies.push_back(e.latency);
+      }
+    }
+  }
+
+  if (0 < eject_latency_ratio_ && MIN_LATENCY_SERVERS <= latencies.size()) {
+    std::nth_element(latencies.begin(),
+                     latencies.begin() + latencies.size() / 2,
+                     latencies.end());
+    const double limit =
+        latencies[latencies.size() / 2] * eject_latency_ratio_;
+    for (size_t i = 0; i < hosts.size(); ++i) {
+      if (entries[i]) {
+        entry& e = *entries[i];
+        scoped_lock lk(e.m);
+        if (!e.ejected && MIN_LATENCY_SAMPLES <= e.samples &&
+            limit < e.latency) {
+          eject(e, t);
+          weights[i] = 0;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < hosts.size(); ++i) {
+    if (0 < weights[i] &&
+        (1.0 <= weights[i] || rng.next_double() < weights[i])) {
+      admitted.push_back(i);
+    }
+  }
+
+  // too many servers are ejected; rejecting most requests is worse than
+  // sending them to unhealthy servers
+  if (admitted.size() * 2 < hosts.size()) {
+    admitted.clear();
+    for (size_t i = 0; i < hosts.size(); ++i) {
+      admitted.push_back(i);
+    }
+  }
+}
+
+void backend_load::get_status(
+    std::map<std::string, std::string>& status) const {
+  scoped_rlock lk(m_);
+  for (std::map<host_type, entry_ptr>::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    const std::string prefix = "backend." + it->first.first + "_"
+        + lexical_cast<std::string>(it->first.second);
+    const entry& e = *it->second;
+    scoped_lock elk(e.m);
+    status[prefix + ".in_flight"] = lexical_cast<std::string>(e.in_flight);
+    status[prefix + ".latency_ewma"] = lexical_cast<std::string>(e.latency);
+    status[prefix + ".requests"] = lexical_cast<std::string>(e.requests);
+    status[prefix + ".errors"] = lexical_cast<std::string>(e.errors);
+    if (ejection_enabled()) {
+      status[prefix + ".ejected"] = lexical_cast<std::string>(e.ejected);
+      status[prefix + ".ejections"] = lexical_cast<std::string>(e.ejections);
+    }
+  }
+}
+
+backend_load::entry_ptr backend_load::find(const host_type& host) const {
+  scoped_rlock lk(m_);
+  std::map<host_type, entry_ptr>::const_iterator it = entries_.find(host);
+  return it == entries_.end() ? entry_ptr() : it->second;
+}
+
+backend_load::entry_ptr backend_load::get(const host_type& host) {
+  entry_ptr e = find(host);
+  if (!e) {
+    scoped_wlock lk(m_);
+    entry_ptr& p = entries_[host];
+    if (!p) {
+      p.reset(new entry);
+    }
+    e = p;
+  }
+  return e;
+}
+
+bool backend_load::less_loaded(
+    const host_type& lhs,
+    const host_type& rhs) const {
+  // servers not used yet have no load
+  uint64_t lhs_in_flight = 0, rhs_in_flight = 0;
+  double lhs_latency = 0, rhs_latency = 0;
+  if (entry_ptr e = find(lhs)) {
+    scoped_lock lk(e->m);
+    lhs_in_flight = e->in_flight;
+    lhs_latency = e->latency;
+  }
+  if (entry_ptr e = find(rhs)) {
+    scoped_lock lk(e->m);
+    rhs_in_flight = e->in_flight;
+    rhs_latency = e->latency;
+  }
+
+  if (lhs_latency == 0 || rhs_latency == 0) {
+    return lhs_in_flight < rhs_in_flight;
+  }
+  // expected time to finish the requests already queued and a new one
+  return (lhs_in_flight + 1) * lhs_latency
+      < (rhs_in_flight + 1) * rhs_latency;
+}
+
+double backend_load::now() const {
+  return get_clock_time() - start_;
+}
+
+void backend_load::eject(entry& e, double now) const {
+  uint64_t backoff = 1;
+  for (uint64_t i = 0;
+       i < e.ejections_in_row && backoff < MAX_EJECTION_BACKOFF; ++i) {
+    backoff *= 2;
+  }
+  e.ejected = true;
+  e.ejected_at = now;
+  e.ejected_for = eject_sec_ * backoff;
+  ++e.ejections_in_row;
+  ++e.ejections;
+}
+
+double backend_load::update_ejection(entry& e, double now) const {
+  if (e.ejected_for == 0) {
+    return 1.0;
+  }
+  const double readmitted_at = e.ejected_at + e.ejected_for;
+  if (now < readmitted_at) {
+    return 0;
+  }
+  if (e.ejected) {
+    // the latency and failures before the ejection are forgotten
+    e.ejected = false;
+    e.latency = 0;
+    e.samples = 0;
+    e.failures_in_row = 0;
+  }
+  if (readmitted_at + e.ejected_for <= now) {
+    // the server has recovered
+    e.ejected_for = 0;
+    e.ejections_in_row = 0;
+    return 1.0;
+  }
+  return (now - readmitted_at) / e.ejected_for;
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
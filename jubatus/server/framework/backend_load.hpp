@@ -0,0 +1,153 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_BACKEND_LOAD_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_BACKEND_LOAD_HPP_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/rwmutex.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/util/math/random.h"
+#include "jubatus/util/system/time_util.h"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * Load of each backend server seen from a proxy.
+ *
+ * The proxy calls begin() when it forwards a request to a server and end()
+ * when the response arrives (or the request fails), so the number of
+ * requests in flight and the moving average (EWMA) of the latency are kept
+ * for each server.  choose() uses them for the power-of-two-choices
+ * balancing: it picks two servers at random and returns the less loaded one.
+ *
+ * Servers may also be ejected passively (outlier detection): a server
+ * failing eject_failures times in a row (timeouts included), or whose
+ * latency is more than eject_latency_ratio times the median of the
+ * cluster, is not admitted for eject_sec.  The period is doubled while it
+ * is ejected again and again.  Then it is re-admitted gradually: the
+ * probability to admit it grows linearly over another eject_sec.
+ */
+class backend_load : jubatus::util::lang::noncopyable {
+ public:
+  typedef std::pair<std::string, int> host_type;
+
+  // failed requests are counted as if they took failure_penalty_sec, so
+  // that a server refusing requests quickly is not preferred
+  // servers are never ejected if eject_sec is 0, and eject_failures or
+  // eject_latency_ratio of 0 disables each kind of ejection
+  backend_load(
+      double decay,
+      double failure_penalty_sec,
+      int eject_failures = 0,
+      double eject_latency_ratio = 0,
+      double eject_sec = 0);
+
+  bool ejection_enabled() const {
+    return eject_sec_ > 0 && (eject_failures_ > 0 || eject_latency_ratio_ > 0);
+  }
+
+  void begin(const host_type& host);
+  // refused means that the server answered with an error, so the failure
+  // does not eject it (e.g. the requested row is not in the server) and
+  // the measured latency is recorded without the penalty
+  void end(
+      const host_type& host,
+      double latency_sec,
+      bool failed,
+      bool refused = false);
+  // the response is not waited for (e.g. another server answered first)
+  void cancel(const host_type& host);
+
+  // returns an index of hosts, which must not be empty
+  size_t choose(
+      const std::vector<host_type>& hosts,
+      jubatus::util::math::random::mtrand& rng) const;
+
+  // sets indexes of hosts admitted for a new request, which exclude
+  // ejected servers unless more than half of the servers are ejected
+  void admit(
+      const std::vector<host_type>& hosts,
+      jubatus::util::math::random::mtrand& rng,
+      std::vector<size_t>& admitted);
+
+  void get_status(std::map<std::string, std::string>& status) const;
+
+ private:
+  struct entry {
+    entry()
+        : in_flight(0),
+          latency(0),
+          requests(0),
+          errors(0),
+          failures_in_row(0),
+          samples(0),
+          ejected(false),
+          ejected_at(0),
+          ejected_for(0),
+          ejections_in_row(0),
+          ejections(0) {
+    }
+
+    mutable jubatus::util::concurrent::mutex m;
+    uint64_t in_flight;
+    double latency;  // zero until the first response
+    uint64_t requests;
+    uint64_t errors;
+
+    uint64_t failures_in_row;
+    uint64_t samples;  // responses since the server is (re-)admitted
+    bool ejected;
+    double ejected_at;  // seconds from start_
+    double ejected_for;  // zero unless ejected or being re-admitted
+    uint64_t ejections_in_row;
+    uint64_t ejections;
+  };
+  typedef jubatus::util::lang::shared_ptr<entry> entry_ptr;
+
+  entry_ptr find(const host_type& host) const;
+  entry_ptr get(const host_type& host);
+  bool less_loaded(const host_type& lhs, const host_type& rhs) const;
+  double now() const;
+  void eject(entry& e, double now) const;
+  // returns the probability to admit the server (0 if ejected)
+  double update_ejection(entry& e, double now) const;
+
+  const double decay_;
+  const double failure_penalty_sec_;
+  const int eject_failures_;
+  const double eject_latency_ratio_;
+  const double eject_sec_;
+  const jubatus::util::system::time::clock_time start_;
+
+  // entries are only added; each of them has its own lock
+  mutable jubatus::util::concurrent::rw_mutex m_;
+  std::map<host_type, entry_ptr> entries_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_BACKEND_LOAD_HPP_
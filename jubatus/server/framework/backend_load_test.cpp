@@ -0,0 +1,180 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/math/random.h"
+#include "backend_load.hpp"
+
+using std::make_pair;
+using std::map;
+using std::string;
+using std::vector;
+using jubatus::util::math::random::mtrand;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+TEST(backend_load, status) {
+  backend_load load(0.5, 10);
+  const backend_load::host_type h = make_pair(string("127.0.0.1"), 9199);
+  load.begin(h);
+  load.begin(h);
+  load.end(h, 1.0, false);
+
+  map<string, string> status;
+  load.get_status(status);
+  EXPECT_EQ("1", status["backend.127.0.0.1_9199.in_flight"]);
+  EXPECT_EQ("1", status["backend.127.0.0.1_9199.requests"]);
+  EXPECT_EQ("0", status["backend.127.0.0.1_9199.errors"]);
+  EXPECT_EQ("1", status["backend.127.0.0.1_9199.latency_ewma"]);
+
+  // failures are counted as the penalty
+  load.end(h, 0.1, true);
+  status.clear();
+  load.get_status(status);
+  EXPECT_EQ("0", status["backend.127.0.0.1_9199.in_flight"]);
+  EXPECT_EQ("1", status["backend.127.0.0.1_9199.errors"]);
+  EXPECT_EQ("5.5", status["backend.127.0.0.1_9199.latency_ewma"]);
+
+  // errors answered by the server are counted with their latency
+  load.begin(h);
+  load.end(h, 0.5, true, true);
+  status.clear();
+  load.get_status(status);
+  EXPECT_EQ("2", status["backend.127.0.0.1_9199.errors"]);
+  EXPECT_EQ("3", status["backend.127.0.0.1_9199.latency_ewma"]);
+}
+
+TEST(backend_load, choose_less_loaded) {
+  backend_load load(0.5, 10);
+  vector<backend_load::host_type> hosts;
+  hosts.push_back(make_pair(string("10.0.0.1"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.2"), 9199));
+
+  // same latency, but the first one has more requests in flight
+  load.begin(hosts[0]);
+  load.end(hosts[0], 0.01, false);
+  load.begin(hosts[1]);
+  load.end(hosts[1], 0.01, false);
+  load.begin(hosts[0]);
+  load.begin(hosts[0]);
+
+  mtrand rng(1);
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(1u, load.choose(hosts, rng));
+  }
+
+  // slow server is avoided even if nothing is in flight
+  load.end(hosts[0], 1.0, false);
+  load.end(hosts[0], 1.0, false);
+  load.begin(hosts[1]);
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_EQ(1u, load.choose(hosts, rng));
+  }
+}
+
+TEST(backend_load, eject_failures) {
+  backend_load load(0.5, 10, 2, 0, 0.05);
+  vector<backend_load::host_type> hosts;
+  hosts.push_back(make_pair(string("10.0.0.1"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.2"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.3"), 9199));
+  mtrand rng(1);
+  vector<size_t> admitted;
+
+  // errors answered by the server do not eject it
+  load.end(hosts[0], 0.01, true, true);
+  load.end(hosts[0], 0.01, true, true);
+  load.admit(hosts, rng, admitted);
+  EXPECT_EQ(3u, admitted.size());
+
+  load.end(hosts[0], 0.01, true);
+  load.end(hosts[0], 0.01, false);
+  load.end(hosts[0], 0.01, true);
+  load.admit(hosts, rng, admitted);
+  EXPECT_EQ(3u, admitted.size());
+
+  load.end(hosts[0], 0.01, true);
+  load.admit(hosts, rng, admitted);
+  ASSERT_EQ(2u, admitted.size());
+  EXPECT_EQ(1u, admitted[0]);
+  EXPECT_EQ(2u, admitted[1]);
+
+  map<string, string> status;
+  load.get_status(status);
+  EXPECT_EQ("1", status["backend.10.0.0.1_9199.ejected"]);
+  EXPECT_EQ("1", status["backend.10.0.0.1_9199.ejections"]);
+
+  // re-admitted after the ejection and recovery periods
+  usleep(110000);
+  load.admit(hosts, rng, admitted);
+  EXPECT_EQ(3u, admitted.size());
+}
+
+TEST(backend_load, eject_slow_server) {
+  backend_load load(0.5, 10, 0, 3, 10);
+  vector<backend_load::host_type> hosts;
+  hosts.push_back(make_pair(string("10.0.0.1"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.2"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.3"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.4"), 9199));
+  for (int i = 0; i < 5; ++i) {
+    load.end(hosts[0], 0.01, false);
+    load.end(hosts[1], 0.01, false);
+    load.end(hosts[2], 0.02, false);
+    load.end(hosts[3], 0.1, false);
+  }
+
+  mtrand rng(1);
+  vector<size_t> admitted;
+  load.admit(hosts, rng, admitted);
+  ASSERT_EQ(3u, admitted.size());
+  EXPECT_EQ(2u, admitted[2]);
+}
+
+TEST(backend_load, eject_too_many) {
+  backend_load load(0.5, 10, 1, 0, 10);
+  vector<backend_load::host_type> hosts;
+  hosts.push_back(make_pair(string("10.0.0.1"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.2"), 9199));
+  hosts.push_back(make_pair(string("10.0.0.3"), 9199));
+  load.end(hosts[0], 0.01, true);
+  load.end(hosts[1], 0.01, true);
+
+  // all servers are used rather than only one of them
+  mtrand rng(1);
+  vector<size_t> admitted;
+  load.admit(hosts, rng, admitted);
+  EXPECT_EQ(3u, admitted.size());
+}
+
+TEST(backend_load, choose_single) {
+  backend_load load(0.5, 10);
+  vector<backend_load::host_type> hosts;
+  hosts.push_back(make_pair(string("10.0.0.1"), 9199));
+  mtrand rng(1);
+  EXPECT_EQ(0u, load.choose(hosts, rng));
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,411 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "cht_rebalancer.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/util/lang/weak_ptr.h"
+#include "jubatus/util/system/time_util.h"
+#include "jubatus/core/common/exception.hpp"
+#include "../common/logger/logger.hpp"
+#include "../common/membership.hpp"
+
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::lang::shared_ptr;
+using jubatus::util::lang::weak_ptr;
+using jubatus::util::system::time::clock_time;
+using jubatus::util::system::time::get_clock_time;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+// membership changes in bursts (e.g. all virtual nodes of a server), so
+// the rebalancer waits for it to settle
+const double SETTLE_SEC = 1.0;
+
+// interval to retry watching the ring after failures
+const double RETRY_SEC = 5.0;
+
+typedef rebalance_source::node_type node_type;
+
+// releases the lock while sending rows, not to block status requests
+class scoped_unlock {
+ public:
+  explicit scoped_unlock(jubatus::util::concurrent::mutex& m)
+      : m_(m) {
+    m_.unlock();
+  }
+  ~scoped_unlock() {
+    m_.lock();
+  }
+
+ private:
+  jubatus::util::concurrent::mutex& m_;
+};
+
+void unique_owners(
+    const common::cht_ring& ring,
+    const std::string& id,
+    size_t replicas,
+    std::vector<node_type>& out) {
+  ring.find(id, out, replicas);
+  std::vector<node_type> owners;
+  for (size_t i = 0; i < out.size(); ++i) {
+    if (std::find(owners.begin(), owners.end(), out[i]) == owners.end()) {
+      owners.push_back(out[i]);
+    }
+  }
+  out.swap(owners);
+}
+
+bool contains(const std::vector<node_type>& nodes, const node_type& node) {
+  return std::find(nodes.begin(), nodes.end(), node) != nodes.end();
+}
+
+}  // namespace
+
+void cht_rebalancer::plan(
+    const common::cht_ring& old_ring,
+    const common::cht_ring& new_ring,
+    const node_type& self,
+    size_t replicas,
+    const std::vector<std::string>& ids,
+    std::vector<row_move>& moves) {
+  moves.clear();
+  std::map<node_type, common::cht_ring::node_share> members;
+  new_ring.get_shares(members);
+
+  std::vector<node_type> old_owners, new_owners;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    unique_owners(old_ring, ids[i], replicas, old_owners);
+    unique_owners(new_ring, ids[i], replicas, new_owners);
+
+    // the first previous owner still in the ring sends the row
+    bool sender = true;
+    for (size_t j = 0; j < old_owners.size(); ++j) {
+      if (members.count(old_owners[j])) {
+        sender = old_owners[j] == self;
+        break;
+      }
+    }
+    if (!sender) {
+      continue;
+    }
+
+    row_move move;
+    for (size_t j = 0; j < new_owners.size(); ++j) {
+      if (new_owners[j] != self && !contains(old_owners, new_owners[j])) {
+        move.to.push_back(new_owners[j]);
+      }
+    }
+    if (!move.to.empty()) {
+      move.id = ids[i];
+      moves.push_back(move);
+    }
+  }
+}
+
+class cht_rebalancer::state {
+ public:
+  state(
+      shared_ptr<common::lock_service> ls,
+      const std::string& type,
+      const std::string& name,
+      const node_type& self,
+      size_t replicas,
+      int rows_per_sec,
+      rebalance_source& source)
+      : ls_(ls),
+        type_(type),
+        name_(name),
+        self_node_(self),
+        replicas_(replicas),
+        rows_per_sec_(rows_per_sec),
+        source_(source),
+        running_(false),
+        stopping_(false),
+        watching_(false),
+        changed_(false),
+        retrying_(false),
+        passes_(0),
+        rows_checked_(0),
+        rows_to_move_(0),
+        rows_moved_(0),
+        rows_removed_(0),
+        rows_failed_(0) {
+    common::build_actor_path(path_, type, name);
+    path_ += "/cht";
+  }
+
+  void set_self(const weak_ptr<state>& self) {
+    self_ = self;
+  }
+
+  void start() {
+    scoped_lock lk(m_);
+    if (thread_) {
+      return;
+    }
+    ring_ = watch_and_load();
+    thread_.reset(new jubatus::util::concurrent::thread(
+        jubatus::util::lang::bind(&state::run, this)));
+    thread_->start();
+  }
+
+  void stop() {
+    {
+      scoped_lock lk(m_);
+      if (!thread_ || stopping_) {
+        return;
+      }
+      stopping_ = true;
+      cond_.notify_all();
+    }
+    thread_->join();
+  }
+
+  static void on_event(
+      weak_ptr<state> w,
+      int type,
+      int zk_state,
+      const std::string& path) {
+    shared_ptr<state> s = w.lock();
+    if (!s) {
+      return;
+    }
+    DLOG(INFO) << "rebalancer got CHT event (" << type << "): " << path;
+    scoped_lock lk(s->m_);
+    s->watching_ = false;
+    s->changed_ = true;
+    s->cond_.notify_all();
+  }
+
+  void get_status(std::map<std::string, std::string>& status) const {
+    scoped_lock lk(m_);
+    status["rebalance.state"] = running_ ? "running" : "idle";
+    status["rebalance.rows_per_sec"] =
+        lexical_cast<std::string>(rows_per_sec_);
+    status["rebalance.passes"] = lexical_cast<std::string>(passes_);
+    status["rebalance.rows_checked"] =
+        lexical_cast<std::string>(rows_checked_);
+    status["rebalance.rows_to_move"] =
+        lexical_cast<std::string>(rows_to_move_);
+    status["rebalance.rows_moved"] = lexical_cast<std::string>(rows_moved_);
+    status["rebalance.rows_removed"] =
+        lexical_cast<std::string>(rows_removed_);
+    status["rebalance.rows_failed"] = lexical_cast<std::string>(rows_failed_);
+  }
+
+ private:
+  // called with m_ locked
+  shared_ptr<const common::cht_ring> watch_and_load() {
+    // set the watcher before loading, not to miss changes in between
+    if (!watching_) {
+      watching_ = ls_->bind_child_watcher(path_,
+          jubatus::util::lang::bind(&state::on_event, self_,
+              jubatus::util::lang::_1, jubatus::util::lang::_2,
+              jubatus::util::lang::_3));
+    }
+    try {
+      return common::cht_ring::load(*ls_, type_, name_);
+    } catch (const core::common::exception::jubatus_exception& e) {
+      LOG(WARNING) << "rebalancer failed to load CHT: " << e.what();
+      return shared_ptr<const common::cht_ring>();
+    }
+  }
+
+  void run() {
+    scoped_lock lk(m_);
+    while (!stopping_) {
+      if (!changed_ && watching_ && !retrying_) {
+        cond_.wait(m_);
+        continue;
+      }
+      // retries later if the watcher could not be set, or the last pass
+      // failed
+      cond_.wait(m_, changed_ ? SETTLE_SEC : RETRY_SEC);
+      if (stopping_) {
+        break;
+      }
+      changed_ = false;
+
+      shared_ptr<const common::cht_ring> ring = watch_and_load();
+      if (!ring) {
+        retrying_ = true;
+        continue;
+      }
+      // the pass is repeated from ring_ until all rows are sent
+      retrying_ = ring_ && !rebalance(*ring_, *ring);
+      if (!retrying_) {
+        ring_ = ring;
+      }
+    }
+  }
+
+  // called with m_ locked; returns false if interrupted or some rows could
+  // not be sent
+  bool rebalance(
+      const common::cht_ring& old_ring,
+      const common::cht_ring& new_ring) {
+    running_ = true;
+    ++passes_;
+    bool completed = false;
+    try {
+      completed = rebalance_rows(old_ring, new_ring);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "rebalancer failed: " << e.what();
+    }
+    running_ = false;
+    return completed;
+  }
+
+  bool rebalance_rows(
+      const common::cht_ring& old_ring,
+      const common::cht_ring& new_ring) {
+    std::vector<std::string> ids;
+    {
+      scoped_unlock ulk(m_);
+      source_.get_row_ids(ids);
+    }
+
+    std::vector<row_move> moves;
+    plan(old_ring, new_ring, self_node_, replicas_, ids, moves);
+    rows_checked_ += ids.size();
+    rows_to_move_ += moves.size();
+    LOG(INFO) << "rebalancing " << moves.size() << " of " << ids.size()
+              << " rows";
+
+    const clock_time start = get_clock_time();
+    bool completed = true;
+    for (size_t i = 0; i < moves.size(); ++i) {
+      if (changed_ || stopping_) {
+        LOG(INFO) << "rebalancing interrupted after " << i << " rows";
+        return false;
+      }
+
+      bool failed = false;
+      bool removed = false;
+      {
+        scoped_unlock ulk(m_);
+        for (size_t j = 0; j < moves[i].to.size() && !removed; ++j) {
+          try {
+            removed = !source_.send_row(moves[i].id, moves[i].to[j]);
+          } catch (const std::exception& e) {
+            LOG(WARNING) << "failed to move row " << moves[i].id << " to "
+                         << moves[i].to[j].first << ":"
+                         << moves[i].to[j].second << ": " << e.what();
+            failed = true;
+          }
+        }
+      }
+      if (failed) {
+        ++rows_failed_;
+        completed = false;
+      } else if (removed) {
+        ++rows_removed_;
+      } else {
+        ++rows_moved_;
+      }
+
+      // waits not to exceed rows_per_sec_
+      const double wait = static_cast<double>(i + 1) / rows_per_sec_
+          - (get_clock_time() - start);
+      if (0 < wait) {
+        cond_.wait(m_, wait);
+      }
+    }
+    if (!completed) {
+      LOG(WARNING) << "rebalancing failed for some rows, retrying in "
+                   << RETRY_SEC << " sec";
+    }
+    return completed;
+  }
+
+  const shared_ptr<common::lock_service> ls_;
+  const std::string type_;
+  const std::string name_;
+  const node_type self_node_;
+  const size_t replicas_;
+  const int rows_per_sec_;
+  rebalance_source& source_;
+  std::string path_;
+  weak_ptr<state> self_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  jubatus::util::concurrent::condition cond_;
+  jubatus::util::lang::shared_ptr<jubatus::util::concurrent::thread> thread_;
+  // the ring for which rows have been moved
+  shared_ptr<const common::cht_ring> ring_;
+  bool running_;
+  bool stopping_;
+  bool watching_;
+  bool changed_;
+  bool retrying_;
+
+  uint64_t passes_;
+  uint64_t rows_checked_;
+  uint64_t rows_to_move_;
+  uint64_t rows_moved_;
+  uint64_t rows_removed_;
+  uint64_t rows_failed_;
+};
+
+cht_rebalancer::cht_rebalancer(
+    shared_ptr<common::lock_service> ls,
+    const std::string& type,
+    const std::string& name,
+    const node_type& self,
+    size_t replicas,
+    int rows_per_sec,
+    rebalance_source& source)
+    : state_(new state(ls, type, name, self, replicas, rows_per_sec, source)) {
+  state_->set_self(state_);
+}
+
+cht_rebalancer::~cht_rebalancer() {
+  stop();
+}
+
+void cht_rebalancer::start() {
+  state_->start();
+}
+
+void cht_rebalancer::stop() {
+  state_->stop();
+}
+
+void cht_rebalancer::get_status(
+    std::map<std::string, std::string>& status) const {
+  state_->get_status(status);
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,110 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_CHT_REBALANCER_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_CHT_REBALANCER_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "../common/cht.hpp"
+#include "../common/lock_service.hpp"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * Rows of a server distributed by CHT, which cht_rebalancer moves.
+ * Methods are called from the thread of the rebalancer, so they must lock
+ * the model by themselves.
+ */
+class rebalance_source {
+ public:
+  typedef std::pair<std::string, int> node_type;
+
+  virtual ~rebalance_source() {}
+
+  // IDs of rows stored in this server
+  virtual void get_row_ids(std::vector<std::string>& ids) = 0;
+
+  // sends the row to the server (e.g. by its update method); returns false
+  // if the row has been removed, and throws if the server fails
+  virtual bool send_row(const std::string& id, const node_type& to) = 0;
+};
+
+struct row_move {
+  std::string id;
+  std::vector<rebalance_source::node_type> to;
+};
+
+/**
+ * Moves rows to their new owners when the CHT membership changes.
+ *
+ * A child watcher of <name>/cht wakes the rebalancer, which compares the
+ * ring it has moved rows for with the current one.  Only rows whose owners
+ * have changed are sent to the new owners, at most rows_per_sec rows per
+ * second, so that requests are not starved.  Each row is sent by the
+ * first of its previous owners still in the ring (or by all servers
+ * holding it if none is).  If the membership changes again during a
+ * pass, the pass starts over with the latest ring; rows already sent are
+ * just updated again.  A pass in which some rows could not be sent is
+ * repeated a few seconds later in the same way.
+ *
+ * Copies of moved rows are not removed from the previous owners.
+ */
+class cht_rebalancer : jubatus::util::lang::noncopyable {
+ public:
+  typedef rebalance_source::node_type node_type;
+
+  cht_rebalancer(
+      jubatus::util::lang::shared_ptr<common::lock_service> ls,
+      const std::string& type,
+      const std::string& name,
+      const node_type& self,
+      size_t replicas,
+      int rows_per_sec,
+      rebalance_source& source);
+  ~cht_rebalancer();
+
+  // loads the current ring and starts watching it
+  void start();
+  void stop();
+
+  void get_status(std::map<std::string, std::string>& status) const;
+
+  // rows of ids which this server sends when the ring is changed
+  static void plan(
+      const common::cht_ring& old_ring,
+      const common::cht_ring& new_ring,
+      const node_type& self,
+      size_t replicas,
+      const std::vector<std::string>& ids,
+      std::vector<row_move>& moves);
+
+ private:
+  class state;
+  jubatus::util::lang::shared_ptr<state> state_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_CHT_REBALANCER_HPP_
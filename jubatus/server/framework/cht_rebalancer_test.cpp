@@ -0,0 +1,230 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/lang/cast.h"
+#include "cht_rebalancer.hpp"
+#include "../common/cht.hpp"
+#include "../common/membership.hpp"
+
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+using jubatus::server::common::cht_ring;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+typedef cht_rebalancer::node_type node_type;
+
+const size_t REPLICAS = 2;
+
+node_type node(int port) {
+  return make_pair("192.168.0.1", port);
+}
+
+cht_ring make_ring(const vector<int>& ports) {
+  vector<pair<string, string> > entries;
+  for (size_t i = 0; i < ports.size(); ++i) {
+    for (unsigned int j = 0; j < common::NUM_VSERV; ++j) {
+      entries.push_back(make_pair(
+          common::make_hash(common::build_loc_str("192.168.0.1", ports[i], j)),
+          common::build_loc_str("192.168.0.1", ports[i])));
+    }
+  }
+  return cht_ring(entries);
+}
+
+vector<string> make_ids(size_t n) {
+  vector<string> ids;
+  for (size_t i = 0; i < n; ++i) {
+    ids.push_back("row" + jubatus::util::lang::lexical_cast<string>(i));
+  }
+  return ids;
+}
+
+bool contains(const vector<node_type>& nodes, const node_type& n) {
+  return std::find(nodes.begin(), nodes.end(), n) != nodes.end();
+}
+
+// successive virtual nodes may belong to the same server
+vector<node_type> owners(const cht_ring& ring, const string& id) {
+  vector<node_type> found, out;
+  ring.find(id, found, REPLICAS);
+  for (size_t i = 0; i < found.size(); ++i) {
+    if (!contains(out, found[i])) {
+      out.push_back(found[i]);
+    }
+  }
+  return out;
+}
+
+// number of times each row is sent to each node by all of the servers
+typedef map<pair<string, node_type>, int> sends_t;
+
+sends_t plan_all(
+    const cht_ring& old_ring,
+    const cht_ring& new_ring,
+    const vector<int>& ports,
+    const vector<string>& ids) {
+  sends_t sends;
+  for (size_t i = 0; i < ports.size(); ++i) {
+    // each server only has rows it owned
+    vector<string> stored;
+    for (size_t j = 0; j < ids.size(); ++j) {
+      if (contains(owners(old_ring, ids[j]), node(ports[i]))) {
+        stored.push_back(ids[j]);
+      }
+    }
+    vector<row_move> moves;
+    cht_rebalancer::plan(
+        old_ring, new_ring, node(ports[i]), REPLICAS, stored, moves);
+    for (size_t j = 0; j < moves.size(); ++j) {
+      for (size_t k = 0; k < moves[j].to.size(); ++k) {
+        EXPECT_NE(node(ports[i]), moves[j].to[k]);
+        ++sends[make_pair(moves[j].id, moves[j].to[k])];
+      }
+    }
+  }
+  return sends;
+}
+
+// every new owner receives rows it did not have exactly once, unless all
+// servers having them have left
+void expect_moved_once(
+    const cht_ring& old_ring,
+    const cht_ring& new_ring,
+    const vector<string>& ids,
+    const sends_t& sends) {
+  map<node_type, cht_ring::node_share> members;
+  new_ring.get_shares(members);
+
+  size_t expected = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const vector<node_type> old_owners = owners(old_ring, ids[i]);
+    const vector<node_type> new_owners = owners(new_ring, ids[i]);
+    bool lost = true;
+    for (size_t j = 0; j < old_owners.size(); ++j) {
+      if (members.count(old_owners[j])) {
+        lost = false;
+      }
+    }
+    if (lost) {
+      continue;
+    }
+    for (size_t j = 0; j < new_owners.size(); ++j) {
+      if (contains(old_owners, new_owners[j])) {
+        continue;
+      }
+      ++expected;
+      sends_t::const_iterator it =
+          sends.find(make_pair(ids[i], new_owners[j]));
+      ASSERT_TRUE(it != sends.end()) << ids[i];
+      EXPECT_EQ(1, it->second) << ids[i];
+    }
+  }
+  EXPECT_EQ(expected, sends.size());
+}
+
+}  // namespace
+
+TEST(cht_rebalancer, unchanged) {
+  vector<int> ports;
+  ports.push_back(9199);
+  ports.push_back(9200);
+  ports.push_back(9201);
+  const cht_ring ring = make_ring(ports);
+  const vector<string> ids = make_ids(1000);
+
+  EXPECT_TRUE(plan_all(ring, ring, ports, ids).empty());
+}
+
+TEST(cht_rebalancer, server_added) {
+  vector<int> ports;
+  ports.push_back(9199);
+  ports.push_back(9200);
+  ports.push_back(9201);
+  const cht_ring old_ring = make_ring(ports);
+  ports.push_back(9202);
+  const cht_ring new_ring = make_ring(ports);
+  const vector<string> ids = make_ids(1000);
+
+  const sends_t sends = plan_all(old_ring, new_ring, ports, ids);
+  expect_moved_once(old_ring, new_ring, ids, sends);
+
+  // only rows of the new server move
+  ASSERT_FALSE(sends.empty());
+  EXPECT_LT(sends.size(), ids.size());
+  for (sends_t::const_iterator it = sends.begin(); it != sends.end(); ++it) {
+    EXPECT_EQ(node(9202), it->first.second);
+  }
+}
+
+TEST(cht_rebalancer, server_removed) {
+  vector<int> ports;
+  ports.push_back(9199);
+  ports.push_back(9200);
+  ports.push_back(9201);
+  ports.push_back(9202);
+  const cht_ring old_ring = make_ring(ports);
+  ports.pop_back();
+  const cht_ring new_ring = make_ring(ports);
+  const vector<string> ids = make_ids(1000);
+
+  // the removed server does not take part in rebalancing
+  const sends_t sends = plan_all(old_ring, new_ring, ports, ids);
+  expect_moved_once(old_ring, new_ring, ids, sends);
+  ASSERT_FALSE(sends.empty());
+}
+
+TEST(cht_rebalancer, all_owners_removed) {
+  const cht_ring old_ring = make_ring(vector<int>(1, 9201));
+  vector<int> ports;
+  ports.push_back(9199);
+  ports.push_back(9200);
+  const cht_ring new_ring = make_ring(ports);
+  const vector<string> ids = make_ids(10);
+
+  // no previous owner is in the ring; the holder sends all rows
+  vector<row_move> moves;
+  cht_rebalancer::plan(old_ring, new_ring, node(9199), REPLICAS, ids, moves);
+  size_t expected = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (contains(owners(new_ring, ids[i]), node(9200))) {
+      ++expected;
+    }
+  }
+  ASSERT_LT(0u, expected);
+  ASSERT_EQ(expected, moves.size());
+  for (size_t i = 0; i < moves.size(); ++i) {
+    ASSERT_EQ(1u, moves[i].to.size());
+    EXPECT_EQ(node(9200), moves[i].to[0]);
+  }
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
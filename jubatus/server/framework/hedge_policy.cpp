@@ -0,0 +1,117 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "hedge_policy.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+// number of recent latencies to compute the percentile
+const size_t SAMPLE_SIZE = 1024;
+
+// the percentile is recomputed each time this number of latencies arrive;
+// no request is hedged until the first one
+const size_t UPDATE_INTERVAL = 64;
+
+// unused budget is saved up to this number of backup requests
+const double MAX_TOKENS = 10;
+
+}  // namespace
+
+hedge_policy::hedge_policy(double budget, double percentile)
+    : budget_(budget),
+      percentile_(percentile),
+      next_sample_(0),
+      new_samples_(0),
+      delay_(0),
+      tokens_(0),
+      requests_(0),
+      hedged_(0),
+      wins_(0) {
+}
+
+double hedge_policy::on_request() {
+  scoped_lock lk(m_);
+  ++requests_;
+  tokens_ = std::min(tokens_ + budget_, MAX_TOKENS);
+  return delay_;
+}
+
+bool hedge_policy::try_acquire() {
+  scoped_lock lk(m_);
+  if (tokens_ < 1) {
+    return false;
+  }
+  tokens_ -= 1;
+  ++hedged_;
+  return true;
+}
+
+void hedge_policy::on_response(double latency_sec, bool backup) {
+  scoped_lock lk(m_);
+  if (backup) {
+    ++wins_;
+  }
+  if (samples_.size() < SAMPLE_SIZE) {
+    samples_.push_back(latency_sec);
+  } else {
+    samples_[next_sample_] = latency_sec;
+    next_sample_ = (next_sample_ + 1) % SAMPLE_SIZE;
+  }
+  if (++new_samples_ >= UPDATE_INTERVAL) {
+    update_delay();
+  }
+}
+
+void hedge_policy::get_status(
+    std::map<std::string, std::string>& status) const {
+  scoped_lock lk(m_);
+  status["hedge.budget"] = lexical_cast<std::string>(budget_);
+  status["hedge.percentile"] = lexical_cast<std::string>(percentile_);
+  status["hedge.delay"] = lexical_cast<std::string>(delay_);
+  status["hedge.requests"] = lexical_cast<std::string>(requests_);
+  status["hedge.sent"] = lexical_cast<std::string>(hedged_);
+  status["hedge.wins"] = lexical_cast<std::string>(wins_);
+  status["hedge.rate"] = lexical_cast<std::string>(
+      requests_ == 0 ? 0.0 : static_cast<double>(hedged_) / requests_);
+}
+
+void hedge_policy::update_delay() {
+  std::vector<double> sorted(samples_);
+  const size_t k = std::min(
+      sorted.size() - 1,
+      static_cast<size_t>(sorted.size() * percentile_ / 100));
+  std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+  delay_ = sorted[k];
+  new_samples_ = 0;
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
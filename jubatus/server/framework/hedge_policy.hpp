@@ -0,0 +1,84 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_HEDGE_POLICY_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_HEDGE_POLICY_HPP_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/noncopyable.h"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * When to send a backup (hedged) request of an analysis method.
+ *
+ * The proxy sends the backup request to another server when the first one
+ * has not answered within delay(), the given percentile of the latencies
+ * observed recently.  The number of backup requests is limited to budget
+ * (a fraction) of the requests, so that a slow cluster is not overloaded by
+ * them.
+ */
+class hedge_policy : jubatus::util::lang::noncopyable {
+ public:
+  // budget of 0 disables hedging
+  hedge_policy(double budget, double percentile);
+
+  bool enabled() const {
+    return budget_ > 0;
+  }
+
+  // called for each request which may be hedged; returns the delay to send
+  // the backup request, or 0 if it should not be hedged (until enough
+  // latencies are observed)
+  double on_request();
+
+  // returns true if a backup request may be sent now
+  bool try_acquire();
+
+  // latency of the response used for a request
+  void on_response(double latency_sec, bool backup);
+
+  void get_status(std::map<std::string, std::string>& status) const;
+
+ private:
+  void update_delay();
+
+  const double budget_;
+  const double percentile_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  std::vector<double> samples_;  // ring buffer of recent latencies
+  size_t next_sample_;
+  size_t new_samples_;
+  double delay_;
+  double tokens_;
+
+  uint64_t requests_;
+  uint64_t hedged_;
+  uint64_t wins_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_HEDGE_POLICY_HPP_
@@ -0,0 +1,71 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <map>
+#include <string>
+#include <gtest/gtest.h>
+#include "hedge_policy.hpp"
+
+using std::map;
+using std::string;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+TEST(hedge_policy, disabled) {
+  hedge_policy p(0, 95);
+  EXPECT_FALSE(p.enabled());
+  EXPECT_EQ(0, p.on_request());
+  EXPECT_FALSE(p.try_acquire());
+}
+
+TEST(hedge_policy, delay_is_percentile) {
+  hedge_policy p(0.1, 95);
+  EXPECT_TRUE(p.enabled());
+
+  // not hedged until enough latencies are observed
+  EXPECT_EQ(0, p.on_request());
+  for (int i = 0; i < 100; ++i) {
+    p.on_response(i * 0.01, false);
+  }
+  const double delay = p.on_request();
+  EXPECT_LT(0.5, delay);
+  EXPECT_GT(0.7, delay);
+}
+
+TEST(hedge_policy, budget) {
+  hedge_policy p(0.25, 95);
+  // 8 requests allow 2 backup requests
+  for (int i = 0; i < 8; ++i) {
+    p.on_request();
+  }
+  EXPECT_TRUE(p.try_acquire());
+  EXPECT_TRUE(p.try_acquire());
+  EXPECT_FALSE(p.try_acquire());
+
+  p.on_response(0.1, true);
+  map<string, string> status;
+  p.get_status(status);
+  EXPECT_EQ("8", status["hedge.requests"]);
+  EXPECT_EQ("2", status["hedge.sent"]);
+  EXPECT_EQ("1", status["hedge.wins"]);
+  EXPECT_EQ("0.25", status["hedge.rate"]);
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,616 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "diff_quantizer.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/core/common/exception.hpp"
+
+using std::map;
+using std::string;
+using std::vector;
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+namespace {
+
+typedef msgpack::packer<msgpack::sbuffer> packer_t;
+
+// true for lists of (string, value) pairs, in which diffs of linear models
+// have features and labels
+bool is_keyed_list(const msgpack::object& o) {
+  if (o.type != msgpack::type::ARRAY || o.via.array.size == 0) {
+    return false;
+  }
+  for (uint32_t i = 0; i < o.via.array.size; ++i) {
+    const msgpack::object& e = o.via.array.ptr[i];
+    if (e.type != msgpack::type::ARRAY || e.via.array.size != 2
+        || e.via.array.ptr[0].type != msgpack::type::RAW) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_container(const msgpack::object& o) {
+  return o.type == msgpack::type::ARRAY || o.type == msgpack::type::MAP;
+}
+
+// replaces delta values in the tree with nil; is_value tells which of nils
+// in the structure are taken out values
+//
+// Only the values of keyed lists are deltas summed up by mix: a float, or
+// the first one of a tuple of scalars (e.g. v1 of val3_t, whose others
+// are covariances mixed by min).  Other floating point values (e.g. those
+// in maps, which recommender replaces by mix) are kept in the tree as is.
+class value_stripper {
+ public:
+  value_stripper(packer_t& pk, bool with_paths)
+      : pk_(pk),
+        with_paths_(with_paths) {
+  }
+
+  void strip(const msgpack::object& o) {
+    switch (o.type) {
+      case msgpack::type::NIL:
+        pk_.pack_nil();
+        is_value.push_back(false);
+        break;
+      case msgpack::type::ARRAY:
+        if (is_keyed_list(o)) {
+          strip_keyed_list(o);
+          break;
+        }
+        pk_.pack_array(o.via.array.size);
+        for (uint32_t i = 0; i < o.via.array.size; ++i) {
+          const size_t parent = path_.size();
+          append_path('a', i);
+          strip(o.via.array.ptr[i]);
+          path_.resize(parent);
+        }
+        break;
+      case msgpack::type::MAP:
+        pk_.pack_map(o.via.map.size);
+        for (uint32_t i = 0; i < o.via.map.size; ++i) {
+          // keys are kept as is
+          pk_.pack(o.via.map.ptr[i].key);
+          const size_t parent = path_.size();
+          append_path('m', o.via.map.ptr[i].key);
+          strip(o.via.map.ptr[i].val);
+          path_.resize(parent);
+        }
+        break;
+      default:
+        pk_.pack(o);
+    }
+  }
+
+  vector<double> values;
+  vector<bool> is_value;
+  // position of each value in the tree, keyed by keys of lists instead of
+  // indices, as features in diffs differ in each round
+  vector<string> paths;
+
+ private:
+  void strip_keyed_list(const msgpack::object& o) {
+    pk_.pack_array(o.via.array.size);
+    for (uint32_t i = 0; i < o.via.array.size; ++i) {
+      const msgpack::object& key = o.via.array.ptr[i].via.array.ptr[0];
+      const msgpack::object& val = o.via.array.ptr[i].via.array.ptr[1];
+      pk_.pack_array(2);
+      pk_.pack(key);
+      const size_t parent = path_.size();
+      append_path('k', key);
+      if (val.type == msgpack::type::DOUBLE) {
+        take_out(val);
+      } else if (is_delta_tuple(val)) {
+        pk_.pack_array(val.via.array.size);
+        take_out(val.via.array.ptr[0]);
+        for (uint32_t j = 1; j < val.via.array.size; ++j) {
+          strip(val.via.array.ptr[j]);
+        }
+      } else {
+        strip(val);
+      }
+      path_.resize(parent);
+    }
+  }
+
+  static bool is_delta_tuple(const msgpack::object& o) {
+    if (o.type != msgpack::type::ARRAY || o.via.array.size == 0
+        || o.via.array.ptr[0].type != msgpack::type::DOUBLE) {
+      return false;
+    }
+    for (uint32_t i = 1; i < o.via.array.size; ++i) {
+      if (is_container(o.via.array.ptr[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void take_out(const msgpack::object& o) {
+    pk_.pack_nil();
+    values.push_back(o.via.dec);
+    is_value.push_back(true);
+    if (with_paths_) {
+      paths.push_back(path_);
+    }
+  }
+
+  template<typename T>
+  void append_path(char kind, const T& key) {
+    if (with_paths_) {
+      msgpack::sbuffer packed;
+      msgpack::pack(packed, key);
+      path_ += kind;
+      path_.append(packed.data(), packed.size());
+    }
+  }
+
+  packer_t& pk_;
+  const bool with_paths_;
+  string path_;
+};
+
+struct greater_magnitude {
+  explicit greater_magnitude(const vector<double>& values)
+      : values_(values) {
+  }
+  bool operator()(size_t lhs, size_t rhs) const {
+    return std::fabs(values_[lhs]) > std::fabs(values_[rhs]);
+  }
+  const vector<double>& values_;
+};
+
+// zeroes values other than the k largest in magnitude; returns the number
+// of zeroed values
+uint64_t keep_top_k(vector<double>& values, size_t k) {
+  if (values.size() <= k) {
+    return 0;
+  }
+  vector<size_t> order(values.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::nth_element(order.begin(), order.begin() + k, order.end(),
+                   greater_magnitude(values));
+  uint64_t zeroed = 0;
+  for (size_t i = k; i < order.size(); ++i) {
+    if (values[order[i]] != 0) {
+      values[order[i]] = 0;
+      ++zeroed;
+    }
+  }
+  return zeroed;
+}
+
+class value_reader {
+ public:
+  value_reader(
+      const msgpack::object_raw& bitmap,
+      const vector<double>& values)
+      : bitmap_(bitmap),
+        values_(values),
+        slot_(0),
+        next_(0) {
+  }
+
+  // returns false if the nil is a genuine one
+  bool next(double& value) {
+    if (slot_ / 8 >= bitmap_.size) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "broken quantized diff: bitmap too short"));
+    }
+    const bool is_value =
+        (static_cast<unsigned char>(bitmap_.ptr[slot_ / 8]) >> (slot_ % 8)) & 1;
+    ++slot_;
+    if (!is_value) {
+      return false;
+    }
+    if (next_ >= values_.size()) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "broken quantized diff: too few values"));
+    }
+    value = values_[next_++];
+    return true;
+  }
+
+ private:
+  const msgpack::object_raw& bitmap_;
+  const vector<double>& values_;
+  size_t slot_;
+  size_t next_;
+};
+
+void restore(const msgpack::object& o, packer_t& pk, value_reader& reader) {
+  switch (o.type) {
+    case msgpack::type::NIL: {
+      double value;
+      if (reader.next(value)) {
+        pk.pack_double(value);
+      } else {
+        pk.pack_nil();
+      }
+      break;
+    }
+    case msgpack::type::ARRAY:
+      pk.pack_array(o.via.array.size);
+      for (uint32_t i = 0; i < o.via.array.size; ++i) {
+        restore(o.via.array.ptr[i], pk, reader);
+      }
+      break;
+    case msgpack::type::MAP:
+      pk.pack_map(o.via.map.size);
+      for (uint32_t i = 0; i < o.via.map.size; ++i) {
+        pk.pack(o.via.map.ptr[i].key);
+        restore(o.via.map.ptr[i].val, pk, reader);
+      }
+      break;
+    default:
+      pk.pack(o);
+  }
+}
+
+uint16_t to_half(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint16_t sign = (x >> 16) & 0x8000;
+  const int exp = static_cast<int>((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mant = x & 0x7fffff;
+
+  if (((x >> 23) & 0xff) == 0xff) {
+    // inf or nan
+    return sign | 0x7c00 | (mant ? 0x200 : 0);
+  }
+  if (exp >= 31) {
+    // saturate instead of overflowing to inf
+    return sign | 0x7bff;
+  }
+  if (exp <= 0) {
+    if (exp < -10) {
+      return sign;
+    }
+    // subnormal
+    mant |= 0x800000;
+    const int shift = 14 - exp;
+    uint32_t h = mant >> shift;
+    if ((mant >> (shift - 1)) & 1) {
+      ++h;
+    }
+    return sign | static_cast<uint16_t>(h);
+  }
+  uint32_t h = (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+  if (mant & 0x1000) {
+    ++h;  // carry into the exponent is still correct rounding
+  }
+  if (h >= 0x7c00) {
+    h = 0x7bff;
+  }
+  return sign | static_cast<uint16_t>(h);
+}
+
+float from_half(uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  const uint32_t exp = (h >> 10) & 0x1f;
+  const uint32_t mant = h & 0x3ff;
+
+  if (exp == 0) {
+    const float v = std::ldexp(static_cast<float>(mant), -24);
+    return sign ? -v : v;
+  }
+  uint32_t x;
+  if (exp == 31) {
+    x = sign | 0x7f800000 | (mant << 13);
+  } else {
+    x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+  }
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+void put_u16(string& out, uint16_t v) {
+  out += static_cast<char>(v >> 8);
+  out += static_cast<char>(v & 0xff);
+}
+
+uint16_t get_u16(const char* p) {
+  return static_cast<uint16_t>(
+      (static_cast<unsigned char>(p[0]) << 8) | static_cast<unsigned char>(p[1]));
+}
+
+void put_float(string& out, float f) {
+  uint32_t v;
+  memcpy(&v, &f, sizeof(v));
+  put_u16(out, static_cast<uint16_t>(v >> 16));
+  put_u16(out, static_cast<uint16_t>(v & 0xffff));
+}
+
+float get_float(const char* p) {
+  const uint32_t v =
+      (static_cast<uint32_t>(get_u16(p)) << 16) | get_u16(p + 2);
+  float f;
+  memcpy(&f, &v, sizeof(f));
+  return f;
+}
+
+void encode_values(
+    diff_quantizer::quantization_type type,
+    const vector<double>& values,
+    string& out) {
+  if (type == diff_quantizer::FP16) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      put_u16(out, to_half(static_cast<float>(values[i])));
+    }
+  } else if (type == diff_quantizer::INT8) {
+    for (size_t begin = 0; begin < values.size();
+         begin += diff_quantizer::BLOCK_SIZE) {
+      const size_t end =
+          std::min(values.size(), begin + diff_quantizer::BLOCK_SIZE);
+      float scale = 0;
+      for (size_t i = begin; i < end; ++i) {
+        scale = std::max(scale, static_cast<float>(std::fabs(values[i])));
+      }
+      put_float(out, scale);
+      for (size_t i = begin; i < end; ++i) {
+        const int code = scale == 0 ? 0 :
+            static_cast<int>(std::floor(values[i] / scale * 127 + 0.5));
+        const signed char c = static_cast<signed char>(
+            std::max(-127, std::min(127, code)));
+        out += static_cast<char>(c);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < values.size(); ++i) {
+      // 32-bit float is the precision mixables pack values in
+      put_float(out, static_cast<float>(values[i]));
+    }
+  }
+}
+
+void decode_values(
+    int type,
+    const msgpack::object_raw& blob,
+    size_t count,
+    vector<double>& values) {
+  values.resize(count);
+  const char* p = blob.ptr;
+  const char* const end = blob.ptr + blob.size;
+  if (type == diff_quantizer::FP16) {
+    if (static_cast<size_t>(end - p) < count * 2) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "broken quantized diff: too few values"));
+    }
+    for (size_t i = 0; i < count; ++i, p += 2) {
+      values[i] = from_half(get_u16(p));
+    }
+  } else if (type == diff_quantizer::INT8) {
+    for (size_t begin = 0; begin < count;
+         begin += diff_quantizer::BLOCK_SIZE) {
+      const size_t n = std::min(count - begin, diff_quantizer::BLOCK_SIZE);
+      if (static_cast<size_t>(end - p) < 4 + n) {
+        throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+            "broken quantized diff: too few values"));
+      }
+      const float scale = get_float(p);
+      p += 4;
+      for (size_t i = 0; i < n; ++i, ++p) {
+        values[begin + i] = static_cast<signed char>(*p) * scale / 127;
+      }
+    }
+  } else {
+    if (static_cast<size_t>(end - p) < count * 4) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "broken quantized diff: too few values"));
+    }
+    for (size_t i = 0; i < count; ++i, p += 4) {
+      values[i] = get_float(p);
+    }
+  }
+}
+
+}  // namespace
+
+quantization_residual::quantization_residual()
+    : has_pending_(false) {
+}
+
+void quantization_residual::commit() {
+  scoped_lock lk(m_);
+  if (has_pending_) {
+    values_.swap(pending_);
+    pending_.clear();
+    has_pending_ = false;
+  }
+}
+
+size_t quantization_residual::size() const {
+  scoped_lock lk(m_);
+  return values_.size();
+}
+
+diff_quantizer::diff_quantizer(
+    const string& quantization,
+    double sparsify_threshold,
+    size_t sparsify_top_k)
+    : threshold_(sparsify_threshold),
+      top_k_(sparsify_top_k),
+      values_(0),
+      zeroed_(0),
+      max_error_(0) {
+  if (quantization == "none" || quantization.empty()) {
+    type_ = NONE;
+  } else if (quantization == "fp16") {
+    type_ = FP16;
+  } else if (quantization == "int8") {
+    type_ = INT8;
+  } else {
+    throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+        "unknown MIX quantization: " + quantization));
+  }
+  if (threshold_ < 0) {
+    throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+        "sparsify threshold must not be negative: "
+        + lexical_cast<string>(threshold_)));
+  }
+}
+
+void diff_quantizer::quantize(
+    const char* data,
+    size_t size,
+    msgpack::sbuffer& out,
+    quantization_residual* residual) const {
+  msgpack::unpacked msg;
+  msgpack::unpack(&msg, data, size);
+
+  packer_t pk(&out);
+  pk.pack_array(5);
+  pk.pack(static_cast<int>(type_));
+
+  value_stripper stripper(pk, residual != NULL);
+  stripper.strip(msg.get());
+  vector<double>& values = stripper.values;
+  const vector<bool>& is_value = stripper.is_value;
+
+  string bitmap((is_value.size() + 7) / 8, '\0');
+  for (size_t i = 0; i < is_value.size(); ++i) {
+    if (is_value[i]) {
+      bitmap[i / 8] |= static_cast<char>(1 << (i % 8));
+    }
+  }
+  pk.pack_raw(bitmap.size());
+  pk.pack_raw_body(bitmap.data(), bitmap.size());
+
+  // errors of the previous rounds not yet sent
+  map<string, double> carried;
+  if (residual) {
+    scoped_lock lk(residual->m_);
+    carried = residual->values_;
+  }
+  if (residual) {
+    const vector<string>& paths = stripper.paths;
+    for (size_t i = 0; i < values.size(); ++i) {
+      const map<string, double>::iterator it = carried.find(paths[i]);
+      if (it != carried.end()) {
+        values[i] += it->second;
+        carried.erase(it);
+      }
+    }
+  }
+  const vector<double> exact = values;
+
+  uint64_t zeroed = 0;
+  if (threshold_ > 0) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (values[i] != 0 && std::fabs(values[i]) < threshold_) {
+        values[i] = 0;
+        ++zeroed;
+      }
+    }
+  }
+  if (top_k_ > 0) {
+    zeroed += keep_top_k(values, top_k_);
+  }
+
+  string blob;
+  encode_values(type_, values, blob);
+  pk.pack(static_cast<uint64_t>(values.size()));
+  pk.pack_raw(blob.size());
+  pk.pack_raw_body(blob.data(), blob.size());
+
+  // what the receivers get, to find the errors of this round
+  msgpack::object_raw encoded;
+  encoded.ptr = blob.data();
+  encoded.size = blob.size();
+  vector<double> sent;
+  decode_values(type_, encoded, values.size(), sent);
+
+  double max_error = 0;
+  for (size_t i = 0; i < exact.size(); ++i) {
+    const double error = exact[i] - sent[i];
+    max_error = std::max(max_error, std::fabs(error));
+    if (residual && error != 0) {
+      carried[stripper.paths[i]] = error;
+    }
+  }
+
+  if (residual) {
+    scoped_lock lk(residual->m_);
+    residual->pending_.swap(carried);
+    residual->has_pending_ = true;
+  }
+
+  scoped_lock lk(m_);
+  values_ += values.size();
+  zeroed_ += zeroed;
+  max_error_ = std::max(max_error_, max_error);
+}
+
+void diff_quantizer::dequantize(
+    const char* data,
+    size_t size,
+    msgpack::sbuffer& out) {
+  msgpack::unpacked msg;
+  msgpack::unpack(&msg, data, size);
+  const msgpack::object& o = msg.get();
+  if (o.type != msgpack::type::ARRAY || o.via.array.size != 5
+      || o.via.array.ptr[2].type != msgpack::type::RAW
+      || o.via.array.ptr[4].type != msgpack::type::RAW) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "broken quantized diff"));
+  }
+
+  vector<double> values;
+  decode_values(o.via.array.ptr[0].as<int>(),
+                o.via.array.ptr[4].via.raw,
+                o.via.array.ptr[3].as<uint64_t>(),
+                values);
+
+  value_reader reader(o.via.array.ptr[2].via.raw, values);
+  packer_t pk(&out);
+  restore(o.via.array.ptr[1], pk, reader);
+}
+
+void diff_quantizer::get_status(server_base::status_t& status) const {
+  static const char* const names[] = { "none", "fp16", "int8" };
+  scoped_lock lk(m_);
+  status["mix_quantization"] = names[type_];
+  status["mix_quantization.sparsify_threshold"] =
+      lexical_cast<string>(threshold_);
+  status["mix_quantization.sparsify_top_k"] = lexical_cast<string>(top_k_);
+  status["mix_quantization.values"] = lexical_cast<string>(values_);
+  status["mix_quantization.zeroed"] = lexical_cast<string>(zeroed_);
+  status["mix_quantization.max_error"] = lexical_cast<string>(max_error_);
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
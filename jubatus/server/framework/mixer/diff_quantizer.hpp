@@ -0,0 +1,130 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_MIXER_DIFF_QUANTIZER_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_MIXER_DIFF_QUANTIZER_HPP_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <msgpack.hpp>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "../server_base.hpp"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+class diff_quantizer;
+
+/**
+ * Errors of quantization carried over to the next diff, keyed by the
+ * position of the value in the msgpack tree (keys of lists and maps, and
+ * indices of other arrays), so that values dropped or rounded in one round
+ * are sent for the same feature in later ones.
+ *
+ * quantize() leaves the new residual pending; commit() makes it current
+ * once the diff has been applied.  A diff lost in a failed round is sent
+ * again by the mixable, and its residual must not be counted twice.
+ */
+class quantization_residual : jubatus::util::lang::noncopyable {
+ public:
+  quantization_residual();
+
+  void commit();
+
+  // number of values carried over
+  size_t size() const;
+
+ private:
+  friend class diff_quantizer;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  std::map<std::string, double> values_;
+  std::map<std::string, double> pending_;
+  bool has_pending_;
+};
+
+/**
+ * Lossy encoding of serialized diffs.
+ *
+ * Diffs are opaque msgpack produced by mixables, so the quantizer works on
+ * the msgpack tree.  Deltas summed up by mix are taken out of the tree:
+ * values of lists of (string, value) pairs, which are a float or the first
+ * float of a tuple (e.g. the weight of val3_t, not its covariance).  Other
+ * values are mixed otherwise (e.g. by min or replace) and are kept as is.
+ * Deltas smaller than the sparsify threshold in magnitude are zeroed, and
+ * the rest are stored as 16-bit floats or as 8-bit integers with a scale
+ * factor per block of BLOCK_SIZE values.
+ *
+ * With sparsify_top_k, only that many deltas of the largest magnitude are
+ * kept in each diff.
+ *
+ * dequantize() restores msgpack of the same shape which mixables can read
+ * as usual, with approximated values.
+ */
+class diff_quantizer : jubatus::util::lang::noncopyable {
+ public:
+  enum quantization_type {
+    NONE = 0,
+    FP16 = 1,
+    INT8 = 2
+  };
+
+  static const size_t BLOCK_SIZE = 256;
+
+  // quantization is "none", "fp16" or "int8"; sparsify_top_k of 0 keeps
+  // all values
+  diff_quantizer(
+      const std::string& quantization,
+      double sparsify_threshold,
+      size_t sparsify_top_k = 0);
+
+  // true if quantize() changes anything
+  bool enabled() const {
+    return type_ != NONE || threshold_ > 0 || top_k_ > 0;
+  }
+
+  // adds the residual to the values before quantization and stores the
+  // new errors in it, if given
+  void quantize(
+      const char* data,
+      size_t size,
+      msgpack::sbuffer& out,
+      quantization_residual* residual = NULL) const;
+  static void dequantize(const char* data, size_t size, msgpack::sbuffer& out);
+
+  void get_status(server_base::status_t& status) const;
+
+ private:
+  quantization_type type_;
+  double threshold_;
+  size_t top_k_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  mutable uint64_t values_;
+  mutable uint64_t zeroed_;
+  mutable double max_error_;
+};
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_MIXER_DIFF_QUANTIZER_HPP_
@@ -0,0 +1,324 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include <msgpack.hpp>
+#include "jubatus/core/common/exception.hpp"
+#include "diff_quantizer.hpp"
+
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+namespace {
+
+// shaped like diffs of linear models: a list of (feature, weight), plus a
+// counter
+typedef vector<pair<string, float> > weights_t;
+typedef map<string, float> weight_map;
+typedef pair<weights_t, int> diff_t;
+
+diff_t make_diff() {
+  weights_t w;
+  for (int i = 0; i < 1000; ++i) {
+    w.push_back(make_pair(
+        "f" + string(1, 'a' + i % 26) + std::string(i / 26 + 1, 'x'),
+        (i % 7 - 3) * 0.125f + i * 0.0001f));
+  }
+  return make_pair(w, 42);
+}
+
+weight_map to_map(const weights_t& w) {
+  return weight_map(w.begin(), w.end());
+}
+
+template<typename T>
+T round_trip(
+    const diff_quantizer& q,
+    const T& diff,
+    quantization_residual* residual = NULL) {
+  msgpack::sbuffer packed;
+  msgpack::pack(packed, diff);
+
+  msgpack::sbuffer quantized;
+  q.quantize(packed.data(), packed.size(), quantized, residual);
+  msgpack::sbuffer restored;
+  diff_quantizer::dequantize(quantized.data(), quantized.size(), restored);
+
+  msgpack::unpacked msg;
+  msgpack::unpack(&msg, restored.data(), restored.size());
+  T result;
+  msg.get().convert(&result);
+  return result;
+}
+
+void expect_close(const diff_t& expected, const diff_t& actual, double eps) {
+  EXPECT_EQ(expected.second, actual.second);
+  ASSERT_EQ(expected.first.size(), actual.first.size());
+  const weight_map actual_map = to_map(actual.first);
+  for (weights_t::const_iterator it = expected.first.begin();
+       it != expected.first.end(); ++it) {
+    weight_map::const_iterator found = actual_map.find(it->first);
+    ASSERT_TRUE(found != actual_map.end()) << it->first;
+    EXPECT_NEAR(it->second, found->second, eps) << it->first;
+  }
+}
+
+string max_error(const diff_quantizer& q) {
+  server_base::status_t status;
+  q.get_status(status);
+  return status["mix_quantization.max_error"];
+}
+
+}  // namespace
+
+TEST(diff_quantizer, none_is_exact) {
+  diff_quantizer q("none", 0);
+  EXPECT_FALSE(q.enabled());
+  const diff_t diff = make_diff();
+  expect_close(diff, round_trip(q, diff), 0);
+}
+
+TEST(diff_quantizer, fp16) {
+  diff_quantizer q("fp16", 0);
+  EXPECT_TRUE(q.enabled());
+  const diff_t diff = make_diff();
+  // values are at most 0.5, so the error is bounded by 2^-12
+  expect_close(diff, round_trip(q, diff), 1.0 / 4096);
+}
+
+TEST(diff_quantizer, int8) {
+  diff_quantizer q("int8", 0);
+  const diff_t diff = make_diff();
+  // half of the step of 127 levels up to the largest value of the block
+  expect_close(diff, round_trip(q, diff), 0.5 / 127 * 0.5 + 1e-6);
+}
+
+TEST(diff_quantizer, sparsify) {
+  diff_quantizer q("none", 0.01);
+  EXPECT_TRUE(q.enabled());
+  const diff_t diff = make_diff();
+  const weight_map result = to_map(round_trip(q, diff).first);
+  for (weights_t::const_iterator it = diff.first.begin();
+       it != diff.first.end(); ++it) {
+    const float v = result.find(it->first)->second;
+    if (std::fabs(it->second) < 0.01) {
+      EXPECT_EQ(0.0f, v) << it->first;
+    } else {
+      EXPECT_EQ(it->second, v) << it->first;
+    }
+  }
+}
+
+TEST(diff_quantizer, top_k) {
+  diff_quantizer q("none", 0, 10);
+  EXPECT_TRUE(q.enabled());
+  const diff_t diff = make_diff();
+  const diff_t result = round_trip(q, diff);
+  const weight_map result_map = to_map(result.first);
+
+  vector<float> magnitudes;
+  for (weights_t::const_iterator it = diff.first.begin();
+       it != diff.first.end(); ++it) {
+    magnitudes.push_back(std::fabs(it->second));
+  }
+  std::sort(magnitudes.begin(), magnitudes.end());
+  const float kth = magnitudes[magnitudes.size() - 10];
+
+  size_t kept = 0;
+  for (weights_t::const_iterator it = diff.first.begin();
+       it != diff.first.end(); ++it) {
+    const float v = result_map.find(it->first)->second;
+    if (v != 0) {
+      EXPECT_EQ(it->second, v) << it->first;
+      EXPECT_LE(kth, std::fabs(v)) << it->first;
+      ++kept;
+    }
+  }
+  EXPECT_EQ(10u, kept);
+  EXPECT_EQ(diff.second, result.second);
+}
+
+TEST(diff_quantizer, residual_carries_over) {
+  diff_quantizer q("int8", 0.2);
+  quantization_residual residual;
+  const diff_t diff = make_diff();
+
+  // the same diff in every round: what is sent in total approaches the sum
+  // of the diffs, although values are dropped or rounded in each round
+  const int rounds = 20;
+  weight_map sent;
+  for (int i = 0; i < rounds; ++i) {
+    const diff_t result = round_trip(q, diff, &residual);
+    residual.commit();
+    for (weights_t::const_iterator it = result.first.begin();
+         it != result.first.end(); ++it) {
+      sent[it->first] += it->second;
+    }
+  }
+  EXPECT_LT(0u, residual.size());
+
+  for (weights_t::const_iterator it = diff.first.begin();
+       it != diff.first.end(); ++it) {
+    // at most one round of the value, the threshold or the step of int8
+    // is still carried
+    EXPECT_NEAR(it->second * rounds, sent[it->first],
+                std::max(std::fabs(it->second), 0.2f) + 0.01)
+        << it->first;
+  }
+}
+
+TEST(diff_quantizer, residual_is_pending_until_commit) {
+  diff_quantizer q("none", 0.01);
+  quantization_residual residual;
+
+  weights_t w;
+  w.push_back(make_pair(string("small"), 0.006f));
+  w.push_back(make_pair(string("large"), 1.0f));
+  const diff_t diff = make_pair(w, 1);
+
+  weight_map result = to_map(round_trip(q, diff, &residual).first);
+  EXPECT_EQ(0.0f, result["small"]);
+  EXPECT_EQ(0u, residual.size());
+
+  // the round failed: the mixable sends the same diff again, and the
+  // uncommitted residual is not added to it
+  result = to_map(round_trip(q, diff, &residual).first);
+  EXPECT_EQ(0.0f, result["small"]);
+  residual.commit();
+  EXPECT_EQ(1u, residual.size());
+
+  // the next diff carries the value dropped once
+  result = to_map(round_trip(q, diff, &residual).first);
+  EXPECT_EQ(0.012f, result["small"]);
+  EXPECT_EQ(1.0f, result["large"]);
+  residual.commit();
+  EXPECT_EQ(0u, residual.size());
+}
+
+TEST(diff_quantizer, residual_follows_features) {
+  diff_quantizer q("none", 0.01);
+  quantization_residual residual;
+
+  weights_t w;
+  w.push_back(make_pair(string("small"), 0.006f));
+  w.push_back(make_pair(string("large"), 1.0f));
+  round_trip(q, make_pair(w, 1), &residual);
+  residual.commit();
+
+  // features of the next diff are in another order, and the dropped value
+  // is carried to the same feature, not to the same index
+  w.clear();
+  w.push_back(make_pair(string("other"), 1.0f));
+  w.push_back(make_pair(string("small"), 0.006f));
+  const weight_map result =
+      to_map(round_trip(q, make_pair(w, 1), &residual).first);
+  EXPECT_EQ(1.0f, result.find("other")->second);
+  EXPECT_EQ(0.012f, result.find("small")->second);
+}
+
+TEST(diff_quantizer, keeps_values_not_summed) {
+  diff_quantizer q("int8", 0.5);
+
+  // (feature, (weight, covariance, other)) like val3_t, and a map whose
+  // values are replaced by mix
+  vector<pair<string, vector<float> > > features;
+  vector<float> val(3);
+  val[0] = 0.25f;
+  val[1] = 0.125f;
+  val[2] = 0.375f;
+  features.push_back(make_pair(string("f"), val));
+  weight_map replaced;
+  replaced["r"] = 0.25f;
+  typedef pair<vector<pair<string, vector<float> > >, weight_map> model_t;
+
+  const model_t result = round_trip(q, make_pair(features, replaced));
+  ASSERT_EQ(1u, result.first.size());
+  ASSERT_EQ(3u, result.first[0].second.size());
+  // only the weight is sparsified
+  EXPECT_EQ(0.0f, result.first[0].second[0]);
+  EXPECT_EQ(0.125f, result.first[0].second[1]);
+  EXPECT_EQ(0.375f, result.first[0].second[2]);
+  EXPECT_EQ(0.25f, result.second.find("r")->second);
+}
+
+TEST(diff_quantizer, max_error) {
+  diff_quantizer q("none", 0.5);
+  weights_t w;
+  w.push_back(make_pair(string("large"), 1.0f));
+  round_trip(q, make_pair(w, 1));
+  // nothing is dropped
+  EXPECT_EQ("0", max_error(q));
+
+  w.push_back(make_pair(string("small"), 0.25f));
+  round_trip(q, make_pair(w, 1));
+  EXPECT_EQ("0.25", max_error(q));
+}
+
+TEST(diff_quantizer, keeps_nil_and_keys) {
+  diff_quantizer q("int8", 0);
+
+  msgpack::sbuffer packed;
+  msgpack::packer<msgpack::sbuffer> pk(&packed);
+  pk.pack_array(3);
+  pk.pack_nil();
+  pk.pack_map(1);
+  pk.pack_double(1.5);  // keys are not quantized
+  pk.pack_double(1.0);
+  pk.pack_nil();
+
+  msgpack::sbuffer quantized;
+  q.quantize(packed.data(), packed.size(), quantized);
+  msgpack::sbuffer restored;
+  diff_quantizer::dequantize(quantized.data(), quantized.size(), restored);
+
+  msgpack::unpacked msg;
+  msgpack::unpack(&msg, restored.data(), restored.size());
+  const msgpack::object& o = msg.get();
+  ASSERT_EQ(msgpack::type::ARRAY, o.type);
+  ASSERT_EQ(3u, o.via.array.size);
+  EXPECT_TRUE(o.via.array.ptr[0].is_nil());
+  EXPECT_TRUE(o.via.array.ptr[2].is_nil());
+  const msgpack::object& m = o.via.array.ptr[1];
+  ASSERT_EQ(msgpack::type::MAP, m.type);
+  EXPECT_EQ(1.5, m.via.map.ptr[0].key.as<double>());
+  EXPECT_EQ(1.0, m.via.map.ptr[0].val.as<double>());
+}
+
+TEST(diff_quantizer, invalid_parameter) {
+  EXPECT_THROW(diff_quantizer("int4", 0),
+               core::common::exception::jubatus_exception);
+  EXPECT_THROW(diff_quantizer("none", -1),
+               core::common::exception::jubatus_exception);
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
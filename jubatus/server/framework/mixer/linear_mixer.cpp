@@ -16,6 +16,9 @@
 
 #include "linear_mixer.hpp"
 
+#include <string.h>
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <string>
 #include <sstream>
@@ -26,6 +29,7 @@
 
 #include "jubatus/util/concurrent/lock.h"
 #include "jubatus/util/lang/bind.h"
+#include "jubatus/util/lang/cast.h"
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/util/system/time_util.h"
 #include "jubatus/util/system/syscall.h"
@@ -34,6 +38,7 @@
 #include "jubatus/core/framework/mixable.hpp"
 #include "jubatus/core/framework/stream_writer.hpp"
 #include "../../common/membership.hpp"
+#include "../../common/mprpc/rpc_connection_pool.hpp"
 #include "../../common/mprpc/rpc_mclient.hpp"
 #include "../../common/unique_lock.hpp"
 #include "../../common/logger/logger.hpp"
@@ -53,6 +58,7 @@ using jubatus::core::framework::packer;
 using jubatus::util::concurrent::scoped_lock;
 using jubatus::util::concurrent::scoped_rlock;
 using jubatus::util::concurrent::scoped_wlock;
+using jubatus::util::lang::shared_ptr;
 using jubatus::util::system::time::clock_time;
 using jubatus::util::system::time::get_clock_time;
 
@@ -62,6 +68,93 @@ namespace framework {
 namespace mixer {
 namespace {
 
+// size of each chunk of chunked get_model
+const size_t MODEL_CHUNK_SIZE = 4 * 1024 * 1024;
+// number of chunk requests in flight
+const size_t MODEL_CHUNK_WINDOW = 4;
+// retries of each chunk before giving up the transfer
+const int MODEL_CHUNK_RETRIES = 3;
+// snapshots not accessed for this period are discarded
+const double MODEL_SNAPSHOT_IDLE_SEC = 60;
+// number of snapshots kept at once
+const size_t MAX_MODEL_SNAPSHOTS = 2;
+
+// id, offset, size and accepted codecs of get_model_chunk
+typedef msgpack::type::tuple<uint64_t, uint64_t, uint64_t, int> chunk_args;
+
+struct chunk_call {
+  msgpack::rpc::session session;
+  msgpack::rpc::future future;
+};
+
+class rpc_model_source : public model_chunk_source {
+ public:
+  rpc_model_source(const string& host, uint16_t port, int timeout_sec)
+      : host_(host),
+        port_(port),
+        timeout_sec_(timeout_sec),
+        pool_(common::mprpc::rpc_connection_pool::shared()),
+        next_ticket_(0) {
+  }
+
+  model_snapshot get_model_begin(int accept) {
+    return pool_.call_apply<model_snapshot>(
+        host_, port_, timeout_sec_, "get_model_begin",
+        msgpack::type::tuple<int>(accept));
+  }
+
+  pair<uint64_t, byte_buffer> get_model(int accept) {
+    return pool_.call_apply<pair<uint64_t, byte_buffer> >(
+        host_, port_, timeout_sec_, "get_model",
+        msgpack::type::tuple<int>(accept));
+  }
+
+  uint64_t request_chunk(
+      const model_snapshot& snapshot,
+      uint64_t offset,
+      uint64_t size,
+      int accept) {
+    chunk_call& c = calls_[next_ticket_];
+    c.session = pool_.get_session(host_, port_);
+    c.future = pool_.call_async(c.session, timeout_sec_, "get_model_chunk",
+        chunk_args(snapshot.id, offset, size, accept));
+    return next_ticket_++;
+  }
+
+  bool wait_chunk(uint64_t ticket, byte_buffer& chunk) {
+    map<uint64_t, chunk_call>::iterator it = calls_.find(ticket);
+    if (it == calls_.end()) {
+      return false;
+    }
+    chunk_call c = it->second;
+    calls_.erase(it);
+
+    c.future.join();
+    pool_.report(host_, port_, c.session, c.future.error());
+    if (!c.future.error().is_nil()) {
+      LOG(WARNING) << "get_model_chunk failed at " << host_ << ":" << port_
+                   << ": " << c.future.error();
+      return false;
+    }
+    chunk = c.future.get<byte_buffer>();
+    return true;
+  }
+
+ private:
+  const string host_;
+  const uint16_t port_;
+  const int timeout_sec_;
+  common::mprpc::rpc_connection_pool& pool_;
+  map<uint64_t, chunk_call> calls_;
+  uint64_t next_ticket_;
+};
+
+struct chunk_request {
+  uint64_t offset;
+  uint64_t size;
+  uint64_t ticket;
+};
+
 class linear_communication_impl : public linear_communication {
  public:
   linear_communication_impl(
@@ -73,11 +166,18 @@ class linear_communication_impl : public linear_communication {
 
   size_t update_members();
   jubatus::util::lang::shared_ptr<common::try_lockable> create_lock();
-  void get_diff(common::mprpc::rpc_result_object& a) const;
+  void get_diff(
+      int accept,
+      const common::mprpc::rpc_mclient::response_handler& handler) const;
   void put_diff(
       const byte_buffer& a,
       common::mprpc::rpc_result_object& result) const;
-  std::pair<uint64_t, byte_buffer> get_model();
+  std::pair<uint64_t, byte_buffer> get_model(int accept);
+  uint64_t get_model_chunked(
+      int accept,
+      size_t chunk_size,
+      size_t window,
+      const chunk_handler& handler);
 
   bool register_active_list() const {
     common::unique_lock lk(m_);
@@ -92,6 +192,8 @@ class linear_communication_impl : public linear_communication {
   }
 
  private:
+  bool choose_model_source(pair<string, int>& server);
+
   jubatus::util::lang::shared_ptr<server::common::lock_service> zk_;
   mutable jubatus::util::concurrent::mutex m_;
   const string type_;
@@ -126,6 +228,9 @@ linear_communication_impl::create_lock() {
 size_t linear_communication_impl::update_members() {
   common::unique_lock lk(m_);
   common::get_all_nodes(*zk_, type_, name_, servers_);
+
+  // drop pooled sessions to the servers which left the cluster
+  common::mprpc::rpc_connection_pool::shared().retain(servers_);
 #ifndef NDEBUG
   string members = "";
   for (size_t i = 0; i < servers_.size(); ++i) {
@@ -136,49 +241,75 @@ size_t linear_communication_impl::update_members() {
   return servers_.size();
 }
 
-std::pair<uint64_t, byte_buffer> linear_communication_impl::get_model() {
+bool linear_communication_impl::choose_model_source(
+    pair<string, int>& server) {
   update_members();
   for (;;) {
     common::unique_lock lk(m_);
 
     // use time as pseudo random number(it should enough)
     if (servers_.empty() || servers_.size() == 1) {
-      return make_pair(0, byte_buffer());
+      return false;
     }
 
     const jubatus::util::system::time::clock_time now(get_clock_time());
     const size_t target = now.usec % servers_.size();
-    const string server_ip = servers_[target].first;
-    const int server_port = servers_[target].second;
-    if (server_ip == my_id_.first && server_port == my_id_.second) {
+    if (servers_[target] == my_id_) {
       // avoid get model from itself
       continue;
     }
+    server = servers_[target];
+    return true;
+  }
+}
 
-    msgpack::rpc::client cli(server_ip, server_port);
-    cli.set_timeout(timeout_sec_);
-    msgpack::rpc::future result(cli.call("get_model", 0));
+std::pair<uint64_t, byte_buffer> linear_communication_impl::get_model(
+    int accept) {
+  pair<string, int> server;
+  if (!choose_model_source(server)) {
+    return make_pair(0, byte_buffer());
+  }
+  const string& server_ip = server.first;
+  const int server_port = server.second;
 
-    try {
-      const std::pair<uint64_t, byte_buffer> got_model_data(
-          result.get<std::pair<uint64_t, byte_buffer> >());
-      LOG(INFO) << "got model(serialized data) "
-                << got_model_data.second.size()
-                << " from server[" << server_ip << ":" << server_port << "] ";
-      return got_model_data;
-    } catch (const std::runtime_error& e) {
-      LOG(WARNING) << "get_model failed (" << e.what() << "): "
-                   << server_ip << ":" << server_port;
-      throw;
-    }
+  try {
+    const std::pair<uint64_t, byte_buffer> got_model_data(
+        common::mprpc::rpc_connection_pool::shared().call_apply<
+            std::pair<uint64_t, byte_buffer> >(
+                server_ip, server_port, timeout_sec_, "get_model",
+                msgpack::type::tuple<int>(accept)));
+    LOG(INFO) << "got model(serialized data) "
+              << got_model_data.second.size()
+              << " from server[" << server_ip << ":" << server_port << "] ";
+    return got_model_data;
+  } catch (const std::runtime_error& e) {
+    LOG(WARNING) << "get_model failed (" << e.what() << "): "
+                 << server_ip << ":" << server_port;
+    throw;
   }
 }
 
+uint64_t linear_communication_impl::get_model_chunked(
+    int accept,
+    size_t chunk_size,
+    size_t window,
+    const chunk_handler& handler) {
+  pair<string, int> server;
+  if (!choose_model_source(server)) {
+    return 0;
+  }
+  LOG(INFO) << "getting model from server[" << server.first << ":"
+            << server.second << "]";
+  rpc_model_source source(server.first, server.second, timeout_sec_);
+  return get_model_in_chunks(source, accept, chunk_size, window, handler);
+}
+
 void linear_communication_impl::get_diff(
-    common::mprpc::rpc_result_object& result) const {
-  // TODO(beam2d): to be replaced to new client with socket connection pooling
+    int accept,
+    const common::mprpc::rpc_mclient::response_handler& handler) const {
   common::unique_lock lk(m_);
-  common::mprpc::rpc_mclient client(servers_, timeout_sec_);
+  common::mprpc::rpc_mclient client(
+      servers_, timeout_sec_, common::mprpc::rpc_connection_pool::shared());
 
 #ifndef NDEBUG
   for (size_t i = 0; i < servers_.size(); i++) {
@@ -186,15 +317,15 @@ void linear_communication_impl::get_diff(
                << servers_[i].second;
   }
 #endif
-  result = client.call("get_diff", 0);
+  client.call_streaming("get_diff", accept, handler);
 }
 
 void linear_communication_impl::put_diff(
     const byte_buffer& mixed,
     common::mprpc::rpc_result_object& result) const {
   common::unique_lock lk(m_);
-  // TODO(beam2d): to be replaced to new client with socket connection pooling
-  server::common::mprpc::rpc_mclient client(servers_, timeout_sec_);
+  server::common::mprpc::rpc_mclient client(
+      servers_, timeout_sec_, common::mprpc::rpc_connection_pool::shared());
 #ifndef NDEBUG
   for (size_t i = 0; i < servers_.size(); i++) {
     DLOG(INFO) << "put diff to " << servers_[i].first << ":"
@@ -216,6 +347,135 @@ string server_list(const vector<pair<string, uint16_t> >& servers) {
   return out.str();
 }
 
+// unpacks payload encoded by mix_codec (and diff_quantizer);
+// holds the buffers which the unpacked object refers to
+class payload_reader {
+ public:
+  payload_reader(const mix_codec& codec, const char* data, size_t size) {
+    const pair<const char*, size_t> body = codec.decode(data, size, buf_);
+    if (mix_codec::flags_of(data, size) & mix_codec::QUANTIZED) {
+      diff_quantizer::dequantize(body.first, body.second, restored_);
+      msgpack::unpack(&msg_, restored_.data(), restored_.size());
+    } else {
+      msgpack::unpack(&msg_, body.first, body.second);
+    }
+  }
+
+  msgpack::object get() const {
+    return msg_.get();
+  }
+
+ private:
+  vector<char> buf_;
+  msgpack::sbuffer restored_;
+  msgpack::unpacked msg_;
+};
+
+// feeds chunks of the model into the unpacker as they arrive, so that the
+// model is parsed while it is transferred and no whole copy is kept aside
+class model_receiver {
+ public:
+  explicit model_receiver(const mix_codec& codec)
+      : codec_(codec),
+        received_(0),
+        done_(false) {
+  }
+
+  void receive(const char* data, size_t size) {
+    vector<char> buf;
+    const pair<const char*, size_t> body = codec_.decode(data, size, buf);
+    unpacker_.reserve_buffer(body.second);
+    memcpy(unpacker_.buffer(), body.first, body.second);
+    unpacker_.buffer_consumed(body.second);
+    received_ += body.second;
+
+    if (done_) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "extra data after the model"));
+    }
+    done_ = unpacker_.next(&model_);
+  }
+
+  uint64_t received() const {
+    return received_;
+  }
+
+  bool done() const {
+    return done_;
+  }
+
+  msgpack::object get() const {
+    return model_.get();
+  }
+
+ private:
+  const mix_codec& codec_;
+  msgpack::unpacker unpacker_;
+  msgpack::unpacked model_;
+  uint64_t received_;
+  bool done_;
+};
+
+// folds each diff into the accumulated one as soon as it arrives
+class diff_reducer {
+ public:
+  diff_reducer(linear_mixable* mixable, const mix_codec& codec)
+      : mixable_(mixable),
+        codec_(codec),
+        accept_(~0) {
+  }
+
+  void reduce(
+      const common::mprpc::rpc_error& from,
+      common::mprpc::rpc_response_t& response) {
+    if (response.has_error()) {
+      const string error_text(
+          common::mprpc::create_error_string(response.error()));
+      LOG(WARNING) << "get_diff failed at "
+                   << from.host() << ":" << from.port()
+                   << " : " << error_text;
+      return;
+    }
+
+    msgpack::object res = response();
+    if (res.type != msgpack::type::RAW) {
+      return;
+    }
+
+    payload_reader reader(codec_, res.via.raw.ptr, res.via.raw.size);
+    msgpack::object o = reader.get();
+
+    if (!diff_) {
+      diff_ = mixable_->convert_diff_object(o);
+    } else {
+      mixable_->mix(o, diff_);
+    }
+
+    successes_.push_back(make_pair(from.host(), from.port()));
+    accept_ &= mix_codec::accept_of(res.via.raw.ptr, res.via.raw.size);
+  }
+
+  diff_object& diff() {
+    return diff_;
+  }
+
+  const vector<pair<string, uint16_t> >& successes() const {
+    return successes_;
+  }
+
+  // codecs accepted by all servers which returned diffs
+  int accept() const {
+    return successes_.empty() ? 0 : accept_;
+  }
+
+ private:
+  linear_mixable* mixable_;
+  const mix_codec& codec_;
+  int accept_;
+  diff_object diff_;
+  vector<pair<string, uint16_t> > successes_;
+};
+
 string version_list(const std::vector<version>& versions)  {
   stringstream ss;
   ss << "[";
@@ -231,6 +491,64 @@ string version_list(const std::vector<version>& versions)  {
 
 }  // namespace
 
+uint64_t get_model_in_chunks(
+    model_chunk_source& source,
+    int accept,
+    size_t chunk_size,
+    size_t window,
+    const linear_communication::chunk_handler& handler) {
+  model_snapshot snapshot;
+  try {
+    snapshot = source.get_model_begin(accept);
+  } catch (const msgpack::rpc::no_method_error&) {
+    // servers of older versions send the model in one piece
+    LOG(INFO) << "chunked get_model is not supported by the server";
+    const pair<uint64_t, byte_buffer> got_model(source.get_model(accept));
+    handler(got_model.second.ptr(), got_model.second.size());
+    return got_model.first;
+  }
+
+  LOG(INFO) << "getting model(serialized data) " << snapshot.size
+            << " bytes in chunks";
+
+  std::deque<chunk_request> in_flight;
+  uint64_t next = 0;
+  int retries = 0;
+  while (next < snapshot.size || !in_flight.empty()) {
+    while (in_flight.size() < window && next < snapshot.size) {
+      chunk_request r;
+      r.offset = next;
+      r.size = std::min<uint64_t>(chunk_size, snapshot.size - next);
+      r.ticket = source.request_chunk(snapshot, r.offset, r.size, accept);
+      in_flight.push_back(r);
+      next += r.size;
+    }
+
+    chunk_request& r = in_flight.front();
+    byte_buffer chunk;
+    if (!source.wait_chunk(r.ticket, chunk)) {
+      if (retries >= MODEL_CHUNK_RETRIES) {
+        throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+            "failed to get model chunk at "
+            + jubatus::util::lang::lexical_cast<string>(r.offset)));
+      }
+      // resume from the cursor; the sender keeps the snapshot for a while
+      ++retries;
+      LOG(WARNING) << "failed to get model chunk at " << r.offset
+                   << ", retrying (" << retries << ")";
+      r.ticket = source.request_chunk(snapshot, r.offset, r.size, accept);
+      continue;
+    }
+
+    handler(chunk.ptr(), chunk.size());
+    in_flight.pop_front();
+    retries = 0;
+  }
+
+  LOG(INFO) << "got model(serialized data) " << snapshot.size << " bytes";
+  return snapshot.protocol_version;
+}
+
 jubatus::util::lang::shared_ptr<linear_communication>
 linear_communication::create(
     const jubatus::util::lang::shared_ptr<server::common::lock_service>& zk,
@@ -247,11 +565,18 @@ linear_mixer::linear_mixer(
     jubatus::util::concurrent::rw_mutex& mutex,
     unsigned int count_threshold,
     unsigned int tick_threshold,
-    uint64_t protocol_version)
+    uint64_t protocol_version,
+    const string& compression,
+    const string& quantization,
+    double sparsify_threshold,
+    size_t sparsify_top_k)
     : communication_(communication),
+      codec_(compression),
       count_threshold_(count_threshold),
       tick_threshold_(tick_threshold),
       protocol_version_(protocol_version),
+      quantizer_(quantization, sparsify_threshold, sparsify_top_k),
+      last_snapshot_id_(0),
       counter_(0),
       ticktime_(get_clock_time()),
       is_running_(false),
@@ -280,6 +605,19 @@ void linear_mixer::register_api(rpc_server_t& server) {
       jubatus::util::lang::bind(&linear_mixer::get_model,
                                 this,
                                 jubatus::util::lang::_1));
+  server.add<model_snapshot(int)>(  // NOLINT
+      "get_model_begin",
+      jubatus::util::lang::bind(&linear_mixer::get_model_begin,
+                                this,
+                                jubatus::util::lang::_1));
+  server.add<byte_buffer(uint64_t, uint64_t, uint64_t, int)>(  // NOLINT
+      "get_model_chunk",
+      jubatus::util::lang::bind(&linear_mixer::get_model_chunk,
+                                this,
+                                jubatus::util::lang::_1,
+                                jubatus::util::lang::_2,
+                                jubatus::util::lang::_3,
+                                jubatus::util::lang::_4));
   server.add<bool(void)>(  // NOLINT
       "do_mix",
       jubatus::util::lang::bind(&linear_mixer::do_mix,
@@ -350,6 +688,12 @@ void linear_mixer::get_status(server_base::status_t& status) const {
   // since last mix
   status["linear_mixer.ticktime"] =
       jubatus::util::lang::lexical_cast<string>(ticktime_.sec);
+  codec_.get_status(status);
+  quantizer_.get_status(status);
+  status["mix_quantization.residual_values"] =
+      jubatus::util::lang::lexical_cast<string>(own_residual_.size());
+  status["mix_quantization.mixed_residual_values"] =
+      jubatus::util::lang::lexical_cast<string>(mixed_residual_.size());
 }
 
 void linear_mixer::stabilizer_loop() {
@@ -436,50 +780,24 @@ void linear_mixer::mix() {
         return;
       }
 
-      common::mprpc::rpc_result_object diff_result;
-      size_t diffs = 0;
-      core::framework::diff_object diff;
+      diff_reducer reducer(mixable, codec_);
       {
-        // get_diff() and mix() each diffs
-        communication_->get_diff(diff_result);
-
-        // convert from rpc_result_object to diff_object
-        typedef pair<string, uint16_t> server;
-        vector<server> successes;
-        for (size_t i = 0; i < diff_result.response.size(); ++i) {
-          if (diff_result.response[i].has_error()) {
-            const string error_text(common::mprpc::create_error_string(
-                diff_result.response[i].error()));
-            LOG(WARNING) << "get_diff failed at "
-                         << diff_result.error[i].host() << ":"
-                         << diff_result.error[i].port()
-                         << " : " << error_text;
-            continue;
-          }
-
-          msgpack::object res = diff_result.response[i]();
-          if (res.type != msgpack::type::RAW) {
-            continue;
-          }
-
-          msgpack::unpacked msg;
-          msgpack::unpack(&msg, res.via.raw.ptr, res.via.raw.size);
-          msgpack::object o = msg.get();
-
-          diffs++;
-          if (!diff) {
-            diff = mixable->convert_diff_object(o);
-          } else {
-            mixable->mix(o, diff);
-          }
-
-          successes.push_back(make_pair(
-                diff_result.error[i].host(), diff_result.error[i].port()));
-        }
+        // get_diff() and mix() each diffs as they arrive
+        communication_->get_diff(
+            mix_codec::supported(),
+            jubatus::util::lang::bind(
+                &diff_reducer::reduce, &reducer,
+                jubatus::util::lang::_1, jubatus::util::lang::_2));
 
         // success info message
         LOG(INFO) << "success to get_diff from ["
-                  << server_list(successes) << "]";
+                  << server_list(reducer.successes()) << "]";
+      }
+
+      core::framework::diff_object& diff = reducer.diff();
+      if (!diff) {
+        LOG(WARNING) << "no diff to mix";
+        return;
       }
 
       { // put mixed data
@@ -490,11 +808,15 @@ void linear_mixer::mix() {
         packer pk(jp);
         diff->convert_binary(pk);
 
-        byte_buffer mixed(sbuf.data(), sbuf.size());
+        // compress only when every server told us that it can decode
+        const int accept =
+            reducer.successes().size() == servers_size ? reducer.accept() : 0;
+        byte_buffer mixed(encode_diff(sbuf, accept, mixed_residual_));
 
         // do put_diff
         common::mprpc::rpc_result_object result;
         communication_->put_diff(mixed, result);
+        mixed_residual_.commit();
 
         {  // log output
           s += sbuf.size();
@@ -533,7 +855,7 @@ void linear_mixer::mix() {
 }
 
 
-byte_buffer linear_mixer::get_diff(int a) {
+byte_buffer linear_mixer::get_diff(int accept) {
   scoped_rlock lk_read(model_mutex_);
   scoped_lock lk(m_);
 
@@ -548,11 +870,23 @@ byte_buffer linear_mixer::get_diff(int a) {
   core::framework::jubatus_packer jp(st);
   packer pk(jp);
   mixable->get_diff(pk);
-  byte_buffer bytes(sbuf.data(), sbuf.size());
-  return bytes;
+  return encode_diff(sbuf, accept, own_residual_);
 }
 
-std::pair<uint64_t, byte_buffer> linear_mixer::get_model(int a) const {
+byte_buffer linear_mixer::encode_diff(
+    const msgpack::sbuffer& packed,
+    int accept,
+    quantization_residual& residual) const {
+  if (accept == 0 || !quantizer_.enabled()) {
+    return codec_.encode(packed.data(), packed.size(), accept);
+  }
+  msgpack::sbuffer quantized;
+  quantizer_.quantize(packed.data(), packed.size(), quantized, &residual);
+  return codec_.encode(
+      quantized.data(), quantized.size(), accept, mix_codec::QUANTIZED);
+}
+
+std::pair<uint64_t, byte_buffer> linear_mixer::get_model(int accept) const {
   scoped_rlock lk_read(model_mutex_);
 
   msgpack::sbuffer packed;
@@ -565,17 +899,87 @@ std::pair<uint64_t, byte_buffer> linear_mixer::get_model(int a) const {
             << jubatus::util::lang::lexical_cast<string>(packed.size());
 
   return std::make_pair(
-      protocol_version_, byte_buffer(packed.data(), packed.size()));
+      protocol_version_, codec_.encode(packed.data(), packed.size(), accept));
 }
 
-void linear_mixer::update_model() {
-  std::pair<uint64_t, byte_buffer> got_model =
-      communication_->get_model();
+model_snapshot linear_mixer::get_model_begin(int accept) {
+  shared_ptr<msgpack::sbuffer> packed(new msgpack::sbuffer);
+  {
+    scoped_rlock lk_read(model_mutex_);
+    stream_writer<msgpack::sbuffer> st(*packed);
+    core::framework::jubatus_packer jp(st);
+    packer pk(jp);
+    driver_->pack(pk);
+  }
+
+  const clock_time now = get_clock_time();
+  scoped_lock lk(snapshots_m_);
+  for (std::map<uint64_t, snapshot_entry>::iterator it = snapshots_.begin();
+       it != snapshots_.end(); ) {
+    if (now - it->second.last_access > MODEL_SNAPSHOT_IDLE_SEC) {
+      snapshots_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  while (snapshots_.size() >= MAX_MODEL_SNAPSHOTS) {
+    // ids increase, so the first one is the oldest
+    snapshots_.erase(snapshots_.begin());
+  }
+
+  // ids are based on time so that they are not reused after restart
+  model_snapshot snapshot;
+  snapshot.id = std::max(last_snapshot_id_ + 1,
+                         static_cast<uint64_t>(now.sec) * 1000000 + now.usec);
+  snapshot.protocol_version = protocol_version_;
+  snapshot.size = packed->size();
+  last_snapshot_id_ = snapshot.id;
+
+  snapshot_entry& entry = snapshots_[snapshot.id];
+  entry.packed = packed;
+  entry.last_access = now;
+
+  LOG(INFO) << "sending learning-model in chunks. size = " << snapshot.size;
+  return snapshot;
+}
 
-  uint64_t got_protocol_version = got_model.first;
-  byte_buffer model_serialized = got_model.second;
+byte_buffer linear_mixer::get_model_chunk(
+    uint64_t id,
+    uint64_t offset,
+    uint64_t size,
+    int accept) {
+  shared_ptr<msgpack::sbuffer> packed;
+  {
+    scoped_lock lk(snapshots_m_);
+    std::map<uint64_t, snapshot_entry>::iterator it = snapshots_.find(id);
+    if (it == snapshots_.end()) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "model snapshot expired: "
+          + jubatus::util::lang::lexical_cast<string>(id)));
+    }
+    it->second.last_access = get_clock_time();
+    packed = it->second.packed;
+  }
 
-  if (model_serialized.size() == 0) {
+  if (offset > packed->size() || size > packed->size() - offset) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "model chunk out of range"));
+  }
+  return codec_.encode(packed->data() + offset, size, accept);
+}
+
+void linear_mixer::update_model() {
+  // the model is parsed as chunks arrive
+  model_receiver receiver(codec_);
+  const uint64_t got_protocol_version = communication_->get_model_chunked(
+      mix_codec::supported(),
+      MODEL_CHUNK_SIZE,
+      MODEL_CHUNK_WINDOW,
+      jubatus::util::lang::bind(&model_receiver::receive, &receiver,
+                                jubatus::util::lang::_1,
+                                jubatus::util::lang::_2));
+
+  if (receiver.received() == 0) {
     // it means "no other server"
     LOG(INFO) << "no other server available, I become active";
     is_obsolete_ = false;
@@ -590,20 +994,20 @@ void linear_mixer::update_model() {
     jubatus::server::common::shutdown_server();
   }
 
-  msgpack::unpacked unpacked;
-  msgpack::unpack(&unpacked, model_serialized.ptr(), model_serialized.size());
+  if (!receiver.done()) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "model transfer ended before the whole model arrived"));
+  }
   {
     scoped_wlock lk_write(model_mutex_);
-    driver_->unpack(unpacked.get());
+    driver_->unpack(receiver.get());
   }
 }
 
 int linear_mixer::put_diff(const byte_buffer& diff) {
-  scoped_wlock lk_write(model_mutex_);
-  scoped_lock lk(m_);
-
-  msgpack::unpacked msg;
-  msgpack::unpack(&msg, diff.ptr(), diff.size());
+  // decode and convert the diff before taking the write lock, so that
+  // analysis RPCs wait only while the diff is applied
+  payload_reader msg(codec_, diff.ptr(), diff.size());
 
   core::framework::linear_mixable* mixable =
     dynamic_cast<core::framework::linear_mixable*>(driver_->get_mixable());
@@ -611,12 +1015,27 @@ int linear_mixer::put_diff(const byte_buffer& diff) {
     throw JUBATUS_EXCEPTION(core::common::config_not_set());  // nothing to mix
   }
 
+  diff_object converted;
+  {
+    scoped_rlock lk_read(model_mutex_);
+    converted = mixable->convert_diff_object(msg.get());
+  }
+
   const size_t total_size = diff.size();
-  const bool not_obsolete =
-      mixable->put_diff(mixable->convert_diff_object(msg.get()));
+  bool not_obsolete;
+  string versions;
+  {
+    scoped_wlock lk_write(model_mutex_);
+    not_obsolete = mixable->put_diff(converted);
+
+    // print versions of mixables
+    versions = version_list(driver_->get_versions());
+  }
+  // the diff sent in this round has been applied
+  own_residual_.commit();
 
-  // print versions of mixables
-  const string versions = version_list(driver_->get_versions());
+  // ZooKeeper is updated without blocking RPCs
+  scoped_lock lk(m_);
 
   // if all put_diff returns true, this model is not obsolete
   if (not_obsolete) {
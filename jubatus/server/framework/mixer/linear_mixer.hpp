@@ -17,17 +17,22 @@
 #ifndef JUBATUS_SERVER_FRAMEWORK_MIXER_LINEAR_MIXER_HPP_
 #define JUBATUS_SERVER_FRAMEWORK_MIXER_LINEAR_MIXER_HPP_
 
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
+#include <msgpack.hpp>
 #include "jubatus/util/concurrent/condition.h"
 #include "jubatus/util/concurrent/mutex.h"
 #include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/function.h"
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/util/system/time_util.h"
 #include "jubatus/core/common/byte_buffer.hpp"
 #include "../../common/lock_service.hpp"
 #include "../../common/mprpc/rpc_mclient.hpp"
+#include "diff_quantizer.hpp"
+#include "mix_codec.hpp"
 #include "mixer.hpp"
 
 namespace jubatus {
@@ -35,8 +40,20 @@ namespace server {
 namespace framework {
 namespace mixer {
 
+// serialized model kept by the sender during a chunked transfer
+struct model_snapshot {
+  uint64_t id;
+  uint64_t protocol_version;
+  uint64_t size;
+
+  MSGPACK_DEFINE(id, protocol_version, size);
+};
+
 class linear_communication {
  public:
+  typedef jubatus::util::lang::function<void(const char*, size_t)>
+      chunk_handler;
+
   virtual ~linear_communication() {
   }
 
@@ -51,15 +68,31 @@ class linear_communication {
   virtual size_t update_members() = 0;
 
   // Get random one model from another server
-  virtual std::pair<uint64_t, core::common::byte_buffer> get_model() = 0;
+  // accept is the set of codecs we can decode (see mix_codec)
+  virtual std::pair<uint64_t, core::common::byte_buffer> get_model(
+      int accept) = 0;
+
+  // Get random one model from another server in chunks of chunk_size
+  // bytes, keeping up to window requests in flight.  Each chunk is passed
+  // to handler in order of offset.  Returns the protocol version of the
+  // server, or 0 (and handler is never called) if there is no other server.
+  // it can throw common::mprpc exception
+  virtual uint64_t get_model_chunked(
+      int accept,
+      size_t chunk_size,
+      size_t window,
+      const chunk_handler& handler) = 0;
 
   // We use shared_ptr instead of auto_ptr/unique_ptr
   // because in C++03 specification limits.
   virtual jubatus::util::lang::shared_ptr<common::try_lockable> create_lock()
       = 0;
 
+  // handler is called for each response in order of arrival
   // it can throw common::mprpc exception
-  virtual void get_diff(common::mprpc::rpc_result_object& result) const = 0;
+  virtual void get_diff(
+      int accept,
+      const common::mprpc::rpc_mclient::response_handler& handler) const = 0;
   // it can throw common::mprpc exception
   virtual void put_diff(
       const core::common::byte_buffer& mixed,
@@ -69,6 +102,39 @@ class linear_communication {
   virtual bool unregister_active_list() const = 0;
 };
 
+// another server from which the model is got in chunks
+class model_chunk_source {
+ public:
+  virtual ~model_chunk_source() {
+  }
+
+  // it can throw msgpack::rpc::no_method_error for servers of older
+  // versions, which support get_model only
+  virtual model_snapshot get_model_begin(int accept) = 0;
+  virtual std::pair<uint64_t, core::common::byte_buffer> get_model(
+      int accept) = 0;
+
+  // starts getting the chunk; returns the ticket to wait for it
+  virtual uint64_t request_chunk(
+      const model_snapshot& snapshot,
+      uint64_t offset,
+      uint64_t size,
+      int accept) = 0;
+  // returns false if the chunk failed
+  virtual bool wait_chunk(
+      uint64_t ticket,
+      core::common::byte_buffer& chunk) = 0;
+};
+
+// gets the model as linear_communication::get_model_chunked does; failed
+// chunks are requested again from their offsets
+uint64_t get_model_in_chunks(
+    model_chunk_source& source,
+    int accept,
+    size_t chunk_size,
+    size_t window,
+    const linear_communication::chunk_handler& handler);
+
 class linear_mixer : public mixer {
  public:
   linear_mixer(
@@ -76,7 +142,11 @@ class linear_mixer : public mixer {
       jubatus::util::concurrent::rw_mutex& mutex,
       unsigned int count_threshold,
       unsigned int tick_threshold,
-      uint64_t protocol_version);
+      uint64_t protocol_version,
+      const std::string& compression = "none",
+      const std::string& quantization = "none",
+      double sparsify_threshold = 0,
+      size_t sparsify_top_k = 0);
   ~linear_mixer();
 
   void register_api(rpc_server_t& server);
@@ -90,26 +160,48 @@ class linear_mixer : public mixer {
 
   void get_status(server_base::status_t& status) const;
 
-  void mix();
+  virtual void mix();
   void update_model();
 
   std::string type() const {
     return "linear_mixer";
   }
 
+ protected:
+  core::common::byte_buffer get_diff(int accept);
+  int put_diff(const core::common::byte_buffer&);
+
+  jubatus::util::lang::shared_ptr<linear_communication> communication_;
+  mix_codec codec_;
+
  private:
   void stabilizer_loop();
 
+  // diffs are quantized only for peers which know the header; errors of
+  // quantization are kept in the residual for the next round
+  core::common::byte_buffer encode_diff(
+      const msgpack::sbuffer& packed,
+      int accept,
+      quantization_residual& residual) const;
+
   void clear();
 
-  core::common::byte_buffer get_diff(int a);
-  int put_diff(const core::common::byte_buffer&);
-  std::pair<uint64_t, core::common::byte_buffer> get_model(int d) const;
+  std::pair<uint64_t, core::common::byte_buffer> get_model(int accept) const;
+  model_snapshot get_model_begin(int accept);
+  core::common::byte_buffer get_model_chunk(
+      uint64_t id,
+      uint64_t offset,
+      uint64_t size,
+      int accept);
 
-  jubatus::util::lang::shared_ptr<linear_communication> communication_;
   unsigned int count_threshold_;
   unsigned int tick_threshold_;
   uint64_t protocol_version_;
+  diff_quantizer quantizer_;
+  // errors of quantizing the diff of this server, and of the mixed diff
+  // when this server is the master
+  quantization_residual own_residual_;
+  quantization_residual mixed_residual_;
 
   unsigned int counter_;
   jubatus::util::system::time::clock_time ticktime_;
@@ -124,6 +216,16 @@ class linear_mixer : public mixer {
   jubatus::util::concurrent::rw_mutex& model_mutex_;
   jubatus::util::concurrent::condition c_;
 
+  // models being sent to joining servers, by snapshot id
+  struct snapshot_entry {
+    jubatus::util::lang::shared_ptr<msgpack::sbuffer> packed;
+    jubatus::util::system::time::clock_time last_access;
+  };
+  jubatus::util::concurrent::mutex snapshots_m_;
+  std::map<uint64_t, snapshot_entry> snapshots_;
+  uint64_t last_snapshot_id_;
+
+ protected:
   core::driver::driver_base* driver_;
 };
 
@@ -14,12 +14,16 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 #include <gtest/gtest.h>
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/core/common/exception.hpp"
 #include "jubatus/core/common/version.hpp"
 #include "jubatus/core/common/byte_buffer.hpp"
 #include "jubatus/core/framework/mixable.hpp"
@@ -62,24 +66,114 @@ common::mprpc::rpc_response_t make_response(const string& s) {
 
 }  // namespace
 
+// serves the model as another server does for get_model_in_chunks
+class model_source_stub : public model_chunk_source {
+ public:
+  explicit model_source_stub(const string& model)
+      : model_(model),
+        chunked_(true),
+        whole_requests_(0),
+        next_ticket_(0),
+        max_in_flight_(0) {
+  }
+
+  // the server does not have get_model_begin
+  void set_old_version() {
+    chunked_ = false;
+  }
+
+  // the chunk at the offset fails this number of times
+  void fail(uint64_t offset, int times) {
+    failures_[offset] = times;
+  }
+
+  model_snapshot get_model_begin(int accept) {
+    if (!chunked_) {
+      throw msgpack::rpc::no_method_error();
+    }
+    model_snapshot snapshot;
+    snapshot.id = 1;
+    snapshot.protocol_version = 1;
+    snapshot.size = model_.size();
+    return snapshot;
+  }
+
+  pair<uint64_t, byte_buffer> get_model(int accept) {
+    ++whole_requests_;
+    return make_pair(1, byte_buffer(model_.data(), model_.size()));
+  }
+
+  uint64_t request_chunk(
+      const model_snapshot& snapshot,
+      uint64_t offset,
+      uint64_t size,
+      int accept) {
+    requested_offsets_.push_back(offset);
+    in_flight_[next_ticket_] = make_pair(offset, size);
+    max_in_flight_ = std::max(max_in_flight_, in_flight_.size());
+    return next_ticket_++;
+  }
+
+  bool wait_chunk(uint64_t ticket, byte_buffer& chunk) {
+    const pair<uint64_t, uint64_t> range = in_flight_[ticket];
+    in_flight_.erase(ticket);
+    if (0 < failures_[range.first]) {
+      --failures_[range.first];
+      return false;
+    }
+    chunk = byte_buffer(model_.data() + range.first, range.second);
+    return true;
+  }
+
+  const vector<uint64_t>& requested_offsets() const {
+    return requested_offsets_;
+  }
+  int whole_requests() const {
+    return whole_requests_;
+  }
+  size_t max_in_flight() const {
+    return max_in_flight_;
+  }
+
+ private:
+  const string model_;
+  bool chunked_;
+  int whole_requests_;
+  std::map<uint64_t, int> failures_;
+  std::map<uint64_t, pair<uint64_t, uint64_t> > in_flight_;
+  uint64_t next_ticket_;
+  size_t max_in_flight_;
+  vector<uint64_t> requested_offsets_;
+};
+
 class linear_communication_stub : public linear_communication {
  public:
+  linear_communication_stub() {
+    arrival_.push_back("1");
+    arrival_.push_back("2");
+    arrival_.push_back("3");
+    arrival_.push_back("4");
+  }
+
+  // diffs are passed to the handler in this order
+  explicit linear_communication_stub(const vector<string>& arrival)
+      : arrival_(arrival) {
+  }
+
   size_t update_members() { return 4; }
 
   jubatus::util::lang::shared_ptr<common::try_lockable> create_lock() {
     return jubatus::util::lang::shared_ptr<common::try_lockable>();
   }
 
-  void get_diff(common::mprpc::rpc_result_object& result) const {
+  void get_diff(
+      int accept,
+      const common::mprpc::rpc_mclient::response_handler& handler) const {
     cout << "get_diff called" << endl;
-    result.response.push_back(make_response("1"));
-    result.response.push_back(make_response("2"));
-    result.response.push_back(make_response("3"));
-    result.response.push_back(make_response("4"));
-    result.error.push_back(common::mprpc::rpc_error("1", 1));
-    result.error.push_back(common::mprpc::rpc_error("2", 2));
-    result.error.push_back(common::mprpc::rpc_error("3", 3));
-    result.error.push_back(common::mprpc::rpc_error("4", 4));
+    for (size_t i = 0; i < arrival_.size(); ++i) {
+      common::mprpc::rpc_response_t res = make_response(arrival_[i]);
+      handler(common::mprpc::rpc_error(arrival_[i], i + 1), res);
+    }
   }
 
   void put_diff(const byte_buffer& mixed,
@@ -96,10 +190,27 @@ class linear_communication_stub : public linear_communication {
     return mixed_;
   }
 
-  pair<uint64_t, byte_buffer> get_model() {
+  // serialized model sent to get_model_chunked
+  void set_model(const string& model) {
+    model_ = model;
+  }
+
+  pair<uint64_t, byte_buffer> get_model(int accept) {
     return make_pair(1, byte_buffer());
   }
 
+  uint64_t get_model_chunked(
+      int accept,
+      size_t chunk_size,
+      size_t window,
+      const chunk_handler& handler) {
+    if (model_.empty()) {
+      return 0;
+    }
+    model_source_stub source(model_);
+    return get_model_in_chunks(source, accept, 3, 2, handler);
+  }
+
   bool register_active_list() const {
     return true;
   }
@@ -108,7 +219,9 @@ class linear_communication_stub : public linear_communication {
   }
 
  private:
+  vector<string> arrival_;
   mutable vector<string> mixed_;
+  string model_;
 };
 
 struct my_string {
@@ -153,6 +266,38 @@ class my_string_driver : public core::driver::driver_base {
   mixable_string string_;
 };
 
+// keeps the model got by update_model
+class model_driver : public my_string_driver {
+ public:
+  void unpack(msgpack::object o) {
+    o.convert(&model);
+  }
+
+  vector<string> model;
+};
+
+struct chunk_collector {
+  chunk_collector()
+      : chunks(0) {
+  }
+
+  void receive(const char* data, size_t size) {
+    received.append(data, size);
+    ++chunks;
+  }
+
+  string received;
+  size_t chunks;
+};
+
+uint64_t get_model_from(model_source_stub& source, chunk_collector& out) {
+  return get_model_in_chunks(
+      source, 0, 4, 3,
+      jubatus::util::lang::bind(
+          &chunk_collector::receive, &out,
+          jubatus::util::lang::_1, jubatus::util::lang::_2));
+}
+
 TEST(linear_mixer, mix_order) {
   shared_ptr<linear_communication_stub> com(new linear_communication_stub);
   jubatus::util::concurrent::rw_mutex mutex;
@@ -168,6 +313,27 @@ TEST(linear_mixer, mix_order) {
   EXPECT_EQ("(4+(3+(2+1)))", mixed[0]);
 }
 
+TEST(linear_mixer, mix_in_order_of_arrival) {
+  vector<string> arrival;
+  arrival.push_back("3");
+  arrival.push_back("1");
+  arrival.push_back("4");
+  arrival.push_back("2");
+  shared_ptr<linear_communication_stub> com(
+      new linear_communication_stub(arrival));
+  jubatus::util::concurrent::rw_mutex mutex;
+  linear_mixer m(com, mutex, 1, 1, 1);
+
+  my_string_driver s;
+  m.set_driver(&s);
+
+  m.mix();
+
+  vector<string> mixed = com->get_mixed();
+  ASSERT_EQ(1u, mixed.size());
+  EXPECT_EQ("(2+(4+(1+3)))", mixed[0]);
+}
+
 TEST(linear_mixer, destruct_running_mixer) {
   shared_ptr<linear_communication_stub> com(new linear_communication_stub);
   jubatus::util::concurrent::rw_mutex mutex;
@@ -181,6 +347,80 @@ TEST(linear_mixer, destruct_running_mixer) {
   // destruct without calling m.stop()
 }
 
+TEST(linear_mixer, update_model_in_chunks) {
+  vector<string> model;
+  for (int i = 0; i < 20; ++i) {
+    model.push_back(string(i, 'x'));
+  }
+  msgpack::sbuffer packed;
+  msgpack::pack(packed, model);
+
+  shared_ptr<linear_communication_stub> com(new linear_communication_stub);
+  com->set_model(string(packed.data(), packed.size()));
+  jubatus::util::concurrent::rw_mutex mutex;
+  linear_mixer m(com, mutex, 1, 1, 1);
+
+  model_driver d;
+  m.set_driver(&d);
+
+  // the model is parsed from chunks of 3 bytes
+  m.update_model();
+  EXPECT_EQ(model, d.model);
+}
+
+TEST(get_model_in_chunks, reassemble) {
+  const string model = "abcdefghijklmnopqrstuvwxyz";
+  model_source_stub source(model);
+  chunk_collector out;
+
+  EXPECT_EQ(1u, get_model_from(source, out));
+  EXPECT_EQ(model, out.received);
+  EXPECT_EQ(7u, out.chunks);
+  EXPECT_EQ(3u, source.max_in_flight());
+  EXPECT_EQ(0, source.whole_requests());
+}
+
+TEST(get_model_in_chunks, resume_after_failed_chunk) {
+  const string model = "abcdefghijklmnopqrstuvwxyz";
+  model_source_stub source(model);
+  source.fail(8, 2);
+  chunk_collector out;
+
+  EXPECT_EQ(1u, get_model_from(source, out));
+  EXPECT_EQ(model, out.received);
+
+  // only the failed chunk is requested again
+  const vector<uint64_t>& offsets = source.requested_offsets();
+  EXPECT_EQ(9u, offsets.size());
+  EXPECT_EQ(3, std::count(offsets.begin(), offsets.end(), 8u));
+  EXPECT_EQ(1, std::count(offsets.begin(), offsets.end(), 0u));
+  EXPECT_EQ(1, std::count(offsets.begin(), offsets.end(), 24u));
+}
+
+TEST(get_model_in_chunks, give_up_after_retries) {
+  model_source_stub source("abcdefghijklmnopqrstuvwxyz");
+  source.fail(8, 100);
+  chunk_collector out;
+
+  EXPECT_THROW(get_model_from(source, out),
+               core::common::exception::jubatus_exception);
+  // chunks before the failed one have been passed
+  EXPECT_EQ("abcdefgh", out.received);
+}
+
+TEST(get_model_in_chunks, fallback_to_get_model) {
+  const string model = "abcdefghijklmnopqrstuvwxyz";
+  model_source_stub source(model);
+  source.set_old_version();
+  chunk_collector out;
+
+  EXPECT_EQ(1u, get_model_from(source, out));
+  EXPECT_EQ(model, out.received);
+  EXPECT_EQ(1u, out.chunks);
+  EXPECT_EQ(1, source.whole_requests());
+  EXPECT_TRUE(source.requested_offsets().empty());
+}
+
 }  // namespace mixer
 }  // namespace framework
 }  // namespace server
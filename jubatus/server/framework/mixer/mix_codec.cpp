@@ -0,0 +1,331 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "mix_codec.hpp"
+
+#include <string.h>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#ifdef HAVE_LZ4_H
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/util/system/time_util.h"
+#include "jubatus/core/common/exception.hpp"
+
+using std::string;
+using std::vector;
+using jubatus::core::common::byte_buffer;
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::system::time::clock_time;
+using jubatus::util::system::time::get_clock_time;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+namespace {
+
+// never used as the first byte of msgpack
+const unsigned char MAGIC = 0xc1;
+
+const int DEFAULT_ZSTD_LEVEL = 3;
+
+void write_header(
+    char* p,
+    mix_codec::codec_type codec,
+    int accept,
+    int flags,
+    uint64_t raw_size) {
+  p[0] = static_cast<char>(MAGIC);
+  p[1] = static_cast<char>(codec);
+  p[2] = static_cast<char>(accept);
+  p[3] = static_cast<char>(flags);
+  for (int i = 0; i < 8; ++i) {
+    p[4 + i] = static_cast<char>((raw_size >> (8 * (7 - i))) & 0xff);
+  }
+}
+
+bool has_header(const char* data, size_t size) {
+  return size >= mix_codec::HEADER_SIZE
+      && static_cast<unsigned char>(data[0]) == MAGIC;
+}
+
+uint64_t read_raw_size(const char* p) {
+  uint64_t size = 0;
+  for (int i = 0; i < 8; ++i) {
+    size = (size << 8) | static_cast<unsigned char>(p[4 + i]);
+  }
+  return size;
+}
+
+const char* codec_name(mix_codec::codec_type codec) {
+  switch (codec) {
+    case mix_codec::LZ4:
+      return "lz4";
+    case mix_codec::ZSTD:
+      return "zstd";
+    default:
+      return "none";
+  }
+}
+
+}  // namespace
+
+mix_codec::mix_codec(const string& spec)
+    : codec_(NONE),
+      level_(0),
+      raw_bytes_(0),
+      compressed_bytes_(0),
+      compress_sec_(0),
+      decompress_sec_(0) {
+  const string::size_type colon = spec.find(':');
+  const string name = spec.substr(0, colon);
+
+  if (name == "none" || name.empty()) {
+    codec_ = NONE;
+  } else if (name == "lz4") {
+    codec_ = LZ4;
+  } else if (name == "zstd") {
+    codec_ = ZSTD;
+    level_ = DEFAULT_ZSTD_LEVEL;
+  } else {
+    throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+        "unknown MIX compression: " + spec));
+  }
+
+  if (colon != string::npos) {
+    if (codec_ != ZSTD) {
+      throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+          "compression level is not supported: " + spec));
+    }
+    try {
+      level_ = lexical_cast<int>(spec.substr(colon + 1));
+    } catch (const std::bad_cast&) {
+      throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+          "invalid compression level: " + spec));
+    }
+  }
+
+  if (!(supported() & (1 << codec_))) {
+    throw JUBATUS_EXCEPTION(core::common::invalid_parameter(
+        string("MIX compression is not available in this build: ")
+        + codec_name(codec_)));
+  }
+}
+
+int mix_codec::supported() {
+  int accept = 1 << NONE;
+#ifdef HAVE_LZ4_H
+  accept |= 1 << LZ4;
+#endif
+#ifdef HAVE_ZSTD_H
+  accept |= 1 << ZSTD;
+#endif
+  return accept;
+}
+
+int mix_codec::accept_of(const char* data, size_t size) {
+  if (!has_header(data, size)) {
+    return 0;
+  }
+  return static_cast<unsigned char>(data[2]);
+}
+
+int mix_codec::flags_of(const char* data, size_t size) {
+  if (!has_header(data, size)) {
+    return 0;
+  }
+  return static_cast<unsigned char>(data[3]);
+}
+
+string mix_codec::spec() const {
+  if (codec_ == ZSTD) {
+    return string(codec_name(codec_)) + ":" + lexical_cast<string>(level_);
+  }
+  return codec_name(codec_);
+}
+
+byte_buffer mix_codec::encode(
+    const char* data,
+    size_t size,
+    int peer_accept,
+    int flags) const {
+  if (peer_accept == 0) {
+    // the peer does not understand the header
+    if (flags != 0) {
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "cannot send flagged MIX payload to servers of older versions"));
+    }
+    return byte_buffer(data, size);
+  }
+
+  if (codec_ != NONE && (peer_accept & (1 << codec_))) {
+    vector<char> out;
+    const clock_time start = get_clock_time();
+    if (compress(data, size, flags, out)) {
+      const double elapsed = get_clock_time() - start;
+      scoped_lock lk(m_);
+      raw_bytes_ += size;
+      compressed_bytes_ += out.size() - HEADER_SIZE;
+      compress_sec_ += elapsed;
+      return byte_buffer(&out[0], out.size());
+    }
+  }
+
+  // send as is, but with the header to tell which codecs we accept
+  vector<char> out(HEADER_SIZE + size);
+  write_header(&out[0], NONE, supported(), flags, size);
+  if (size > 0) {
+    memcpy(&out[HEADER_SIZE], data, size);
+  }
+  return byte_buffer(&out[0], out.size());
+}
+
+bool mix_codec::compress(
+    const char* data,
+    size_t size,
+    int flags,
+    vector<char>& out) const {
+  switch (codec_) {
+#ifdef HAVE_LZ4_H
+    case LZ4: {
+      if (size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        return false;
+      }
+      const int bound = LZ4_compressBound(static_cast<int>(size));
+      out.resize(HEADER_SIZE + bound);
+      const int n = LZ4_compress_default(
+          data, &out[HEADER_SIZE], static_cast<int>(size), bound);
+      if (n <= 0) {
+        return false;
+      }
+      out.resize(HEADER_SIZE + n);
+      break;
+    }
+#endif
+#ifdef HAVE_ZSTD_H
+    case ZSTD: {
+      const size_t bound = ZSTD_compressBound(size);
+      out.resize(HEADER_SIZE + bound);
+      const size_t n = ZSTD_compress(
+          &out[HEADER_SIZE], bound, data, size, level_);
+      if (ZSTD_isError(n)) {
+        return false;
+      }
+      out.resize(HEADER_SIZE + n);
+      break;
+    }
+#endif
+    default:
+      return false;
+  }
+
+  if (out.size() >= HEADER_SIZE + size) {
+    // incompressible; not worth the cost of decompression
+    return false;
+  }
+  write_header(&out[0], codec_, supported(), flags, size);
+  return true;
+}
+
+std::pair<const char*, size_t> mix_codec::decode(
+    const char* data,
+    size_t size,
+    vector<char>& buf) const {
+  if (!has_header(data, size)) {
+    // plain msgpack from servers of older versions
+    return std::make_pair(data, size);
+  }
+
+  const codec_type codec = static_cast<codec_type>(
+      static_cast<unsigned char>(data[1]));
+  const uint64_t raw_size = read_raw_size(data);
+  const char* body = data + HEADER_SIZE;
+  const size_t body_size = size - HEADER_SIZE;
+
+  if (codec == NONE) {
+    return std::make_pair(body, body_size);
+  }
+
+  const clock_time start = get_clock_time();
+  buf.resize(raw_size);
+  bool ok = false;
+  switch (codec) {
+#ifdef HAVE_LZ4_H
+    case LZ4:
+      ok = raw_size <= static_cast<uint64_t>(LZ4_MAX_INPUT_SIZE)
+          && LZ4_decompress_safe(
+              body, buf.empty() ? NULL : &buf[0],
+              static_cast<int>(body_size),
+              static_cast<int>(raw_size)) == static_cast<int>(raw_size);
+      break;
+#endif
+#ifdef HAVE_ZSTD_H
+    case ZSTD: {
+      const size_t n = ZSTD_decompress(
+          buf.empty() ? NULL : &buf[0], raw_size, body, body_size);
+      ok = !ZSTD_isError(n) && n == raw_size;
+      break;
+    }
+#endif
+    default:
+      throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+          "MIX payload compressed with unsupported codec: "
+          + lexical_cast<string>(static_cast<int>(codec))));
+  }
+  if (!ok) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        string("failed to decompress MIX payload (")
+        + codec_name(codec) + ")"));
+  }
+
+  const double elapsed = get_clock_time() - start;
+  {
+    scoped_lock lk(m_);
+    decompress_sec_ += elapsed;
+  }
+  return std::make_pair(buf.empty() ? body : &buf[0], buf.size());
+}
+
+void mix_codec::get_status(server_base::status_t& status) const {
+  scoped_lock lk(m_);
+  status["mix_compression"] = spec();
+  status["mix_compression.raw_bytes"] = lexical_cast<string>(raw_bytes_);
+  status["mix_compression.compressed_bytes"] =
+      lexical_cast<string>(compressed_bytes_);
+  status["mix_compression.ratio"] = lexical_cast<string>(
+      raw_bytes_ == 0 ? 1.0 :
+      static_cast<double>(compressed_bytes_) / raw_bytes_);
+  status["mix_compression.compress_time"] =
+      lexical_cast<string>(compress_sec_);
+  status["mix_compression.decompress_time"] =
+      lexical_cast<string>(decompress_sec_);
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,123 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_MIXER_MIX_CODEC_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_MIXER_MIX_CODEC_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/core/common/byte_buffer.hpp"
+#include "../server_base.hpp"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+/**
+ * Compression of MIX payloads (get_diff, put_diff, get_model, pull and push).
+ *
+ * An encoded payload starts with a header of HEADER_SIZE bytes:
+ *
+ *   [0xc1][codec][accept][flags][size of the body before compression (8 bytes)]
+ *
+ * 0xc1 never appears in msgpack, so payloads without the header, which are
+ * sent by servers of older versions, are read as plain msgpack.  `accept` is
+ * the set of codecs the sender can decode; the receiver may use one of them
+ * for payloads sent back to the sender.  QUANTIZED in flags means that the
+ * body is a diff encoded by diff_quantizer.
+ *
+ * Requesters advertise their accept set in the int argument of get_diff,
+ * get_model and get_pull_argument, which older versions always send as 0.
+ * Accept set 0 means that the peer does not know the header at all, so the
+ * payload is sent as plain msgpack.
+ */
+class mix_codec : jubatus::util::lang::noncopyable {
+ public:
+  enum codec_type {
+    NONE = 0,
+    LZ4 = 1,
+    ZSTD = 2
+  };
+
+  enum flag_type {
+    QUANTIZED = 1
+  };
+
+  static const size_t HEADER_SIZE = 12;
+
+  // "none", "lz4", "zstd" or "zstd:<level>"
+  explicit mix_codec(const std::string& spec);
+
+  // set of codecs which this build can decode, as bits of (1 << codec_type)
+  static int supported();
+
+  // accept set of the sender of the payload (0 if it has no header)
+  static int accept_of(const char* data, size_t size);
+
+  // flags of the payload (0 if it has no header)
+  static int flags_of(const char* data, size_t size);
+
+  codec_type codec() const {
+    return codec_;
+  }
+
+  std::string spec() const;
+
+  // wrap the payload for the peer which accepts codecs in peer_accept
+  // flags can be set only if peer_accept is not 0
+  core::common::byte_buffer encode(
+      const char* data,
+      size_t size,
+      int peer_accept,
+      int flags = 0) const;
+
+  // returns the msgpack body of the payload; decompressed data is stored in
+  // buf, otherwise the body points into the data
+  std::pair<const char*, size_t> decode(
+      const char* data,
+      size_t size,
+      std::vector<char>& buf) const;
+
+  void get_status(server_base::status_t& status) const;
+
+ private:
+  bool compress(
+      const char* data,
+      size_t size,
+      int flags,
+      std::vector<char>& out) const;
+
+  codec_type codec_;
+  int level_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  mutable uint64_t raw_bytes_;
+  mutable uint64_t compressed_bytes_;
+  mutable double compress_sec_;
+  mutable double decompress_sec_;
+};
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_MIXER_MIX_CODEC_HPP_
@@ -0,0 +1,116 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/core/common/exception.hpp"
+#include "mix_codec.hpp"
+
+using std::pair;
+using std::string;
+using std::vector;
+using jubatus::core::common::byte_buffer;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+namespace {
+
+string repetitive_payload() {
+  string s;
+  for (int i = 0; i < 1000; ++i) {
+    s += "jubatus";
+  }
+  return s;
+}
+
+string round_trip(const mix_codec& codec, const byte_buffer& encoded) {
+  vector<char> buf;
+  const pair<const char*, size_t> body =
+      codec.decode(encoded.ptr(), encoded.size(), buf);
+  return string(body.first, body.second);
+}
+
+}  // namespace
+
+TEST(mix_codec, plain_for_legacy_peer) {
+  mix_codec codec("none");
+  const string payload = repetitive_payload();
+  byte_buffer encoded = codec.encode(payload.data(), payload.size(), 0);
+
+  // peers which do not know the header get msgpack as is
+  EXPECT_EQ(payload, string(encoded.ptr(), encoded.size()));
+  EXPECT_EQ(0, mix_codec::accept_of(encoded.ptr(), encoded.size()));
+  EXPECT_EQ(payload, round_trip(codec, encoded));
+}
+
+TEST(mix_codec, header_tells_accept) {
+  mix_codec codec("none");
+  const string payload = repetitive_payload();
+  byte_buffer encoded = codec.encode(
+      payload.data(), payload.size(), mix_codec::supported());
+
+  EXPECT_EQ(payload.size() + mix_codec::HEADER_SIZE, encoded.size());
+  EXPECT_EQ(mix_codec::supported(),
+            mix_codec::accept_of(encoded.ptr(), encoded.size()));
+  EXPECT_EQ(payload, round_trip(codec, encoded));
+}
+
+TEST(mix_codec, compress_round_trip) {
+  const char* specs[] = { "lz4", "zstd", "zstd:1" };
+  const mix_codec::codec_type types[] = {
+    mix_codec::LZ4, mix_codec::ZSTD, mix_codec::ZSTD
+  };
+  const string payload = repetitive_payload();
+
+  for (size_t i = 0; i < sizeof(specs) / sizeof(*specs); ++i) {
+    if (!(mix_codec::supported() & (1 << types[i]))) {
+      EXPECT_THROW(mix_codec codec(specs[i]),
+                   core::common::exception::jubatus_exception);
+      continue;
+    }
+    mix_codec codec(specs[i]);
+    byte_buffer encoded = codec.encode(
+        payload.data(), payload.size(), mix_codec::supported());
+    EXPECT_LT(encoded.size(), payload.size()) << specs[i];
+    EXPECT_EQ(payload, round_trip(codec, encoded)) << specs[i];
+
+    // the receiver does not need to use the same codec
+    mix_codec receiver("none");
+    EXPECT_EQ(payload, round_trip(receiver, encoded)) << specs[i];
+
+    // not compressed if the peer does not accept the codec
+    byte_buffer plain = codec.encode(
+        payload.data(), payload.size(), 1 << mix_codec::NONE);
+    EXPECT_EQ(payload.size() + mix_codec::HEADER_SIZE, plain.size());
+  }
+}
+
+TEST(mix_codec, invalid_spec) {
+  EXPECT_THROW(mix_codec("gzip"), core::common::exception::jubatus_exception);
+  EXPECT_THROW(mix_codec("lz4:3"), core::common::exception::jubatus_exception);
+  EXPECT_THROW(mix_codec("zstd:x"),
+               core::common::exception::jubatus_exception);
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
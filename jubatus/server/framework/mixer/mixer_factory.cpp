@@ -20,15 +20,16 @@
 #include <utility>
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/core/common/exception.hpp"
+#include "../../common/logger/logger.hpp"
 
 #ifdef HAVE_ZOOKEEPER_H
 #include "linear_mixer.hpp"
+#include "tree_mixer.hpp"
 #include "random_mixer.hpp"
 #include "broadcast_mixer.hpp"
 #include "skip_mixer.hpp"
-#else
-#include "dummy_mixer.hpp"
 #endif
+#include "dummy_mixer.hpp"
 
 using std::make_pair;
 using std::string;
@@ -56,7 +57,37 @@ mixer* create_mixer(
         model_mutex,
         a.interval_count,
         a.interval_sec,
-        protocol_version);
+        protocol_version,
+        a.mix_compression,
+        a.mix_quantization,
+        a.mix_sparsify_threshold,
+        a.mix_sparsify_top_k);
+  } else if (use_mixer == "tree_mixer") {
+    if (a.mix_quantization != "none" || a.mix_sparsify_threshold != 0 ||
+        a.mix_sparsify_top_k != 0) {
+      LOG(WARNING) << "mix_quantization and mix_sparsify_* options are "
+                   << "ignored by tree_mixer";
+    }
+    if (a.mix_compression != "none") {
+      LOG(INFO) << "tree_mixer compresses only models sent to joining "
+                << "servers, not diffs";
+    }
+    return new tree_mixer(
+        linear_communication::create(
+            zk,
+            a.type,
+            a.name,
+            a.interconnect_timeout,
+            make_pair(a.eth, a.port)),
+        tree_communication::create(zk, a.type, a.name),
+        model_mutex,
+        a.interval_count,
+        a.interval_sec,
+        protocol_version,
+        a.mixer_fanout,
+        a.interconnect_timeout,
+        make_pair(a.eth, a.port),
+        a.mix_compression);
   } else if (use_mixer == "random_mixer") {
     return new random_mixer(
         push_communication::create(
@@ -66,7 +97,8 @@ mixer* create_mixer(
             a.interconnect_timeout,
             make_pair(a.eth, a.port)),
         model_mutex,
-        a.interval_count, a.interval_sec, make_pair(a.eth, a.port));
+        a.interval_count, a.interval_sec, make_pair(a.eth, a.port),
+        a.mix_compression);
   } else if (use_mixer == "broadcast_mixer") {
     return new broadcast_mixer(
         push_communication::create(
@@ -76,7 +108,8 @@ mixer* create_mixer(
             a.interconnect_timeout,
             make_pair(a.eth, a.port)),
         model_mutex,
-        a.interval_count, a.interval_sec, make_pair(a.eth, a.port));
+        a.interval_count, a.interval_sec, make_pair(a.eth, a.port),
+        a.mix_compression);
   } else if (use_mixer == "skip_mixer") {
     return new skip_mixer(
         push_communication::create(
@@ -86,7 +119,11 @@ mixer* create_mixer(
             a.interconnect_timeout,
             make_pair(a.eth, a.port)),
         model_mutex,
-        a.interval_count, a.interval_sec, make_pair(a.eth, a.port));
+        a.interval_count, a.interval_sec, make_pair(a.eth, a.port),
+        a.mix_compression);
+  } else if (use_mixer == "no_mixer") {
+    // each server keeps its own part of the model (e.g., rows)
+    return new dummy_mixer;
   } else {
     throw JUBATUS_EXCEPTION(jubatus::core::common::exception::runtime_error(
           "unsupported mix type (" + use_mixer + ")"));
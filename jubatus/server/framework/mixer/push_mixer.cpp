@@ -26,6 +26,7 @@
 #include "jubatus/core/framework/stream_writer.hpp"
 #include "jubatus/core/framework/mixable.hpp"
 #include "../../common/membership.hpp"
+#include "../../common/mprpc/rpc_connection_pool.hpp"
 #include "../../common/mprpc/rpc_mclient.hpp"
 #include "../../common/unique_lock.hpp"
 
@@ -70,6 +71,7 @@ class push_communication_impl : public push_communication {
       common::mprpc::rpc_result_object& result) const;
   void get_pull_argument(
       const pair<string, int>& server,
+      int accept,
       common::mprpc::rpc_result_object& result) const;
   void push(
       const pair<string, int>& server,
@@ -120,6 +122,9 @@ size_t push_communication_impl::update_members() {
                              my_id_),
                  servers_.end());
 
+  // drop pooled sessions to the servers which left the cluster
+  common::mprpc::rpc_connection_pool::shared().retain(servers_);
+
   return servers_.size();
 }
 
@@ -150,20 +155,21 @@ void push_communication_impl::pull(
   vector<pair<string, int> > servers;
   servers.push_back(server);
 
-  // TODO(beam2d): to be replaced to new client with socket connection pooling
-  common::mprpc::rpc_mclient client(servers, timeout_sec_);
+  common::mprpc::rpc_mclient client(
+      servers, timeout_sec_, common::mprpc::rpc_connection_pool::shared());
   result = client.call("pull", arg);
 }
 
 void push_communication_impl::get_pull_argument(
   const pair<string, int>& server,
+  int accept,
   common::mprpc::rpc_result_object& result) const {
   vector<pair<string, int> > servers;
   servers.push_back(server);
 
-  // TODO(beam2d): to be replaced to new client with socket connection pooling
-  common::mprpc::rpc_mclient client(servers, timeout_sec_);
-  result = client.call("get_pull_argument", 0);
+  common::mprpc::rpc_mclient client(
+      servers, timeout_sec_, common::mprpc::rpc_connection_pool::shared());
+  result = client.call("get_pull_argument", accept);
 }
 
 void push_communication_impl::push(
@@ -173,8 +179,8 @@ void push_communication_impl::push(
   vector<pair<string, int> > servers;
   servers.push_back(server);
 
-  // TODO(beam2d): to be replaced to new client with socket connection pooling
-  common::mprpc::rpc_mclient client(servers, timeout_sec_);
+  common::mprpc::rpc_mclient client(
+      servers, timeout_sec_, common::mprpc::rpc_connection_pool::shared());
   result = client.call("push", diff);
 }
 
@@ -213,8 +219,10 @@ push_mixer::push_mixer(
     jubatus::util::concurrent::rw_mutex& mutex,
     unsigned int count_threshold,
     unsigned int tick_threshold,
-    const std::pair<std::string, int>& my_id)
+    const std::pair<std::string, int>& my_id,
+    const std::string& compression)
     : communication_(communication),
+      codec_(compression),
       count_threshold_(count_threshold),
       tick_threshold_(tick_threshold),
       my_id_(my_id),
@@ -303,6 +311,7 @@ void push_mixer::get_status(server_base::status_t& status) const {
     jubatus::util::lang::lexical_cast<string>(counter_);
   status["push_mixer.ticktime"] =
     jubatus::util::lang::lexical_cast<string>(ticktime_.sec);  // since last mix
+  codec_.get_status(status);
 }
 
 void push_mixer::mixer_loop() {
@@ -361,8 +370,23 @@ void push_mixer::mix() {
       for (size_t i = 0; i < candidates.size(); ++i) {
         const pair<string, int>& she = *candidates[i];
 
+        // get her argument first; it tells which codecs she accepts
+        common::mprpc::rpc_result_object args_result;
+        communication_->get_pull_argument(
+            she, mix_codec::supported(), args_result);
+        if (handle_communication_error("get_pull_argument", args_result)) {
+          continue;
+        }
+        msgpack::object her_args =
+            args_result.response.front()();
+        if (her_args.type != msgpack::type::RAW) {
+          throw msgpack::rpc::argument_error();
+        }
+        const int her_accept =
+            mix_codec::accept_of(her_args.via.raw.ptr, her_args.via.raw.size);
+
         // pull from her
-        byte_buffer my_args = get_pull_argument(0);
+        byte_buffer my_args = get_pull_argument(her_accept);
 
         common::mprpc::rpc_result_object pull_result;
         communication_->pull(she, my_args, pull_result);
@@ -372,13 +396,6 @@ void push_mixer::mix() {
         msgpack::object her_diff = pull_result.response.front()();
 
         // pull from me
-        common::mprpc::rpc_result_object args_result;
-        communication_->get_pull_argument(she, args_result);
-        if (handle_communication_error("get_pull_argument", args_result)) {
-          continue;
-        }
-        msgpack::object her_args =
-            args_result.response.front()();
         byte_buffer my_diff = pull(her_args);
 
         // push to her and me
@@ -418,8 +435,14 @@ byte_buffer push_mixer::pull(const msgpack::object& arg_obj) {
   if (arg_obj.type != msgpack::type::RAW) {
     throw msgpack::rpc::argument_error();
   }
+  // the diff is encoded for the codecs which the requester accepts
+  const int accept =
+      mix_codec::accept_of(arg_obj.via.raw.ptr, arg_obj.via.raw.size);
+  vector<char> buf;
+  const pair<const char*, size_t> body =
+      codec_.decode(arg_obj.via.raw.ptr, arg_obj.via.raw.size, buf);
   msgpack::unpacked msg;
-  msgpack::unpack(&msg, arg_obj.via.raw.ptr, arg_obj.via.raw.size);
+  msgpack::unpack(&msg, body.first, body.second);
   msgpack::object arg = msg.get();
 
   scoped_rlock lk_read(model_mutex_);
@@ -435,10 +458,10 @@ byte_buffer push_mixer::pull(const msgpack::object& arg_obj) {
 
   mixable->pull(arg, pk);
 
-  return byte_buffer(sbuf.data(), sbuf.size());
+  return codec_.encode(sbuf.data(), sbuf.size(), accept);
 }
 
-byte_buffer push_mixer::get_pull_argument(int dummy_arg) {
+byte_buffer push_mixer::get_pull_argument(int accept) {
   scoped_rlock lk_read(model_mutex_);
   scoped_lock lk(m_);
 
@@ -452,7 +475,7 @@ byte_buffer push_mixer::get_pull_argument(int dummy_arg) {
 
   mixable->get_argument(pk);
 
-  return byte_buffer(sbuf.data(), sbuf.size());
+  return codec_.encode(sbuf.data(), sbuf.size(), accept);
 }
 
 int push_mixer::push(const msgpack::object& diff_obj) {
@@ -460,8 +483,11 @@ int push_mixer::push(const msgpack::object& diff_obj) {
     throw msgpack::rpc::argument_error();
   }
 
+  vector<char> buf;
+  const pair<const char*, size_t> body =
+      codec_.decode(diff_obj.via.raw.ptr, diff_obj.via.raw.size, buf);
   msgpack::unpacked msg;
-  msgpack::unpack(&msg, diff_obj.via.raw.ptr, diff_obj.via.raw.size);
+  msgpack::unpack(&msg, body.first, body.second);
   msgpack::object diff = msg.get();
 
   scoped_wlock lk_write(model_mutex_);
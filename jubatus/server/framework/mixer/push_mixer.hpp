@@ -28,6 +28,7 @@
 #include "jubatus/core/common/byte_buffer.hpp"
 #include "../../common/lock_service.hpp"
 #include "../../common/mprpc/rpc_mclient.hpp"
+#include "mix_codec.hpp"
 #include "mixer.hpp"
 
 namespace jubatus {
@@ -64,8 +65,10 @@ class push_communication {
       const core::common::byte_buffer& arg,
       jubatus::server::common::mprpc::rpc_result_object& result) const = 0;
 
+  // accept is the set of codecs we can decode (see mix_codec)
   virtual void get_pull_argument(
       const std::pair<std::string, int>& server,
+      int accept,
       jubatus::server::common::mprpc::rpc_result_object& result) const = 0;
 
   // it can throw common::mprpc exception
@@ -84,7 +87,8 @@ class push_mixer : public jubatus::server::framework::mixer::mixer {
       jubatus::util::lang::shared_ptr<push_communication> communication,
       jubatus::util::concurrent::rw_mutex& mutex,
       unsigned int count_threshold, unsigned int tick_threshold,
-      const std::pair<std::string, int>& my_id);
+      const std::pair<std::string, int>& my_id,
+      const std::string& compression = "none");
   ~push_mixer();
 
   void register_api(rpc_server_t& server);
@@ -110,10 +114,11 @@ class push_mixer : public jubatus::server::framework::mixer::mixer {
   void mix();
 
   core::common::byte_buffer pull(const msgpack::object& arg);
-  core::common::byte_buffer get_pull_argument(int dummy_arg);
+  core::common::byte_buffer get_pull_argument(int accept);
   int push(const msgpack::object& diff);
 
   jubatus::util::lang::shared_ptr<push_communication> communication_;
+  mix_codec codec_;
   unsigned int count_threshold_;
   unsigned int tick_threshold_;
   const std::pair<std::string, int> my_id_;
@@ -35,9 +35,11 @@ class random_mixer : public push_mixer {
       jubatus::util::concurrent::rw_mutex& mutex,
       unsigned int count_threshold,
       unsigned int tick_threshold,
-      const std::pair<std::string, int>& my_id)
+      const std::pair<std::string, int>& my_id,
+      const std::string& compression = "none")
       : push_mixer(
-          communication, mutex, count_threshold, tick_threshold, my_id) {
+          communication, mutex, count_threshold, tick_threshold, my_id,
+          compression) {
   }
   virtual ~random_mixer() {
   }
@@ -0,0 +1,479 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "tree_mixer.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <msgpack.hpp>
+
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/util/system/time_util.h"
+#include "jubatus/core/common/exception.hpp"
+#include "jubatus/core/framework/mixable.hpp"
+#include "jubatus/core/framework/stream_writer.hpp"
+#include "../../common/membership.hpp"
+#include "../../common/mprpc/rpc_connection_pool.hpp"
+#include "../../common/mprpc/rpc_mclient.hpp"
+#include "../../common/logger/logger.hpp"
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using jubatus::core::common::byte_buffer;
+using jubatus::core::framework::diff_object;
+using jubatus::core::framework::linear_mixable;
+using jubatus::core::framework::stream_writer;
+using jubatus::core::framework::packer;
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::system::time::clock_time;
+using jubatus::util::system::time::get_clock_time;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+namespace {
+
+class tree_communication_impl : public tree_communication {
+ public:
+  tree_communication_impl(
+      const jubatus::util::lang::shared_ptr<common::lock_service>& zk,
+      const string& type,
+      const string& name)
+      : zk_(zk),
+        type_(type),
+        name_(name) {
+  }
+
+  size_t update_members(vector<pair<string, int> >& members) {
+    members.clear();
+    common::get_all_nodes(*zk_, type_, name_, members);
+    std::sort(members.begin(), members.end());
+
+    // drop pooled sessions to the servers which left the cluster
+    common::mprpc::rpc_connection_pool::shared().retain(members);
+    return members.size();
+  }
+
+  void get_diff(
+      const vector<pair<string, int> >& children,
+      const tree_layout& layout,
+      int timeout_sec,
+      const common::mprpc::rpc_mclient::response_handler& handler) const {
+    common::mprpc::rpc_mclient client(
+        children, timeout_sec, common::mprpc::rpc_connection_pool::shared());
+    client.call_streaming("tree_get_diff", layout, handler);
+  }
+
+  void put_diff(
+      const vector<pair<string, int> >& children,
+      const tree_diff& mixed,
+      int timeout_sec,
+      common::mprpc::rpc_result_object& result) const {
+    common::mprpc::rpc_mclient client(
+        children, timeout_sec, common::mprpc::rpc_connection_pool::shared());
+    result = client.call("tree_put_diff", mixed);
+  }
+
+ private:
+  jubatus::util::lang::shared_ptr<common::lock_service> zk_;
+  const string type_;
+  const string name_;
+};
+
+// level_time[0] is the time of this node; times of the subtree of the child
+// are merged into the next levels
+void merge_level_time(const vector<double>& child, vector<double>& level_time) {
+  if (level_time.size() < child.size() + 1) {
+    level_time.resize(child.size() + 1, 0.0);
+  }
+  for (size_t i = 0; i < child.size(); ++i) {
+    level_time[i + 1] = std::max(level_time[i + 1], child[i]);
+  }
+}
+
+// folds diffs of the node itself and its subtrees
+class subtree_reducer {
+ public:
+  subtree_reducer(linear_mixable* mixable, vector<double>& level_time)
+      : mixable_(mixable),
+        level_time_(level_time) {
+  }
+
+  void add(const char* ptr, size_t size) {
+    msgpack::unpacked msg;
+    msgpack::unpack(&msg, ptr, size);
+    if (!diff_) {
+      diff_ = mixable_->convert_diff_object(msg.get());
+    } else {
+      mixable_->mix(msg.get(), diff_);
+    }
+  }
+
+  void reduce(
+      const common::mprpc::rpc_error& from,
+      common::mprpc::rpc_response_t& response) {
+    if (response.has_error()) {
+      const string error_text(
+          common::mprpc::create_error_string(response.error()));
+      LOG(WARNING) << "tree_get_diff failed at "
+                   << from.host() << ":" << from.port()
+                   << " : " << error_text;
+      return;
+    }
+
+    // [diff, level_time]
+    msgpack::object res = response();
+    if (res.type != msgpack::type::ARRAY || res.via.array.size != 2 ||
+        res.via.array.ptr[0].type != msgpack::type::RAW) {
+      LOG(WARNING) << "invalid tree_get_diff response from "
+                   << from.host() << ":" << from.port();
+      return;
+    }
+
+    const msgpack::object& packed = res.via.array.ptr[0];
+    add(packed.via.raw.ptr, packed.via.raw.size);
+    merge_level_time(
+        res.via.array.ptr[1].as<vector<double> >(), level_time_);
+  }
+
+  diff_object& diff() {
+    return diff_;
+  }
+
+ private:
+  linear_mixable* mixable_;
+  vector<double>& level_time_;
+  diff_object diff_;
+};
+
+string level_time_key(const string& phase, size_t level) {
+  return "tree_mixer.level" + lexical_cast<string>(level) + "." + phase;
+}
+
+}  // namespace
+
+vector<size_t> tree_children(size_t index, size_t size, size_t fanout) {
+  vector<size_t> children;
+  for (size_t i = 1; i <= fanout; ++i) {
+    const size_t child = index * fanout + i;
+    if (size <= child) {
+      break;
+    }
+    children.push_back(child);
+  }
+  return children;
+}
+
+size_t tree_height(size_t index, size_t size, size_t fanout) {
+  if (size <= index) {
+    return 0;
+  }
+  // the leftmost descendant is on the deepest level
+  size_t height = 1;
+  for (size_t first = index; first * fanout + 1 < size;
+       first = first * fanout + 1) {
+    ++height;
+  }
+  return height;
+}
+
+jubatus::util::lang::shared_ptr<tree_communication>
+tree_communication::create(
+    const jubatus::util::lang::shared_ptr<common::lock_service>& zk,
+    const string& type,
+    const string& name) {
+  return jubatus::util::lang::shared_ptr<tree_communication>(
+      new tree_communication_impl(zk, type, name));
+}
+
+tree_mixer::tree_mixer(
+    jubatus::util::lang::shared_ptr<linear_communication> communication,
+    jubatus::util::lang::shared_ptr<tree_communication> tree_comm,
+    jubatus::util::concurrent::rw_mutex& mutex,
+    unsigned int count_threshold,
+    unsigned int tick_threshold,
+    uint64_t protocol_version,
+    int fanout,
+    int timeout_sec,
+    const pair<string, int>& my_id,
+    const string& compression)
+    : linear_mixer(
+          communication,
+          mutex,
+          count_threshold,
+          tick_threshold,
+          protocol_version,
+          compression),
+      tree_communication_(tree_comm),
+      fanout_(fanout),
+      timeout_sec_(timeout_sec),
+      my_id_(my_id) {
+  if (fanout_ < 1) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "fanout of tree_mixer must be positive: " +
+        lexical_cast<string>(fanout_)));
+  }
+}
+
+tree_mixer::~tree_mixer() {
+  // stop the mix thread before this object is destructed,
+  // as it calls mix() of this class
+  stop();
+}
+
+void tree_mixer::register_api(rpc_server_t& server) {
+  linear_mixer::register_api(server);
+
+  server.add<pair<byte_buffer, vector<double> >(tree_layout)>(  // NOLINT
+      "tree_get_diff",
+      jubatus::util::lang::bind(
+          &tree_mixer::tree_get_diff, this, jubatus::util::lang::_1));
+  server.add<vector<double>(tree_diff)>(  // NOLINT
+      "tree_put_diff",
+      jubatus::util::lang::bind(
+          &tree_mixer::tree_put_diff, this, jubatus::util::lang::_1));
+}
+
+void tree_mixer::get_status(server_base::status_t& status) const {
+  linear_mixer::get_status(status);
+
+  scoped_lock lk(stats_m_);
+  status["tree_mixer.fanout"] = lexical_cast<string>(fanout_);
+  for (size_t i = 0; i < gather_time_.size(); ++i) {
+    status[level_time_key("get_diff_time", i)] =
+        lexical_cast<string>(gather_time_[i]);
+  }
+  for (size_t i = 0; i < scatter_time_.size(); ++i) {
+    status[level_time_key("put_diff_time", i)] =
+        lexical_cast<string>(scatter_time_[i]);
+  }
+}
+
+void tree_mixer::mix() {
+  const clock_time start = get_clock_time();
+
+  tree_diff mixed;
+  tree_layout& layout = mixed.layout;
+  layout.fanout = fanout_;
+  const size_t servers_size =
+      tree_communication_->update_members(layout.members);
+  if (servers_size == 0) {
+    LOG(WARNING) << "no server exists, assuming myself as up-to-date "
+                 << "and becoming active node";
+    communication_->register_active_list();
+    return;
+  }
+
+  // place myself at the root
+  layout.members.erase(
+      std::remove(layout.members.begin(), layout.members.end(), my_id_),
+      layout.members.end());
+  layout.members.insert(layout.members.begin(), my_id_);
+
+  vector<double> gather_time;
+  vector<double> scatter_time;
+  try {
+    if (!dynamic_cast<linear_mixable*>(driver_->get_mixable())) {
+      // don't mix
+      return;
+    }
+    mixed.diff = gather(layout, 0, gather_time);
+    scatter(mixed, 0, scatter_time);
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "error in mix master process: " << e.what();
+    return;
+  }
+
+  {
+    scoped_lock lk(stats_m_);
+    gather_time_.swap(gather_time);
+    scatter_time_.swap(scatter_time);
+  }
+
+  const clock_time finish = get_clock_time();
+  LOG(INFO) << "mixed with " << layout.members.size() << " servers "
+            << "(fanout " << fanout_ << ", depth "
+            << tree_height(0, layout.members.size(), fanout_) << ") in "
+            << static_cast<double>(finish - start) << " secs, "
+            << mixed.diff.size() << " bytes (serialized data) has been put.";
+}
+
+pair<byte_buffer, vector<double> > tree_mixer::tree_get_diff(
+    const tree_layout& layout) {
+  vector<double> level_time;
+  const byte_buffer diff = gather(layout, position(layout), level_time);
+  return make_pair(diff, level_time);
+}
+
+vector<double> tree_mixer::tree_put_diff(const tree_diff& mixed) {
+  vector<double> level_time;
+  scatter(mixed, position(mixed.layout), level_time);
+  return level_time;
+}
+
+size_t tree_mixer::position(const tree_layout& layout) const {
+  if (layout.fanout < 1) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "invalid fanout: " + lexical_cast<string>(layout.fanout)));
+  }
+  const vector<pair<string, int> >::const_iterator it =
+      std::find(layout.members.begin(), layout.members.end(), my_id_);
+  if (it == layout.members.end()) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "this server is not in the mix tree: " + my_id_.first + ":" +
+        lexical_cast<string>(my_id_.second)));
+  }
+  return it - layout.members.begin();
+}
+
+byte_buffer tree_mixer::gather(
+    const tree_layout& layout,
+    size_t index,
+    vector<double>& level_time) {
+  const clock_time start = get_clock_time();
+
+  linear_mixable* mixable =
+      dynamic_cast<linear_mixable*>(driver_->get_mixable());
+  if (!mixable) {
+    throw JUBATUS_EXCEPTION(core::common::config_not_set());  // nothing to mix
+  }
+
+  level_time.assign(1, 0.0);
+  subtree_reducer reducer(mixable, level_time);
+  {
+    const byte_buffer own = get_diff(0);
+    reducer.add(own.ptr(), own.size());
+  }
+
+  const size_t size = layout.members.size();
+  const vector<size_t> children = tree_children(index, size, layout.fanout);
+  if (!children.empty()) {
+    vector<pair<string, int> > hosts;
+    for (size_t i = 0; i < children.size(); ++i) {
+      hosts.push_back(layout.members[children[i]]);
+    }
+
+    // children wait for their own subtrees
+    const int timeout_sec =
+        timeout_sec_ * (tree_height(index, size, layout.fanout) - 1);
+    try {
+      tree_communication_->get_diff(
+          hosts, layout, timeout_sec,
+          jubatus::util::lang::bind(
+              &subtree_reducer::reduce, &reducer,
+              jubatus::util::lang::_1, jubatus::util::lang::_2));
+    } catch (const common::mprpc::rpc_no_result& e) {
+      LOG(WARNING) << "failed to get diff from any children: "
+                   << e.diagnostic_information(false);
+    }
+  }
+
+  msgpack::sbuffer sbuf;
+  stream_writer<msgpack::sbuffer> st(sbuf);
+  core::framework::jubatus_packer jp(st);
+  packer pk(jp);
+  reducer.diff()->convert_binary(pk);
+
+  level_time[0] = static_cast<double>(get_clock_time() - start);
+  return byte_buffer(sbuf.data(), sbuf.size());
+}
+
+void tree_mixer::apply_diff(const byte_buffer& diff, string* error) {
+  try {
+    put_diff(diff);
+  } catch (const std::exception& e) {
+    *error = e.what();
+  } catch (...) {
+    *error = "unknown error";
+  }
+}
+
+void tree_mixer::scatter(
+    const tree_diff& mixed,
+    size_t index,
+    vector<double>& level_time) {
+  const clock_time start = get_clock_time();
+  level_time.assign(1, 0.0);
+
+  // apply the mixed diff to this server while forwarding it to children
+  string local_error;
+  jubatus::util::concurrent::thread local(jubatus::util::lang::bind(
+      &tree_mixer::apply_diff, this, mixed.diff, &local_error));
+  local.start();
+
+  try {
+    const size_t size = mixed.layout.members.size();
+    const vector<size_t> children =
+        tree_children(index, size, mixed.layout.fanout);
+    if (!children.empty()) {
+      vector<pair<string, int> > hosts;
+      for (size_t i = 0; i < children.size(); ++i) {
+        hosts.push_back(mixed.layout.members[children[i]]);
+      }
+
+      const int timeout_sec =
+          timeout_sec_ * (tree_height(index, size, mixed.layout.fanout) - 1);
+      common::mprpc::rpc_result_object result;
+      try {
+        tree_communication_->put_diff(hosts, mixed, timeout_sec, result);
+      } catch (const common::mprpc::rpc_no_result& e) {
+        LOG(WARNING) << "failed to put diff to any children: "
+                     << e.diagnostic_information(false);
+      }
+
+      for (size_t i = 0; i < result.response.size(); ++i) {
+        if (result.response[i].has_error()) {
+          const string error_text(common::mprpc::create_error_string(
+              result.response[i].error()));
+          LOG(WARNING) << "tree_put_diff failed at "
+                       << result.error[i].host() << ":"
+                       << result.error[i].port()
+                       << " : " << error_text;
+          continue;
+        }
+        merge_level_time(
+            result.response[i].as<vector<double> >(), level_time);
+      }
+    }
+  } catch (...) {
+    local.join();
+    throw;
+  }
+
+  local.join();
+  if (!local_error.empty()) {
+    throw JUBATUS_EXCEPTION(core::common::exception::runtime_error(
+        "failed to put diff: " + local_error));
+  }
+
+  level_time[0] = static_cast<double>(get_clock_time() - start);
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
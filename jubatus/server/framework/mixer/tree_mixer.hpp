@@ -0,0 +1,161 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_MIXER_TREE_MIXER_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_MIXER_TREE_MIXER_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <msgpack.hpp>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/core/common/byte_buffer.hpp"
+#include "../../common/lock_service.hpp"
+#include "../../common/mprpc/rpc_mclient.hpp"
+#include "linear_mixer.hpp"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+// Members arranged in a k-ary tree; node i has children k*i+1 .. k*i+k.
+// The node which holds the mix lock is placed at the root (members[0]).
+struct tree_layout {
+  std::vector<std::pair<std::string, int> > members;
+  int fanout;
+
+  MSGPACK_DEFINE(members, fanout);
+};
+
+struct tree_diff {
+  tree_layout layout;
+  core::common::byte_buffer diff;
+
+  MSGPACK_DEFINE(layout, diff);
+};
+
+// indices of children of the node in the tree
+std::vector<size_t> tree_children(size_t index, size_t size, size_t fanout);
+
+// number of levels of the subtree rooted at the node
+size_t tree_height(size_t index, size_t size, size_t fanout);
+
+class tree_communication {
+ public:
+  virtual ~tree_communication() {
+  }
+
+  static jubatus::util::lang::shared_ptr<tree_communication> create(
+      const jubatus::util::lang::shared_ptr<common::lock_service>& zk,
+      const std::string& type,
+      const std::string& name);
+
+  // get all members of the cluster (in the same order on every node)
+  virtual size_t update_members(
+      std::vector<std::pair<std::string, int> >& members) = 0;
+
+  // call tree_get_diff to children; handler is called for each response
+  // it can throw common::mprpc exception
+  virtual void get_diff(
+      const std::vector<std::pair<std::string, int> >& children,
+      const tree_layout& layout,
+      int timeout_sec,
+      const common::mprpc::rpc_mclient::response_handler& handler) const = 0;
+
+  // call tree_put_diff to children
+  // it can throw common::mprpc exception
+  virtual void put_diff(
+      const std::vector<std::pair<std::string, int> >& children,
+      const tree_diff& mixed,
+      int timeout_sec,
+      common::mprpc::rpc_result_object& result) const = 0;
+};
+
+/**
+ * MIX along a k-ary tree of servers.
+ *
+ * Each interior node reduces diffs of its children with its own diff and
+ * returns the partial result to its parent, then the mixed diff is
+ * propagated from the root down the same tree.  Traffic of each node is
+ * proportional to the fan-out instead of the cluster size.
+ *
+ * A failed node drops its whole subtree from the current round only.
+ * Partial diffs on the tree are neither compressed nor quantized:
+ * mix_compression applies to get_model only, and mix_quantization and
+ * mix_sparsify_* are ignored.
+ */
+class tree_mixer : public linear_mixer {
+ public:
+  tree_mixer(
+      jubatus::util::lang::shared_ptr<linear_communication> communication,
+      jubatus::util::lang::shared_ptr<tree_communication> tree_comm,
+      jubatus::util::concurrent::rw_mutex& mutex,
+      unsigned int count_threshold,
+      unsigned int tick_threshold,
+      uint64_t protocol_version,
+      int fanout,
+      int timeout_sec,
+      const std::pair<std::string, int>& my_id,
+      const std::string& compression = "none");
+  ~tree_mixer();
+
+  void register_api(rpc_server_t& server);
+
+  void get_status(server_base::status_t& status) const;
+
+  void mix();
+
+  std::string type() const {
+    return "tree_mixer";
+  }
+
+  // RPC handlers called by the parent in the tree
+  std::pair<core::common::byte_buffer, std::vector<double> > tree_get_diff(
+      const tree_layout& layout);
+  std::vector<double> tree_put_diff(const tree_diff& mixed);
+
+ private:
+  size_t position(const tree_layout& layout) const;
+
+  core::common::byte_buffer gather(
+      const tree_layout& layout,
+      size_t index,
+      std::vector<double>& level_time);
+  void scatter(
+      const tree_diff& mixed,
+      size_t index,
+      std::vector<double>& level_time);
+  void apply_diff(const core::common::byte_buffer& diff, std::string* error);
+
+  jubatus::util::lang::shared_ptr<tree_communication> tree_communication_;
+  const int fanout_;
+  const int timeout_sec_;
+  const std::pair<std::string, int> my_id_;
+
+  // elapsed time of each level in the last mix (index 0 is the root)
+  mutable jubatus::util::concurrent::mutex stats_m_;
+  std::vector<double> gather_time_;
+  std::vector<double> scatter_time_;
+};
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_MIXER_TREE_MIXER_HPP_
@@ -0,0 +1,372 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/concurrent/rwmutex.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/core/common/version.hpp"
+#include "jubatus/core/common/byte_buffer.hpp"
+#include "jubatus/core/framework/mixable.hpp"
+#include "jubatus/core/framework/mixable_helper.hpp"
+#include "jubatus/core/driver/driver.hpp"
+#include "tree_mixer.hpp"
+
+using std::make_pair;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+using jubatus::util::lang::shared_ptr;
+using jubatus::core::common::byte_buffer;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+namespace mixer {
+
+TEST(tree_mixer, children) {
+  // 0 -> (1, 2, 3), 1 -> (4, 5, 6), 2 -> (7, 8, 9), 3 -> (10)
+  vector<size_t> c0 = tree_children(0, 11, 3);
+  ASSERT_EQ(3u, c0.size());
+  EXPECT_EQ(1u, c0[0]);
+  EXPECT_EQ(3u, c0[2]);
+
+  vector<size_t> c2 = tree_children(2, 11, 3);
+  ASSERT_EQ(3u, c2.size());
+  EXPECT_EQ(7u, c2[0]);
+  EXPECT_EQ(9u, c2[2]);
+
+  vector<size_t> c3 = tree_children(3, 11, 3);
+  ASSERT_EQ(1u, c3.size());
+  EXPECT_EQ(10u, c3[0]);
+
+  EXPECT_TRUE(tree_children(4, 11, 3).empty());
+  EXPECT_TRUE(tree_children(0, 1, 3).empty());
+}
+
+TEST(tree_mixer, children_cover_all_members) {
+  const size_t size = 37;
+  for (size_t fanout = 1; fanout <= 5; ++fanout) {
+    vector<int> parents(size, 0);
+    for (size_t i = 0; i < size; ++i) {
+      vector<size_t> c = tree_children(i, size, fanout);
+      for (size_t j = 0; j < c.size(); ++j) {
+        ++parents[c[j]];
+      }
+    }
+    EXPECT_EQ(0, parents[0]);
+    for (size_t i = 1; i < size; ++i) {
+      EXPECT_EQ(1, parents[i]) << "fanout: " << fanout << ", node: " << i;
+    }
+  }
+}
+
+TEST(tree_mixer, height) {
+  EXPECT_EQ(1u, tree_height(0, 1, 2));
+  EXPECT_EQ(2u, tree_height(0, 2, 2));
+  EXPECT_EQ(2u, tree_height(0, 3, 2));
+  EXPECT_EQ(3u, tree_height(0, 4, 2));
+  EXPECT_EQ(2u, tree_height(1, 4, 2));
+  EXPECT_EQ(1u, tree_height(2, 4, 2));
+  EXPECT_EQ(0u, tree_height(4, 4, 2));
+
+  // linear chain
+  EXPECT_EQ(5u, tree_height(0, 5, 1));
+  EXPECT_EQ(2u, tree_height(3, 5, 1));
+
+  EXPECT_EQ(3u, tree_height(0, 11, 3));
+  EXPECT_EQ(2u, tree_height(3, 11, 3));
+}
+
+namespace {
+
+typedef pair<string, int> node_id;
+
+node_id node(int i) {
+  return make_pair("127.0.0.1", 9200 + i);
+}
+
+template<typename T>
+common::mprpc::rpc_response_t make_response(const T& value) {
+  msgpack::sbuffer sbuf;
+  msgpack::pack(sbuf, value);
+  msgpack::unpacked msg;
+  msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+
+  common::mprpc::rpc_response_t res;
+  res.zone = mp::shared_ptr<msgpack::zone>(msg.zone().release());
+  res.response.a3 = msg.get();
+  return res;
+}
+
+// diffs are strings, which are mixed as "(new+mixed)"
+struct my_string {
+  string diff;
+  string applied;
+
+  void get_diff(string& d) const {
+    d = diff;
+  }
+  bool put_diff(const string& d) {
+    applied = d;
+    return true;
+  }
+  void mix(const string& lhs, string& mixed) const {
+    mixed = "(" + lhs + "+" + mixed + ")";
+  }
+
+  core::storage::version get_version() const {
+    return core::storage::version();
+  }
+};
+
+typedef core::framework::linear_mixable_helper<my_string, string>
+  mixable_string;
+
+class my_string_driver : public core::driver::driver_base {
+ public:
+  explicit my_string_driver(const string& diff)
+      : model_(new my_string),
+        string_(model_) {
+    model_->diff = diff;
+    register_mixable(&string_);
+  }
+
+  void pack(core::framework::packer& packer) const {
+  }
+  void unpack(msgpack::object o) {
+  }
+  void clear() {
+  }
+
+  const string& applied() const {
+    return model_->applied;
+  }
+
+ private:
+  shared_ptr<my_string> model_;
+  mixable_string string_;
+};
+
+class linear_communication_stub : public linear_communication {
+ public:
+  size_t update_members() {
+    return 0;
+  }
+  pair<uint64_t, byte_buffer> get_model(int accept) {
+    return make_pair(1, byte_buffer());
+  }
+  uint64_t get_model_chunked(
+      int accept,
+      size_t chunk_size,
+      size_t window,
+      const chunk_handler& handler) {
+    return 0;
+  }
+  shared_ptr<common::try_lockable> create_lock() {
+    return shared_ptr<common::try_lockable>();
+  }
+  void get_diff(
+      int accept,
+      const common::mprpc::rpc_mclient::response_handler& handler) const {
+  }
+  void put_diff(
+      const byte_buffer& mixed,
+      common::mprpc::rpc_result_object& result) const {
+  }
+  bool register_active_list() const {
+    return true;
+  }
+  bool unregister_active_list() const {
+    return true;
+  }
+};
+
+// servers in this process; calls to children are made directly
+struct tree_network {
+  map<node_id, tree_mixer*> mixers;
+  map<node_id, bool> failed;
+  // timeout of each call to the children of the node
+  map<node_id, vector<int> > timeouts;
+};
+
+class tree_communication_stub : public tree_communication {
+ public:
+  tree_communication_stub(tree_network& network, const node_id& self)
+      : network_(network),
+        self_(self) {
+  }
+
+  size_t update_members(vector<node_id>& members) {
+    members.clear();
+    for (map<node_id, tree_mixer*>::const_iterator it =
+             network_.mixers.begin(); it != network_.mixers.end(); ++it) {
+      members.push_back(it->first);
+    }
+    return members.size();
+  }
+
+  void get_diff(
+      const vector<node_id>& children,
+      const tree_layout& layout,
+      int timeout_sec,
+      const common::mprpc::rpc_mclient::response_handler& handler) const {
+    network_.timeouts[self_].push_back(timeout_sec);
+    size_t handled = 0;
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (network_.failed[children[i]]) {
+        continue;
+      }
+      common::mprpc::rpc_response_t res = make_response(
+          network_.mixers[children[i]]->tree_get_diff(layout));
+      handler(common::mprpc::rpc_error(
+          children[i].first, children[i].second), res);
+      ++handled;
+    }
+    if (handled == 0) {
+      throw JUBATUS_EXCEPTION(common::mprpc::rpc_no_result());
+    }
+  }
+
+  void put_diff(
+      const vector<node_id>& children,
+      const tree_diff& mixed,
+      int timeout_sec,
+      common::mprpc::rpc_result_object& result) const {
+    network_.timeouts[self_].push_back(timeout_sec);
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (network_.failed[children[i]]) {
+        continue;
+      }
+      result.response.push_back(make_response(
+          network_.mixers[children[i]]->tree_put_diff(mixed)));
+      result.error.push_back(common::mprpc::rpc_error(
+          children[i].first, children[i].second));
+    }
+    if (result.response.empty()) {
+      throw JUBATUS_EXCEPTION(common::mprpc::rpc_no_result());
+    }
+  }
+
+ private:
+  tree_network& network_;
+  const node_id self_;
+};
+
+const int TIMEOUT_SEC = 10;
+
+// servers 0 .. size-1 whose diffs are "a", "b", ... in a tree of fanout 2
+class tree_mixer_cluster {
+ public:
+  explicit tree_mixer_cluster(size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      mutexes_.push_back(shared_ptr<jubatus::util::concurrent::rw_mutex>(
+          new jubatus::util::concurrent::rw_mutex));
+      drivers_.push_back(shared_ptr<my_string_driver>(
+          new my_string_driver(string(1, static_cast<char>('a' + i)))));
+      mixers_.push_back(shared_ptr<tree_mixer>(new tree_mixer(
+          shared_ptr<linear_communication>(new linear_communication_stub),
+          shared_ptr<tree_communication>(
+              new tree_communication_stub(network, node(i))),
+          *mutexes_[i], 1, 1, 1, 2, TIMEOUT_SEC, node(i))));
+      mixers_[i]->set_driver(drivers_[i].get());
+      network.mixers[node(i)] = mixers_[i].get();
+    }
+  }
+
+  tree_mixer& mixer(size_t i) {
+    return *mixers_[i];
+  }
+
+  const string& applied(size_t i) const {
+    return drivers_[i]->applied();
+  }
+
+  tree_network network;
+
+ private:
+  vector<shared_ptr<jubatus::util::concurrent::rw_mutex> > mutexes_;
+  vector<shared_ptr<my_string_driver> > drivers_;
+  vector<shared_ptr<tree_mixer> > mixers_;
+};
+
+}  // namespace
+
+TEST(tree_mixer, mix_along_tree) {
+  // 0 -> (1, 2), 1 -> (3, 4)
+  tree_mixer_cluster cluster(5);
+  cluster.mixer(0).mix();
+
+  // interior nodes reduce their subtrees before the root does
+  const string expected = "(c+((e+(d+b))+a))";
+  for (size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(expected, cluster.applied(i)) << "node " << i;
+  }
+}
+
+TEST(tree_mixer, timeout_per_level) {
+  tree_mixer_cluster cluster(5);
+  cluster.mixer(0).mix();
+
+  // the root waits for two levels below it, node 1 for one
+  const vector<int>& root = cluster.network.timeouts[node(0)];
+  ASSERT_EQ(2u, root.size());  // get_diff and put_diff
+  EXPECT_EQ(2 * TIMEOUT_SEC, root[0]);
+  EXPECT_EQ(2 * TIMEOUT_SEC, root[1]);
+
+  const vector<int>& interior = cluster.network.timeouts[node(1)];
+  ASSERT_EQ(2u, interior.size());
+  EXPECT_EQ(TIMEOUT_SEC, interior[0]);
+  EXPECT_EQ(TIMEOUT_SEC, interior[1]);
+
+  // leaves have no children to call
+  EXPECT_TRUE(cluster.network.timeouts[node(2)].empty());
+  EXPECT_TRUE(cluster.network.timeouts[node(4)].empty());
+}
+
+TEST(tree_mixer, failed_child_drops_subtree) {
+  tree_mixer_cluster cluster(5);
+  cluster.network.failed[node(1)] = true;
+  cluster.mixer(0).mix();
+
+  EXPECT_EQ("(c+a)", cluster.applied(0));
+  EXPECT_EQ("(c+a)", cluster.applied(2));
+
+  // the subtree of node 1 misses this round
+  EXPECT_EQ("", cluster.applied(1));
+  EXPECT_EQ("", cluster.applied(3));
+  EXPECT_EQ("", cluster.applied(4));
+}
+
+TEST(tree_mixer, all_children_failed) {
+  tree_mixer_cluster cluster(3);
+  cluster.network.failed[node(1)] = true;
+  cluster.network.failed[node(2)] = true;
+  cluster.mixer(0).mix();
+
+  // the root mixes with itself only
+  EXPECT_EQ("a", cluster.applied(0));
+  EXPECT_EQ("", cluster.applied(1));
+}
+
+}  // namespace mixer
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -35,6 +35,9 @@ namespace framework {
 
 __thread proxy::async_task_loop*
   proxy::async_task_loop::private_async_task_loop_ = NULL;
+proxy::async_task_loop* proxy::async_task_loop::shared_async_task_loop_ = NULL;
+jubatus::util::concurrent::mutex
+  proxy::async_task_loop::shared_async_task_loop_mutex_;
 
 // NOTE: '__thread' is gcc-extension. We should re-implement with
 //       pthread TLS?
@@ -43,19 +46,22 @@ proxy::proxy(const proxy_argv& a)
     : proxy_common(a),
       jubatus::server::common::mprpc::rpc_server(a.timeout) {
   // register default methods
-  register_async_random<std::string>("get_config");
+  // set_config does not pass the proxy, so the config is never cached
+  register_async_random<std::string>("get_config", UNCACHED);
   register_async_broadcast<bool, std::string>(
       "save",
       jubatus::util::lang::function<bool(bool, bool)>(
-          &jubatus::server::framework::all_and));
+          &jubatus::server::framework::all_and),
+      UNCACHED);
   register_async_broadcast<bool, std::string>(
       "load",
       jubatus::util::lang::function<bool(bool, bool)>(
           &jubatus::server::framework::all_and));
   register_async_broadcast<status_type>(
       "get_status",
-      jubatus::util::lang::function<status_type(status_type, status_type)>(
-          &jubatus::server::framework::merge<std::string, string_map>));
+      jubatus::util::lang::function<void(status_type&, status_type&)>(
+          &jubatus::server::framework::merge_into<std::string, string_map>),
+      UNCACHED);
   rpc_server::add<status_type()>(
       "get_proxy_status",
       jubatus::util::lang::bind(&proxy::get_status, this));
@@ -17,6 +17,7 @@
 #ifndef JUBATUS_SERVER_FRAMEWORK_PROXY_HPP_
 #define JUBATUS_SERVER_FRAMEWORK_PROXY_HPP_
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -24,10 +25,16 @@
 
 #include <jubatus/msgpack/rpc/client.h>
 #include <msgpack.hpp>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
 #include "jubatus/util/concurrent/thread.h"
 #include "jubatus/util/lang/function.h"
 #include "jubatus/util/lang/bind.h"
+#include "jubatus/util/system/time_util.h"
 
+#include "backend_load.hpp"
+#include "hedge_policy.hpp"
+#include "result_cache.hpp"
 #include "proxy_common.hpp"
 #include "server_util.hpp"
 #include "../common/logger/logger.hpp"
@@ -48,6 +55,45 @@ namespace jubatus {
 namespace server {
 namespace framework {
 
+/*
+ * Reduces the result from a server (rhs) into the accumulated one (lhs).
+ * Either an aggregator returning a new result or an in-place one (which
+ * may swap elements out of rhs) can be used.
+ */
+template<typename R>
+class result_reducer {
+ public:
+  typedef jubatus::util::lang::function<R(R, R)> function_type;
+  typedef jubatus::util::lang::function<void(R&, R&)> inplace_type;
+
+  result_reducer() {
+  }
+
+  result_reducer(const function_type& f)  // NOLINT
+      : f_(f) {
+  }
+
+  result_reducer(const inplace_type& f)  // NOLINT
+      : inplace_(f) {
+  }
+
+  bool empty() const {
+    return !f_ && !inplace_;
+  }
+
+  void operator()(R& lhs, R& rhs) const {
+    if (inplace_) {
+      inplace_(lhs, rhs);
+    } else {
+      lhs = f_(lhs, rhs);
+    }
+  }
+
+ private:
+  function_type f_;
+  inplace_type inplace_;
+};
+
 class proxy
     : public proxy_common, jubatus::server::common::mprpc::rpc_server {
  public:
@@ -60,168 +106,262 @@ class proxy
 
   int run();
 
+  // analysis methods don't update models, so their requests may be sent to
+  // another server as well (hedged) when the first one is slow, and their
+  // results may be cached; requests of update methods invalidate the cache
+  enum request_kind {
+    UPDATE = 0,
+    ANALYSIS = 1,
+    UNCACHED = 2  // doesn't update models, but needs fresh results
+  };
+
+  // called when a request is answered, with its packed result (NULL if it
+  // failed) and whether results of all servers are included
+  typedef jubatus::util::lang::function<void(const std::string*, bool)>
+      reply_hook;
+
   // async random method ( arity 0-4 )
   template<typename R>
-  void register_async_random(const std::string& method_name) {
+  void register_async_random(
+      const std::string& method_name,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string> packed_args_type;
-    register_async_vrandom_inner<R, packed_args_type>(method_name);
+    register_async_vrandom_inner<R, packed_args_type>(method_name, kind);
   }
 
   template<typename R, typename A0>
-  void register_async_random(const std::string& method_name) {
+  void register_async_random(
+      const std::string& method_name,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0> packed_args_type;
-    register_async_vrandom_inner<R, packed_args_type>(method_name);
+    register_async_vrandom_inner<R, packed_args_type>(method_name, kind);
   }
 
   template<typename R, typename A0, typename A1>
-  void register_async_random(const std::string& method_name) {
+  void register_async_random(
+      const std::string& method_name,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1>
       packed_args_type;
-    register_async_vrandom_inner<R, packed_args_type>(method_name);
+    register_async_vrandom_inner<R, packed_args_type>(method_name, kind);
   }
 
   template<typename R, typename A0, typename A1, typename A2>
-  void register_async_random(const std::string& method_name) {
+  void register_async_random(
+      const std::string& method_name,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1, A2>
       packed_args_type;
-    register_async_vrandom_inner<R, packed_args_type>(method_name);
+    register_async_vrandom_inner<R, packed_args_type>(method_name, kind);
   }
 
   template<typename R, typename A0, typename A1, typename A2, typename A3>
-  void register_async_random(const std::string& method_name) {
+  void register_async_random(
+      const std::string& method_name,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1, A2, A3>
       packed_args_type;
-    register_async_vrandom_inner<R, packed_args_type>(method_name);
+    register_async_vrandom_inner<R, packed_args_type>(method_name, kind);
   }
 
   // async broadcast method ( arity 0-4 )
   template<typename R>
   void register_async_broadcast(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string> packed_args_type;
-    register_async_vbroadcast_inner<R, packed_args_type>(method_name, agg);
+    register_async_vbroadcast_inner<R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<typename R, typename A0>
   void register_async_broadcast(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0> packed_args_type;
-    register_async_vbroadcast_inner<R, packed_args_type>(method_name, agg);
+    register_async_vbroadcast_inner<R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<typename R, typename A0, typename A1>
   void register_async_broadcast(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1> packed_args_type;
-    register_async_vbroadcast_inner<R, packed_args_type>(method_name, agg);
+    register_async_vbroadcast_inner<R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<typename R, typename A0, typename A1, typename A2>
   void register_async_broadcast(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1, A2>
       packed_args_type;
-    register_async_vbroadcast_inner<R, packed_args_type>(method_name, agg);
+    register_async_vbroadcast_inner<R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<typename R, typename A0, typename A1, typename A2, typename A3>
   void register_async_broadcast(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, A0, A1, A2, A3>
       packed_args_type;
-    register_async_vbroadcast_inner<R, packed_args_type>(method_name, agg);
+    register_async_vbroadcast_inner<R, packed_args_type>(
+        method_name, agg, kind);
+  }
+
+  // async split method ( arity 1, the argument must be a std::vector )
+  template<typename R, typename A0>
+  void register_async_split(
+      const std::string& method_name,
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
+    using mp::placeholders::_1;
+    using mp::placeholders::_2;
+    typedef typename msgpack::type::tuple<std::string, A0> packed_args_type;
+    typedef typename common::mprpc::async_vmethod<packed_args_type>::type
+      vfunc_type;
+
+    vfunc_type f = mp::bind(
+        &proxy::template split_async_vproxy<R, A0>,
+        this, /* request */_1, method_name, /* packed_args */_2, agg, kind);
+    add_async_vmethod<packed_args_type>(method_name, f);
+  }
+
+  /*
+   * async top-k method ( arity 2, the last argument is the number of
+   * results to return )
+   * N is the number of cht replicas for the id (the first argument), or 0
+   * if the request is sent to a random server.  In a partitioned cluster,
+   * the request is sent to all servers instead, and their results are
+   * merged by agg; queries by id (A0 is std::string) are refused.
+   */
+  template<int N, typename R, typename A0, typename A1>
+  void register_async_top_k(
+      const std::string& method_name,
+      const jubatus::util::lang::function<void(R&, R&, size_t)>& agg,
+      request_kind kind = UPDATE) {
+    using mp::placeholders::_1;
+    using mp::placeholders::_2;
+    typedef typename msgpack::type::tuple<std::string, A0, A1>
+      packed_args_type;
+    typedef typename common::mprpc::async_vmethod<packed_args_type>::type
+      vfunc_type;
+
+    vfunc_type f = mp::bind(
+        &proxy::template top_k_async_vproxy<N, R, A0, A1>,
+        this, /* request */_1, method_name, /* packed_args */_2, agg, kind);
+    add_async_vmethod<packed_args_type>(method_name, f);
   }
 
   // async cht method ( arity 0-4 )
   template<int N, typename R>
   void register_async_cht(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, std::string>
       packed_args_type;
-    register_async_vcht_inner<N, R, packed_args_type>(method_name, agg);
+    register_async_vcht_inner<N, R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<int N, typename R, typename A0>
   void register_async_cht(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, std::string, A0>
       packed_args_type;
-    register_async_vcht_inner<N, R, packed_args_type>(method_name, agg);
+    register_async_vcht_inner<N, R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<int N, typename R, typename A0, typename A1>
   void register_async_cht(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, std::string, A0, A1>
       packed_args_type;
-    register_async_vcht_inner<N, R, packed_args_type>(method_name, agg);
+    register_async_vcht_inner<N, R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<int N, typename R, typename A0, typename A1, typename A2>
   void register_async_cht(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, std::string, A0, A1, A2>
       packed_args_type;
-    register_async_vcht_inner<N, R, packed_args_type>(method_name, agg);
+    register_async_vcht_inner<N, R, packed_args_type>(
+        method_name, agg, kind);
   }
 
   template<int N, typename R, typename A0, typename A1, typename A2,
            typename A3>
   void register_async_cht(
       const std::string& method_name,
-      jubatus::util::lang::function<R(R, R)> agg) {
+      const result_reducer<R>& agg,
+      request_kind kind = UPDATE) {
     typedef typename msgpack::type::tuple<std::string, std::string, A0, A1, A2,
         A3> packed_args_type;
-    register_async_vcht_inner<N, R, packed_args_type>(method_name, agg);
+    register_async_vcht_inner<N, R, packed_args_type>(
+        method_name, agg, kind);
   }
 
  private:
   template<typename R, typename Tuple>
-  void register_async_vrandom_inner(const std::string& method_name) {
+  void register_async_vrandom_inner(
+      const std::string& method_name,
+      request_kind kind) {
     using mp::placeholders::_1;
     using mp::placeholders::_2;
     typedef typename common::mprpc::async_vmethod<Tuple>::type vfunc_type;
 
     vfunc_type f = mp::bind(
         &proxy::template random_async_vproxy<R, Tuple>,
-        this, /* request */_1, method_name, /* packed_args */_2);
+        this, /* request */_1, method_name, /* packed_args */_2, kind);
     add_async_vmethod<Tuple>(method_name, f);
   }
 
   template<typename R, typename Tuple>
   void register_async_vbroadcast_inner(
       const std::string& method_name,
-      const jubatus::util::lang::function<R(R, R)>& agg) {
+      const result_reducer<R>& agg,
+      request_kind kind) {
     using mp::placeholders::_1;
     using mp::placeholders::_2;
     typedef typename common::mprpc::async_vmethod<Tuple>::type vfunc_type;
 
     vfunc_type f = mp::bind(
         &proxy::template broadcast_async_vproxy<R, Tuple>,
-        this, /* request */_1, method_name, /* packed_args */_2, agg);
+        this, /* request */_1, method_name, /* packed_args */_2, agg,
+        kind);
     add_async_vmethod<Tuple>(method_name, f);
   }
 
   template<int N, typename R, typename Tuple>
   void register_async_vcht_inner(
       const std::string& method_name,
-      const jubatus::util::lang::function<R(R, R)>& agg) {
+      const result_reducer<R>& agg,
+      request_kind kind) {
     using mp::placeholders::_1;
     using mp::placeholders::_2;
     typedef typename common::mprpc::async_vmethod<Tuple>::type vfunc_type;
 
     vfunc_type f = mp::bind(
         &proxy::template cht_async_vproxy<N, R, Tuple>,
-        this, /* request */_1, method_name, /* packed_args */_2, agg);
+        this, /* request */_1, method_name, /* packed_args */_2, agg,
+        kind);
     add_async_vmethod<Tuple>(method_name, f);
   }
 
@@ -230,19 +370,48 @@ class proxy
   void random_async_vproxy(
       request_type req,
       const std::string& method_name,
-      const Tuple& args) {
-    std::vector<std::pair<std::string, int> > list;
+      const Tuple& args,
+      request_kind kind) {
     std::string name = args.template get<0>();
 
     update_request_counter();
 
-    get_members_(name, list);
-    const std::pair<std::string, int>& c = list[rng_(list.size())];
+    jubatus::util::lang::shared_ptr<const member_list> list =
+        get_members_(name);
+
+    reply_hook on_reply;
+    if (!begin_request<R>(req, method_name, args, kind, on_reply)) {
+      return;
+    }
+
+    forward_random<R, Tuple>(req, method_name, args, *list, kind, on_reply);
+  }
+
+  template<typename R, typename Tuple>
+  void forward_random(
+      request_type req,
+      const std::string& method_name,
+      const Tuple& args,
+      const member_list& list,
+      request_kind kind,
+      const reply_hook& on_reply) {
+    const size_t index = choose_member_(list);
 
     update_forward_counter();
 
-    async_task_loop::template call_apply<R, Tuple>(
-        c.first, c.second, method_name, args, a_, a_.interconnect_timeout, req);
+    if (kind == ANALYSIS && hedge_.enabled() && list.size() > 1) {
+      // the backup server is chosen from the others at random
+      const size_t backup =
+          (index + 1 + rng_(list.size() - 1)) % list.size();
+      async_task_loop::template call_apply_hedged<R, Tuple>(
+          list[index], list[backup], method_name, args, a_,
+          a_.interconnect_timeout, req, &load_, &hedge_, on_reply);
+    } else {
+      async_task_loop::template call_apply<R, Tuple>(
+          list[index].first, list[index].second, method_name, args, a_,
+          a_.interconnect_timeout, req, &load_, result_reducer<R>(),
+          on_reply);
+    }
   }
 
   template<typename R, typename Tuple>
@@ -250,18 +419,80 @@ class proxy
       request_type req,
       const std::string& method_name,
       const Tuple& args,
-      jubatus::util::lang::function<R(R, R)>& agg) {
-    std::vector<std::pair<std::string, int> > list;
+      const result_reducer<R>& agg,
+      request_kind kind) {
     std::string name = args.template get<0>();
 
     update_request_counter();
 
-    get_members_(name, list);
+    jubatus::util::lang::shared_ptr<const member_list> list =
+        get_members_(name);
 
-    update_forward_counter(list.size());
+    reply_hook on_reply;
+    if (!begin_request<R>(req, method_name, args, kind, on_reply)) {
+      return;
+    }
+
+    update_forward_counter(list->size());
 
     async_task_loop::template call_apply<R, Tuple>(
-        list, method_name, args, a_, a_.interconnect_timeout, req, agg);
+        *list, method_name, args, a_, a_.interconnect_timeout, req, &load_,
+        agg, on_reply);
+  }
+
+  /*
+   * Splits the list into sub-batches of at least a_.split_size elements,
+   * and sends them to different servers in parallel.  Results are reduced
+   * in the order of the sub-batches, so concat keeps the order of the list.
+   */
+  template<typename R, typename List>
+  void split_async_vproxy(
+      request_type req,
+      const std::string& method_name,
+      const msgpack::type::tuple<std::string, List>& args,
+      const result_reducer<R>& agg,
+      request_kind kind) {
+    typedef msgpack::type::tuple<std::string, List> packed_args_type;
+    std::string name = args.template get<0>();
+    const List& data = args.template get<1>();
+
+    update_request_counter();
+
+    jubatus::util::lang::shared_ptr<const member_list> list =
+        get_members_(name);
+
+    reply_hook on_reply;
+    if (!begin_request<R>(req, method_name, args, kind, on_reply)) {
+      return;
+    }
+
+    const size_t parts = a_.split_size == 0 ? 1 :
+        std::min(list->size(),
+                 data.size() / static_cast<size_t>(a_.split_size));
+
+    if (parts <= 1) {
+      forward_random<R, packed_args_type>(
+          req, method_name, args, *list, kind, on_reply);
+      return;
+    }
+
+    host_list_type hosts;
+    std::vector<packed_args_type> sub_args;
+    hosts.reserve(parts);
+    sub_args.reserve(parts);
+    const size_t offset = rng_(list->size());
+    for (size_t i = 0; i < parts; ++i) {
+      hosts.push_back((*list)[(offset + i) % list->size()]);
+      sub_args.push_back(packed_args_type(name, List(
+          data.begin() + data.size() * i / parts,
+          data.begin() + data.size() * (i + 1) / parts)));
+    }
+
+    update_forward_counter(parts);
+
+    async_task_loop::template call_apply_each<R, packed_args_type>(
+        hosts, method_name, sub_args, a_, a_.interconnect_timeout, req,
+        &load_, agg, on_reply);
   }
 
   template<int N, typename R, typename Tuple>
@@ -269,7 +500,8 @@ class proxy
       request_type req,
       const std::string& method_name,
       const Tuple& args,
-      jubatus::util::lang::function<R(R, R)>& agg) {
+      const result_reducer<R>& agg,
+      request_kind kind) {
     std::vector<std::pair<std::string, int> > list;
     std::string name = args.template get<0>();
     std::string id = args.template get<1>();
@@ -278,10 +510,163 @@ class proxy
 
     get_members_from_cht_(name, id, list, N);
 
+    reply_hook on_reply;
+    if (!begin_request<R>(req, method_name, args, kind, on_reply)) {
+      return;
+    }
+
     update_forward_counter(list.size());
 
     async_task_loop::template call_apply<R, Tuple>(
-        list, method_name, args, a_, a_.interconnect_timeout, req, agg);
+        list, method_name, args, a_, a_.interconnect_timeout, req, &load_,
+        agg, on_reply);
+  }
+
+  /*
+   * Servers of a partitioned cluster hold disjoint parts of rows, so each
+   * of them returns its best rows and they are merged.  A query by id
+   * (A0 is the id) is refused: only the servers holding the row could
+   * answer it, and their rows would miss those of other partitions.
+   * Otherwise any server has all rows (by mix), and the request is
+   * forwarded as usual.
+   */
+  template<int N, typename R, typename A0, typename A1>
+  void top_k_async_vproxy(
+      request_type req,
+      const std::string& method_name,
+      const msgpack::type::tuple<std::string, A0, A1>& args,
+      const jubatus::util::lang::function<void(R&, R&, size_t)>& agg,
+      request_kind kind) {
+    typedef msgpack::type::tuple<std::string, A0, A1> packed_args_type;
+
+    if (!a_.partitioned) {
+      forward_unpartitioned<R, packed_args_type>(
+          req, method_name, args, kind, cht_replicas<N>());
+      return;
+    }
+
+    if (is_query_by_id(static_cast<const A0*>(NULL))) {
+      update_request_counter();
+      req.error(method_name + " is not supported by a partitioned cluster; "
+                "query by datum instead");
+      return;
+    }
+
+    const size_t k = static_cast<size_t>(args.template get<2>());
+    const result_reducer<R> reducer(
+        jubatus::util::lang::function<void(R&, R&)>(
+            jubatus::util::lang::bind(
+                agg, jubatus::util::lang::_1, jubatus::util::lang::_2, k)));
+    broadcast_async_vproxy<R, packed_args_type>(
+        req, method_name, args, reducer, kind);
+  }
+
+  static bool is_query_by_id(const std::string*) {
+    return true;
+  }
+
+  template<typename T>
+  static bool is_query_by_id(const T*) {
+    return false;
+  }
+
+  template<int N>
+  struct cht_replicas {
+  };
+
+  template<typename R, typename Tuple>
+  void forward_unpartitioned(
+      request_type req,
+      const std::string& method_name,
+      const Tuple& args,
+      request_kind kind,
+      cht_replicas<0>) {
+    random_async_vproxy<R, Tuple>(req, method_name, args, kind);
+  }
+
+  template<typename R, typename Tuple, int N>
+  void forward_unpartitioned(
+      request_type req,
+      const std::string& method_name,
+      const Tuple& args,
+      request_kind kind,
+      cht_replicas<N>) {
+    // the first response is used, as with the pass aggregator
+    cht_async_vproxy<N, R, Tuple>(
+        req, method_name, args, result_reducer<R>(), kind);
+  }
+
+  /*
+   * Called after members are looked up, which may throw, so that on_reply
+   * is always called for the request to be forwarded.
+   * Returns false if the request has been answered from the result cache,
+   * or waits for the identical request in flight.  Otherwise it must be
+   * forwarded, and on_reply is set to store the result in the cache.
+   * Update requests invalidate cached results of the cluster both when
+   * they are forwarded and answered, and uncached ones leave them as is.
+   */
+  template<typename R, typename Tuple>
+  bool begin_request(
+      request_type req,
+      const std::string& method_name,
+      const Tuple& args,
+      request_kind kind,
+      reply_hook& on_reply) {
+    if (!cache_.enabled()) {
+      return true;
+    }
+
+    const std::string& name = args.template get<0>();
+    if (kind == UNCACHED) {
+      return true;
+    }
+    if (kind == UPDATE) {
+      cache_.invalidate(name);
+      on_reply = jubatus::util::lang::bind(
+          &proxy::end_update, this, name, jubatus::util::lang::_1,
+          jubatus::util::lang::_2);
+      return true;
+    }
+
+    // the cluster name is in args
+    msgpack::sbuffer buf;
+    msgpack::pack(buf, args);
+    std::string key = method_name;
+    key.push_back('\0');
+    key.append(buf.data(), buf.size());
+
+    std::string packed;
+    const result_cache::waiter_type reply = jubatus::util::lang::bind(
+        &proxy::template reply_packed<R>, req, jubatus::util::lang::_1);
+    switch (cache_.lookup(name, key, packed, reply)) {
+      case result_cache::HIT:
+        reply(&packed);
+        return false;
+      case result_cache::WAIT:
+        return false;
+      case result_cache::MISS:
+        on_reply = jubatus::util::lang::bind(
+            &result_cache::complete, &cache_, key, jubatus::util::lang::_1,
+            jubatus::util::lang::_2);
+        return true;
+      default:
+        return true;
+    }
+  }
+
+  void end_update(const std::string& name, const std::string*, bool) {
+    cache_.invalidate(name);
+  }
+
+  template<typename R>
+  static void reply_packed(request_type req, const std::string* packed) {
+    if (!packed) {
+      req.error(std::string("identical request in flight failed"));
+      return;
+    }
+    msgpack::unpacked msg;
+    msgpack::unpack(&msg, packed->data(), packed->size());
+    req.result<R>(msg.get().as<R>());
   }
 
  public:
@@ -295,7 +680,7 @@ class proxy
   class async_task : public mp::enable_shared_from_this<async_task<Res> > {
    public:
     typedef jubatus::util::lang::shared_ptr<Res> result_ptr;
-    typedef jubatus::util::lang::function<Res(Res, Res)> reducer_type;
+    typedef result_reducer<Res> reducer_type;
 
    public:
     async_task(
@@ -303,19 +688,33 @@ class proxy
         const host_list_type& hosts,
         const std::string& method_name,
         request_type req,
-        reducer_type reducer = reducer_type())
+        backend_load* load,
+        const reducer_type& reducer = reducer_type(),
+        const reply_hook& on_reply = reply_hook())
         : at_loop_(at_loop),
           hosts_(hosts),
           method_name_(method_name),
           req_(req),
+          load_(load),
           reducer_(reducer),
+          on_reply_(on_reply),
+          require_all_(false),
+          hedge_(NULL),
           running_count_(0),
           cancelled_(false),
-          timer_id_(-1) {
+          timer_id_(-1),
+          hedge_timer_id_(-1),
+          results_(hosts.size()),
+          next_to_reduce_(0) {
     }
 
     virtual ~async_task() {
       cancel_timeout();
+      cancel_hedge();
+      for (size_t i = 0; i < in_flight_.size(); ++i) {
+        end_load(i, true);
+      }
+      notify_reply(NULL, false);
     }
 
     /*
@@ -326,30 +725,57 @@ class proxy
 
       mp::pthread_scoped_lock _l(lock_);
 
+      bool failed = false;
+      bool refused = false;
       if (!cancelled_) {
         try {
           done_one_inner(f, future_index);
+        } catch (const jcm::rpc_call_error&) {
+          // the server is alive, but the method threw an exception
+          failed = true;
+          refused = true;
+          add_error(future_index);
         } catch (...) {
           // continue process next result when exception thrown.
           // store exception_thrower to list of errors
 
-          errors_.push_back(
-              jcm::rpc_error(hosts_[future_index].first,
-                             hosts_[future_index].second,
-                             core::common::exception::get_current_exception()));
+          failed = true;
+          add_error(future_index);
         }
       }
+      end_load(future_index, failed, refused);
 
       futures_[future_index] = msgpack::rpc::future();
 
       --running_count_;
-      if (!cancelled_ && running_count_ <= 0) {
+      if (cancelled_) {
+        return;
+      }
+      if (hedge_ && failed && send_backup_) {
+        // the first server failed before the backup was sent
+        send_backup();
+        return;
+      }
+      if (hedge_ && !failed) {
+        // the first successful response of a hedged request is used
+        finish_hedged(future_index);
+      } else if (running_count_ <= 0) {
+        // no more response is needed, even if a backup request is pending
+        cancelled_ = true;
         cancel_timeout();
-        req_.result<Res>(aggregate_results());
+        cancel_hedge();
+        if (require_all_ && !errors_.empty()) {
+          // partial results of a split request are meaningless
+          req_.error(jubatus::server::common::mprpc::to_string(
+              jubatus::server::common::mprpc::error_multi_rpc(errors_)));
+          notify_reply(NULL, false);
+        } else {
+          reply_aggregated();
+        }
       }
     }
 
-    Res aggregate_results() {
+    void reply_aggregated() {
       if (errors_.size() != 0) {
         LOG(WARNING) << "error occurred in " << errors_.size()
                      << " out of " << futures_.size() << " requests";
@@ -357,19 +783,13 @@ class proxy
             jubatus::server::common::mprpc::error_multi_rpc(errors_));
       }
 
-      if (results_.size() == 0) {
-        return Res();  // TODO(kmaehashi): we should raise exception ?
-      }
-
-      if (!reducer_ || results_.size() == 1) {
-        return *(results_[0]);
+      if (acc_) {
+        req_.result<Res>(*acc_);
+      } else {
+        // TODO(kmaehashi): we should raise exception ?
+        req_.result<Res>(Res());
       }
-
-      Res tmp_result = *(results_[0]);
-      for (size_t i = 1; i < results_.size(); ++i) {
-        tmp_result = reducer_(tmp_result, *(results_[i]));
-      }
-      return tmp_result;
+      notify_reply(acc_.get(), errors_.empty());
     }
 
     void set_timeout(int timeout_sec) {
@@ -390,6 +810,34 @@ class proxy
       }
     }
 
+    void cancel_hedge() {
+      if (hedge_timer_id_ >= 0) {
+        msgpack::rpc::loop loop = at_loop_->pool().get_loop();
+        loop->remove_timer(hedge_timer_id_);
+        hedge_timer_id_ = -1;
+      }
+      send_backup_ = jubatus::util::lang::function<void()>();
+    }
+
+    bool on_hedge() {
+      mp::pthread_scoped_lock _l(lock_);
+      hedge_timer_id_ = -1;
+      if (!cancelled_ && send_backup_ && hedge_->try_acquire()) {
+        send_backup();
+      }
+      send_backup_ = jubatus::util::lang::function<void()>();
+      return true;
+    }
+
+    // called with lock_ held
+    void send_backup() {
+      jubatus::util::lang::function<void()> send;
+      send.swap(send_backup_);
+      cancel_hedge();
+      ++running_count_;
+      send();
+    }
+
     bool on_timeout() {
       mp::pthread_scoped_lock _l(lock_);
       if (!cancelled_) {
@@ -398,6 +846,7 @@ class proxy
           if (!futures_[i].is_finished()) {
             // cancel the request
             futures_[i].cancel();
+            end_load(i, true);
 
             // cancelled sessions (e.g., connections) cannot be reused,
             // so remove them from the session pool.
@@ -406,6 +855,7 @@ class proxy
         }
 
         req_.error(msgpack::rpc::TIMEOUT_ERROR);
+        notify_reply(NULL, false);
       }
       return true;
     }
@@ -417,27 +867,57 @@ class proxy
         int timeout_sec) {
       mp::pthread_scoped_lock _l(lock_);
 
-      running_count_ = hosts_.size();
-      // enable proxy::async_task timeout management
-      if (timeout_sec > 0) {
-        set_timeout(timeout_sec);
+      start(timeout_sec);
+      for (size_t i = 0; i < hosts_.size(); ++i) {
+        send(i, method_name, args);
       }
+    }
+
+    /*
+     * Sends args[i] to hosts_[i]; the request fails unless all of them
+     * succeed.
+     */
+    template<typename Args>
+    void call_apply_each(
+        const std::string& method_name,
+        const std::vector<Args>& args,
+        int timeout_sec) {
+      mp::pthread_scoped_lock _l(lock_);
 
-      msgpack::rpc::session_pool& pool = at_loop_->pool();
+      require_all_ = true;
+      start(timeout_sec);
       for (size_t i = 0; i < hosts_.size(); ++i) {
-        msgpack::rpc::session s = pool.get_session(hosts_[i].first,
-                                                   hosts_[i].second);
-        // disable msgpack::rpc::session's timeout.
-        // because session timeout is managed by proxy::async_task
-        s.set_timeout(0);
-
-        // apply async method call and set its callback
-        msgpack::rpc::future f = s.call_apply(method_name, args);
-        futures_.push_back(f);
-        sessions_.push_back(s);
-        f.attach_callback(
-            mp::bind(&async_task<Res>::done_one, this->shared_from_this(),
-                     mp::placeholders::_1, i));
+        send(i, method_name, args[i]);
+      }
+    }
+
+    /*
+     * Sends args to hosts_[0], and also to hosts_[1] if no response arrives
+     * within the delay given by hedge, or as soon as hosts_[0] fails.  The
+     * first successful response is used, and the other request is
+     * cancelled.
+     */
+    template<typename Args>
+    void call_apply_hedged(
+        const std::string& method_name,
+        const Args& args,
+        int timeout_sec,
+        hedge_policy* hedge) {
+      mp::pthread_scoped_lock _l(lock_);
+
+      hedge_ = hedge;
+      start(timeout_sec);
+      running_count_ = 1;
+      send(0, method_name, args);
+
+      send_backup_ = jubatus::util::lang::bind(
+          &async_task<Res>::template send<Args>, this, 1, method_name, args);
+      const double delay = hedge_->on_request();
+      if (delay > 0) {
+        msgpack::rpc::loop loop = at_loop_->pool().get_loop();
+        hedge_timer_id_ = loop->add_timer(
+            delay, 0,
+            mp::bind(&async_task<Res>::on_hedge, this->shared_from_this()));
       }
     }
 
@@ -447,27 +927,159 @@ class proxy
     host_list_type hosts_;
     std::string method_name_;
     request_type req_;
+    backend_load* load_;
     reducer_type reducer_;
+    reply_hook on_reply_;
+    bool require_all_;
+    hedge_policy* hedge_;
+    jubatus::util::lang::function<void()> send_backup_;
 
     int running_count_;
-    bool cancelled_;
+    bool cancelled_;  // no more response is needed
     int timer_id_;
+    int hedge_timer_id_;
 
     std::vector<msgpack::rpc::future> futures_;
     std::vector<msgpack::rpc::session> sessions_;
+    std::vector<jubatus::util::system::time::clock_time> sent_at_;
+    // results reduced so far, and those waiting for preceding ones
+    result_ptr acc_;
     std::vector<result_ptr> results_;
+    size_t next_to_reduce_;
     std::vector<jubatus::server::common::mprpc::rpc_error> errors_;
+    // requests not answered, failed nor cancelled yet
+    std::vector<bool> in_flight_;
 
     mp::pthread_recursive_mutex lock_;
 
+    void start(int timeout_sec) {
+      running_count_ = hosts_.size();
+      // enable proxy::async_task timeout management
+      if (timeout_sec > 0) {
+        set_timeout(timeout_sec);
+      }
+    }
+
+    template<typename Args>
+    void send(size_t i, const std::string& method_name, const Args& args) {
+      msgpack::rpc::session s = at_loop_->pool().get_session(
+          hosts_[i].first, hosts_[i].second);
+      // disable msgpack::rpc::session's timeout.
+      // because session timeout is managed by proxy::async_task
+      s.set_timeout(0);
+
+      // apply async method call and set its callback
+      msgpack::rpc::future f = s.call_apply(method_name, args);
+      futures_.push_back(f);
+      sessions_.push_back(s);
+      sent_at_.push_back(jubatus::util::system::time::get_clock_time());
+      in_flight_.push_back(true);
+      if (load_) {
+        load_->begin(hosts_[i]);
+      }
+      f.attach_callback(
+          mp::bind(&async_task<Res>::done_one, this->shared_from_this(),
+                   mp::placeholders::_1, i));
+    }
+
+    void end_load(size_t index, bool failed, bool refused = false) {
+      if (!in_flight_[index]) {
+        return;
+      }
+      in_flight_[index] = false;
+      if (load_) {
+        load_->end(hosts_[index], elapsed(index), failed, refused);
+      }
+    }
+
+    void add_error(size_t index) {
+      namespace jcm = jubatus::server::common::mprpc;
+      errors_.push_back(
+          jcm::rpc_error(hosts_[index].first, hosts_[index].second,
+                         core::common::exception::get_current_exception()));
+    }
+
+    double elapsed(size_t index) const {
+      return jubatus::util::system::time::get_clock_time() - sent_at_[index];
+    }
+
+    void finish_hedged(size_t index) {
+      cancelled_ = true;
+      cancel_timeout();
+      cancel_hedge();
+      hedge_->on_response(elapsed(index), index != 0);
+
+      for (size_t i = 0; i < futures_.size(); ++i) {
+        if (in_flight_[i]) {
+          // only the future is cancelled; the session may be multiplexed
+          // with other requests (--io_threads) and is kept in the pool
+          futures_[i].cancel();
+          in_flight_[i] = false;
+          if (load_) {
+            load_->cancel(hosts_[i]);
+          }
+        }
+      }
+
+      // only the successful response has been added
+      req_.result<Res>(*acc_);
+      notify_reply(acc_.get(), true);
+    }
+
+    // on_reply_ is called once, even if the task is destroyed without reply
+    void notify_reply(const Res* result, bool complete) {
+      if (!on_reply_) {
+        return;
+      }
+      reply_hook on_reply;
+      on_reply.swap(on_reply_);
+      if (!result) {
+        on_reply(NULL, false);
+        return;
+      }
+      msgpack::sbuffer buf;
+      msgpack::pack(buf, *result);
+      const std::string packed(buf.data(), buf.size());
+      on_reply(&packed, complete);
+    }
+
     void done_one_inner(msgpack::rpc::future f, int future_index) {
       namespace jcm = jubatus::server::common::mprpc;
 
+      result_ptr r;
       try {
-        result_ptr result(new Res(f.get<Res>()));
-        results_.push_back(result);
+        r.reset(new Res(f.get<Res>()));
       }
       JUBATUS_MSGPACKRPC_EXCEPTION_DEFAULT_HANDLER(method_name_);
+      add_result(future_index, r);
+    }
+
+    /*
+     * Each result is reduced into acc_ when it arrives, so that results
+     * of all servers are not kept until the last one.  Results of a split
+     * request must be reduced in the order of hosts_ (i.e., sub-batches),
+     * so those arriving early wait for the preceding ones.  Failed ones
+     * are skipped.
+     */
+    void add_result(size_t index, const result_ptr& r) {
+      if (!require_all_) {
+        reduce(r);
+        return;
+      }
+      results_[index] = r;
+      while (next_to_reduce_ < results_.size() && results_[next_to_reduce_]) {
+        reduce(results_[next_to_reduce_]);
+        results_[next_to_reduce_].reset();
+        ++next_to_reduce_;
+      }
+    }
+
+    void reduce(const result_ptr& r) {
+      if (!acc_) {
+        acc_ = r;
+      } else if (!reducer_.empty()) {
+        reducer_(*acc_, *r);
+      }
     }
   };  // class async_task
 
@@ -494,10 +1106,14 @@ class proxy
      * is in the thread local storage).
      * If async_task_loop is not yet created for this thread, starts a new
      * one and returns it.
+     * If a.io_threads is positive, all threads share one async_task_loop;
+     * requests to the same server are multiplexed on one session (i.e.,
+     * connection) with different msgids.
      */
     static async_task_loop* get_private_async_task_loop(const proxy_argv& a) {
       if (!private_async_task_loop_) {
-        private_async_task_loop_ = startup(a);
+        private_async_task_loop_ =
+            a.io_threads > 0 ? get_shared_async_task_loop(a) : startup(a);
       }
 
       return private_async_task_loop_;
@@ -514,14 +1130,65 @@ class proxy
         const proxy_argv& a,
         int timeout_sec,
         request_type req,
-        typename async_task<Res>::reducer_type reducer =
-        typename async_task<Res>::reducer_type()) {
+        backend_load* load,
+        const typename async_task<Res>::reducer_type& reducer =
+        typename async_task<Res>::reducer_type(),
+        const reply_hook& on_reply = reply_hook()) {
       async_task_loop* at_loop = get_private_async_task_loop(a);
       mp::shared_ptr<async_task<Res> > task(
-          new async_task<Res>(at_loop, hosts, method_name, req, reducer));
+          new async_task<Res>(at_loop, hosts, method_name, req, load,
+                              reducer, on_reply));
       task->template call_apply<Args>(method_name, args, timeout_sec);
     }
 
+    /*
+     * call_apply_each (args[i] for hosts[i])
+     */
+    template<typename Res, typename Args>
+    static void call_apply_each(
+        const host_list_type& hosts,
+        const std::string& method_name,
+        const std::vector<Args>& args,
+        const proxy_argv& a,
+        int timeout_sec,
+        request_type req,
+        backend_load* load,
+        const typename async_task<Res>::reducer_type& reducer,
+        const reply_hook& on_reply = reply_hook()) {
+      async_task_loop* at_loop = get_private_async_task_loop(a);
+      mp::shared_ptr<async_task<Res> > task(
+          new async_task<Res>(at_loop, hosts, method_name, req, load,
+                              reducer, on_reply));
+      task->template call_apply_each<Args>(method_name, args, timeout_sec);
+    }
+
+    /*
+     * call_apply_hedged (backup is used when host is slow)
+     */
+    template<typename Res, typename Args>
+    static void call_apply_hedged(
+        const std::pair<std::string, int>& host,
+        const std::pair<std::string, int>& backup,
+        const std::string& method_name,
+        const Args& args,
+        const proxy_argv& a,
+        int timeout_sec,
+        request_type req,
+        backend_load* load,
+        hedge_policy* hedge,
+        const reply_hook& on_reply = reply_hook()) {
+      host_list_type hosts;
+      hosts.push_back(host);
+      hosts.push_back(backup);
+      async_task_loop* at_loop = get_private_async_task_loop(a);
+      mp::shared_ptr<async_task<Res> > task(
+          new async_task<Res>(at_loop, hosts, method_name, req, load,
+                              typename async_task<Res>::reducer_type(),
+                              on_reply));
+      task->template call_apply_hedged<Args>(
+          method_name, args, timeout_sec, hedge);
+    }
+
     /*
      * call_apply (for single server)
      */
@@ -534,15 +1201,25 @@ class proxy
         const proxy_argv& a,
         int timeout_sec,
         request_type req,
-        typename async_task<Res>::reducer_type reducer =
-        typename async_task<Res>::reducer_type()) {
+        backend_load* load,
+        const typename async_task<Res>::reducer_type& reducer =
+        typename async_task<Res>::reducer_type(),
+        const reply_hook& on_reply = reply_hook()) {
       host_list_type hosts;
       hosts.push_back(std::make_pair(host, port));
       call_apply<Res, Args>(hosts, method_name, args, a, timeout_sec, req,
-                            reducer);
+                            load, reducer, on_reply);
     }
 
    private:
+    static async_task_loop* get_shared_async_task_loop(const proxy_argv& a) {
+      jubatus::util::concurrent::scoped_lock lk(shared_async_task_loop_mutex_);
+      if (!shared_async_task_loop_) {
+        shared_async_task_loop_ = startup(a);
+      }
+      return shared_async_task_loop_;
+    }
+
     static async_task_loop* startup(const proxy_argv& a) {
       async_task_loop* at_loop = new async_task_loop(a);
 
@@ -551,7 +1228,7 @@ class proxy
           jubatus::util::lang::bind(&async_task_loop::run, at_loop));
       thr.start();
 #else
-      at_loop->pool().start(2);
+      at_loop->pool().start(std::max(a.io_threads, 2));
       // Use mpio's event loop instead of async_task_loop's one.
       // Note: mpio's event loop start() requires thread_num > 1. ( mpio bug? )
 #endif
@@ -563,6 +1240,8 @@ class proxy
     msgpack::rpc::session_pool pool_;
 
     static __thread async_task_loop* private_async_task_loop_;
+    static async_task_loop* shared_async_task_loop_;
+    static jubatus::util::concurrent::mutex shared_async_task_loop_mutex_;
   };  // class async_task_loop
 };  // class proxy
 
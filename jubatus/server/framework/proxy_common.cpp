@@ -23,12 +23,15 @@
 #include <utility>
 #include <vector>
 
+#include "jubatus/util/lang/bind.h"
 #include "jubatus/core/common/exception.hpp"
 #include "server_util.hpp"
+#include "../common/cached_zk.hpp"
 #include "../common/logger/logger.hpp"
 #include "../common/membership.hpp"
 #include "../common/signals.hpp"
 
+using jubatus::util::lang::shared_ptr;
 using jubatus::util::system::time::clock_time;
 using jubatus::util::system::time::get_clock_time;
 
@@ -50,13 +53,22 @@ std::string make_logfile_name(const proxy_argv& a) {
   return logfile.str();
 }
 
+// weight of the latest response in the latency average of each server
+const double LATENCY_DECAY = 0.3;
+
 }  // namespace
 
 proxy_common::proxy_common(const proxy_argv& a)
     : a_(a),
+      start_time_(get_clock_time()),
+      load_(LATENCY_DECAY, a.interconnect_timeout, a.eject_failures,
+            a.eject_latency_ratio, a.eject_time),
+      hedge_(a.hedge_budget / 100.0, a.hedge_percentile),
+      // a hedged request may wait for the backup up to the timeout
+      cache_(static_cast<size_t>(a.cache_size) << 20, a.cache_ttl,
+             2.0 * a.interconnect_timeout),
       request_counter_(0),
-      forward_counter_(0),
-      start_time_(get_clock_time()) {
+      forward_counter_(0) {
   common::prepare_signal_handling();
 
   zk_.reset(common::create_lock_service(
@@ -73,32 +85,122 @@ proxy_common::~proxy_common() {
   close_lock_service();
 }
 
-void proxy_common::get_members_(
-    const std::string& name, std::vector<std::pair<std::string, int> >& ret) {
-  ret.clear();
-  std::vector<std::string> list;
+shared_ptr<const proxy_common::member_list> proxy_common::get_members_(
+    const std::string& name) {
+  shared_ptr<const member_list> members;
+  {
+    jubatus::util::concurrent::scoped_rlock lk(members_mutex_);
+    std::map<std::string, members_entry>::const_iterator it =
+        members_.find(name);
+    if (it != members_.end() && it->second.watching) {
+      members = it->second.list;
+    }
+  }
+  if (!members) {
+    members = reload_members_(name, false);
+  }
+
+  if (members->empty()) {
+    throw JUBATUS_EXCEPTION(no_worker(name));
+  }
+  return members;
+}
+
+shared_ptr<const proxy_common::member_list> proxy_common::reload_members_(
+    const std::string& name,
+    bool force) {
+  jubatus::util::concurrent::scoped_lock update_lk(members_update_mutex_);
+  bool watching = false;
+  {
+    jubatus::util::concurrent::scoped_rlock lk(members_mutex_);
+    std::map<std::string, members_entry>::const_iterator it =
+        members_.find(name);
+    if (it != members_.end()) {
+      if (!force && it->second.watching) {
+        // reloaded by another thread
+        return it->second.list;
+      }
+      watching = it->second.watching;
+    }
+  }
+
   std::string path;
   common::build_actor_path(path, a_.type, name);
   path += "/actives";
 
-  {
-    jubatus::util::concurrent::scoped_lock lk(mutex_);
-    zk_->list(path, list);
+  // set the watcher before listing, not to miss changes in between
+  bool bound = false;
+  if (!watching) {
+    bound = zk_->bind_child_watcher(path, jubatus::util::lang::bind(
+        &proxy_common::members_watcher_, this, name,
+        jubatus::util::lang::_1, jubatus::util::lang::_2,
+        jubatus::util::lang::_3));
   }
-  std::vector<std::string>::const_iterator it;
-
-  if (list.empty()) {
-    throw JUBATUS_EXCEPTION(no_worker(name));
+  if (force) {
+    // the list cache may be reloaded after this watcher is called
+    if (common::cached_zk* czk =
+        dynamic_cast<common::cached_zk*>(zk_.get())) {
+      czk->reload_cache(path);
+    }
   }
 
+  std::vector<std::string> list;
+  zk_->list(path, list);
+
   // TODO(y-oda-oni-juba):
   // do you return all server list? it can be very large
-  for (it = list.begin(); it != list.end(); ++it) {
+  shared_ptr<member_list> members(new member_list);
+  members->reserve(list.size());
+  for (std::vector<std::string>::const_iterator it = list.begin();
+       it != list.end(); ++it) {
     std::string ip;
     int port;
     common::revert(*it, ip, port);
-    ret.push_back(make_pair(ip, port));
+    members->push_back(make_pair(ip, port));
   }
+
+  jubatus::util::concurrent::scoped_wlock lk(members_mutex_);
+  members_entry& e = members_[name];
+  e.list = members;
+  if (bound) {
+    e.watching = true;
+  }
+  return members;
+}
+
+void proxy_common::members_watcher_(
+    const std::string& name,
+    int type,
+    int state,
+    const std::string& path) {
+  DLOG(INFO) << "members watcher got event (" << type << "): " << path;
+  {
+    jubatus::util::concurrent::scoped_wlock lk(members_mutex_);
+    members_[name].watching = false;
+  }
+  reload_members_(name, true);
+}
+
+size_t proxy_common::choose_member_(const member_list& list) {
+  if (load_.ejection_enabled()) {
+    std::vector<size_t> admitted;
+    load_.admit(list, rng_, admitted);
+    if (admitted.size() < list.size()) {
+      member_list candidates(admitted.size());
+      for (size_t i = 0; i < admitted.size(); ++i) {
+        candidates[i] = list[admitted[i]];
+      }
+      return admitted[choose_member_from_(candidates)];
+    }
+  }
+  return choose_member_from_(list);
+}
+
+size_t proxy_common::choose_member_from_(const member_list& list) {
+  if (a_.balancer == "p2c") {
+    return load_.choose(list, rng_);
+  }
+  return rng_(list.size());
 }
 
 void proxy_common::get_members_from_cht_(
@@ -107,9 +209,24 @@ void proxy_common::get_members_from_cht_(
     std::vector<std::pair<std::string, int> >& ret,
     size_t n) {
   ret.clear();
-  jubatus::util::concurrent::scoped_lock lk(mutex_);
-  jubatus::server::common::cht ht(zk_, a_.type, name);
-  ht.find(id, ret, n);
+  shared_ptr<common::cached_cht> ht;
+  {
+    jubatus::util::concurrent::scoped_rlock lk(members_mutex_);
+    std::map<std::string, shared_ptr<common::cached_cht> >::const_iterator it =
+        chts_.find(name);
+    if (it != chts_.end()) {
+      ht = it->second;
+    }
+  }
+  if (!ht) {
+    jubatus::util::concurrent::scoped_wlock lk(members_mutex_);
+    shared_ptr<common::cached_cht>& c = chts_[name];
+    if (!c) {
+      c.reset(new common::cached_cht(zk_, a_.type, name));
+    }
+    ht = c;
+  }
+  ht->find(id, ret, n);
 
   if (ret.empty()) {
     throw JUBATUS_EXCEPTION(no_worker(name));
@@ -117,13 +234,30 @@ void proxy_common::get_members_from_cht_(
 }
 
 void proxy_common::update_request_counter() {
-  jubatus::util::concurrent::scoped_lock lk(mutex_);
+#ifdef ATOMIC_I8_SUPPORT
+  __sync_fetch_and_add(&request_counter_, 1);
+#else
+  jubatus::util::concurrent::scoped_lock lk(counter_mutex_);
   ++request_counter_;
+#endif
 }
 
 void proxy_common::update_forward_counter(const uint64_t count) {
-  jubatus::util::concurrent::scoped_lock lk(mutex_);
+#ifdef ATOMIC_I8_SUPPORT
+  __sync_fetch_and_add(&forward_counter_, count);
+#else
+  jubatus::util::concurrent::scoped_lock lk(counter_mutex_);
   forward_counter_ += count;
+#endif
+}
+
+uint64_t proxy_common::get_counter_(uint64_t& counter) {
+#ifdef ATOMIC_I8_SUPPORT
+  return __sync_fetch_and_add(&counter, 0);
+#else
+  jubatus::util::concurrent::scoped_lock lk(counter_mutex_);
+  return counter;
+#endif
 }
 
 proxy_common::status_type proxy_common::get_status() {
@@ -175,11 +309,30 @@ proxy_common::status_type proxy_common::get_status() {
       jubatus::util::lang::lexical_cast<std::string>(a_.session_pool_expire);
   data["session_pool_size"] =
       jubatus::util::lang::lexical_cast<std::string>(a_.session_pool_size);
-
-  data["request_count"] =
-      jubatus::util::lang::lexical_cast<std::string>(request_counter_);
-  data["forward_count"] =
-      jubatus::util::lang::lexical_cast<std::string>(forward_counter_);
+  data["balancer"] = a_.balancer;
+  data["split_size"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.split_size);
+  data["io_threads"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.io_threads);
+  data["partitioned"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.partitioned);
+  data["eject_failures"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.eject_failures);
+  data["eject_latency_ratio"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.eject_latency_ratio);
+  data["eject_time"] =
+      jubatus::util::lang::lexical_cast<std::string>(a_.eject_time);
+
+  data["request_count"] = jubatus::util::lang::lexical_cast<std::string>(
+      get_counter_(request_counter_));
+  data["forward_count"] = jubatus::util::lang::lexical_cast<std::string>(
+      get_counter_(forward_counter_));
+
+  load_.get_status(data);
+  hedge_.get_status(data);
+  if (cache_.enabled()) {
+    cache_.get_status(data);
+  }
 
   return status;
 }
@@ -29,6 +29,9 @@
 #include "jubatus/util/system/time_util.h"
 
 #include "jubatus/core/common/exception.hpp"
+#include "backend_load.hpp"
+#include "hedge_policy.hpp"
+#include "result_cache.hpp"
 #include "server_util.hpp"
 #include "../common/lock_service.hpp"
 #include "../common/cht.hpp"
@@ -54,9 +57,15 @@ class proxy_common {
   virtual ~proxy_common();
 
  protected:
-  void get_members_(
-      const std::string& name,
-      std::vector<std::pair<std::string, int> >& ret);
+  typedef std::vector<std::pair<std::string, int> > member_list;
+
+  // snapshot of active servers; never empty
+  jubatus::util::lang::shared_ptr<const member_list> get_members_(
+      const std::string& name);
+
+  // index of the server in list to forward a request of @random method;
+  // servers ejected by load_ are skipped
+  size_t choose_member_(const member_list& list);
 
   void get_members_from_cht_(
       const std::string& name,
@@ -70,12 +79,48 @@ class proxy_common {
   void update_forward_counter(const uint64_t = 1);
 
   proxy_argv a_;
-  uint64_t request_counter_;
-  uint64_t forward_counter_;
   jubatus::util::system::time::clock_time start_time_;
   jubatus::util::math::random::mtrand rng_;
-  jubatus::util::concurrent::mutex mutex_;
   jubatus::util::lang::shared_ptr<common::lock_service> zk_;
+  backend_load load_;
+  hedge_policy hedge_;
+  result_cache cache_;
+
+ private:
+  struct members_entry {
+    members_entry()
+        : watching(false) {
+    }
+
+    jubatus::util::lang::shared_ptr<const member_list> list;
+    bool watching;
+  };
+
+  size_t choose_member_from_(const member_list& list);
+  jubatus::util::lang::shared_ptr<const member_list> reload_members_(
+      const std::string& name,
+      bool force);
+  void members_watcher_(
+      const std::string& name,
+      int type,
+      int state,
+      const std::string& path);
+
+  uint64_t get_counter_(uint64_t& counter);
+
+  uint64_t request_counter_;
+  uint64_t forward_counter_;
+#ifndef ATOMIC_I8_SUPPORT
+  jubatus::util::concurrent::mutex counter_mutex_;
+#endif
+
+  // readers only share the read lock to copy snapshots; ZooKeeper
+  // watchers replace them
+  jubatus::util::concurrent::rw_mutex members_mutex_;
+  jubatus::util::concurrent::mutex members_update_mutex_;
+  std::map<std::string, members_entry> members_;
+  std::map<std::string,
+      jubatus::util::lang::shared_ptr<common::cached_cht> > chts_;
 };
 
 }  // namespace framework
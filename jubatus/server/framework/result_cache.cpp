@@ -0,0 +1,197 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "result_cache.hpp"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/cast.h"
+
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::system::time::get_clock_time;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+// memory used by an entry (the key is also in the LRU list)
+size_t entry_size(const std::string& key, const std::string& packed) {
+  return key.size() * 2 + packed.size();
+}
+
+}  // namespace
+
+result_cache::result_cache(
+    size_t capacity_bytes,
+    double ttl_sec,
+    double in_flight_sec)
+    : capacity_(capacity_bytes),
+      ttl_sec_(ttl_sec),
+      in_flight_sec_(in_flight_sec),
+      bytes_(0),
+      hits_(0),
+      misses_(0),
+      coalesced_(0),
+      abandoned_(0) {
+}
+
+result_cache::lookup_result result_cache::lookup(
+    const std::string& name,
+    const std::string& key,
+    std::string& packed,
+    const waiter_type& waiter) {
+  std::vector<waiter_type> abandoned;
+  lookup_result result = lookup_locked(name, key, packed, waiter, abandoned);
+
+  // waiters reply to their requests, so they are called without the lock
+  for (size_t i = 0; i < abandoned.size(); ++i) {
+    abandoned[i](NULL);
+  }
+  return result;
+}
+
+// waiters of the request in flight are moved to abandoned if it is lost
+result_cache::lookup_result result_cache::lookup_locked(
+    const std::string& name,
+    const std::string& key,
+    std::string& packed,
+    const waiter_type& waiter,
+    std::vector<waiter_type>& abandoned) {
+  scoped_lock lk(m_);
+
+  std::map<std::string, entry>::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    const entry& e = it->second;
+    if (e.generation == generation(name) &&
+        (ttl_sec_ <= 0 || get_clock_time() - e.stored_at < ttl_sec_)) {
+      lru_.splice(lru_.begin(), lru_, e.lru);
+      packed = e.packed;
+      ++hits_;
+      return HIT;
+    }
+    erase(it);
+  }
+
+  std::map<std::string, in_flight>::iterator f = in_flight_.find(key);
+  if (f != in_flight_.end() && 0 < in_flight_sec_ &&
+      get_clock_time() - f->second.started_at > in_flight_sec_) {
+    // the reply of the request has been lost; this request takes it over
+    abandoned.swap(f->second.waiters);
+    in_flight_.erase(f);
+    f = in_flight_.end();
+    ++abandoned_;
+  }
+  if (f != in_flight_.end()) {
+    if (f->second.generation != generation(name)) {
+      // the request was forwarded before the model was updated
+      ++misses_;
+      return UNCACHED;
+    }
+    f->second.waiters.push_back(waiter);
+    ++coalesced_;
+    return WAIT;
+  }
+
+  in_flight& leader = in_flight_[key];
+  leader.name = name;
+  leader.generation = generation(name);
+  leader.started_at = get_clock_time();
+  ++misses_;
+  return MISS;
+}
+
+void result_cache::complete(
+    const std::string& key,
+    const std::string* packed,
+    bool cacheable) {
+  std::vector<waiter_type> waiters;
+  {
+    scoped_lock lk(m_);
+    std::map<std::string, in_flight>::iterator f = in_flight_.find(key);
+    if (f == in_flight_.end()) {
+      return;
+    }
+    waiters.swap(f->second.waiters);
+
+    const size_t size = packed ? entry_size(key, *packed) : 0;
+    if (packed && cacheable && size <= capacity_ &&
+        f->second.generation == generation(f->second.name)) {
+      std::map<std::string, entry>::iterator it = entries_.find(key);
+      if (it != entries_.end()) {
+        erase(it);
+      }
+      while (bytes_ + size > capacity_) {
+        erase(entries_.find(lru_.back()));
+      }
+
+      entry& e = entries_[key];
+      e.packed = *packed;
+      e.generation = f->second.generation;
+      e.stored_at = get_clock_time();
+      e.lru = lru_.insert(lru_.begin(), key);
+      bytes_ += size;
+    }
+    in_flight_.erase(f);
+  }
+
+  // waiters reply to their requests, so they are called without the lock
+  for (size_t i = 0; i < waiters.size(); ++i) {
+    waiters[i](packed);
+  }
+}
+
+void result_cache::invalidate(const std::string& name) {
+  scoped_lock lk(m_);
+  // entries of older generations are removed when they are looked up
+  ++generations_[name];
+}
+
+void result_cache::get_status(
+    std::map<std::string, std::string>& status) const {
+  scoped_lock lk(m_);
+  const uint64_t lookups = hits_ + misses_ + coalesced_;
+  status["cache.capacity"] = lexical_cast<std::string>(capacity_);
+  status["cache.ttl"] = lexical_cast<std::string>(ttl_sec_);
+  status["cache.entries"] = lexical_cast<std::string>(entries_.size());
+  status["cache.bytes"] = lexical_cast<std::string>(bytes_);
+  status["cache.hits"] = lexical_cast<std::string>(hits_);
+  status["cache.misses"] = lexical_cast<std::string>(misses_);
+  status["cache.coalesced"] = lexical_cast<std::string>(coalesced_);
+  status["cache.abandoned"] = lexical_cast<std::string>(abandoned_);
+  status["cache.hit_rate"] = lexical_cast<std::string>(
+      lookups == 0 ? 0.0 : static_cast<double>(hits_) / lookups);
+}
+
+uint64_t result_cache::generation(const std::string& name) const {
+  std::map<std::string, uint64_t>::const_iterator it = generations_.find(name);
+  return it == generations_.end() ? 0 : it->second;
+}
+
+void result_cache::erase(std::map<std::string, entry>::iterator it) {
+  bytes_ -= entry_size(it->first, it->second.packed);
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
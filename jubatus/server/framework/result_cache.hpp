@@ -0,0 +1,129 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_RESULT_CACHE_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_RESULT_CACHE_HPP_
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/function.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/util/system/time_util.h"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * LRU cache of packed results of analysis requests in a proxy.
+ *
+ * Results are keyed by the method and its packed arguments.  While a
+ * request is in flight, identical requests wait for its result instead of
+ * being forwarded (single-flight).  Results expire after ttl_sec, and all
+ * results of a cluster are invalidated when the proxy forwards an update
+ * request to it.  A request in flight for more than in_flight_sec is
+ * considered lost: its waiters fail and the next identical request is
+ * forwarded.
+ */
+class result_cache : jubatus::util::lang::noncopyable {
+ public:
+  // called with the packed result, or NULL if the request failed
+  typedef jubatus::util::lang::function<void(const std::string*)>
+      waiter_type;
+
+  enum lookup_result {
+    HIT,      // the result is returned
+    WAIT,     // the waiter is called when the request in flight finishes
+    MISS,     // the caller must forward the request and call complete()
+    UNCACHED  // the caller must forward the request (and not complete())
+  };
+
+  // capacity_bytes = 0 disables the cache; ttl_sec = 0 never expires;
+  // in_flight_sec = 0 waits for requests in flight forever
+  result_cache(size_t capacity_bytes, double ttl_sec, double in_flight_sec);
+
+  bool enabled() const {
+    return capacity_ > 0;
+  }
+
+  lookup_result lookup(
+      const std::string& name,
+      const std::string& key,
+      std::string& packed,
+      const waiter_type& waiter);
+
+  // packed is NULL if the request failed; it is not stored unless
+  // cacheable (e.g., results of some servers are missing)
+  void complete(
+      const std::string& key,
+      const std::string* packed,
+      bool cacheable);
+
+  void invalidate(const std::string& name);
+
+  void get_status(std::map<std::string, std::string>& status) const;
+
+ private:
+  struct entry {
+    std::string packed;
+    uint64_t generation;
+    jubatus::util::system::time::clock_time stored_at;
+    std::list<std::string>::iterator lru;
+  };
+
+  struct in_flight {
+    std::string name;
+    uint64_t generation;
+    jubatus::util::system::time::clock_time started_at;
+    std::vector<waiter_type> waiters;
+  };
+
+  lookup_result lookup_locked(
+      const std::string& name,
+      const std::string& key,
+      std::string& packed,
+      const waiter_type& waiter,
+      std::vector<waiter_type>& abandoned);
+  uint64_t generation(const std::string& name) const;
+  void erase(std::map<std::string, entry>::iterator it);
+
+  const size_t capacity_;
+  const double ttl_sec_;
+  const double in_flight_sec_;
+
+  mutable jubatus::util::concurrent::mutex m_;
+  std::map<std::string, entry> entries_;
+  std::list<std::string> lru_;  // the most recently used key first
+  std::map<std::string, in_flight> in_flight_;
+  // incremented by invalidate() for each cluster
+  std::map<std::string, uint64_t> generations_;
+  size_t bytes_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t coalesced_;
+  uint64_t abandoned_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_RESULT_CACHE_HPP_
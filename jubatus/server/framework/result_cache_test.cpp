@@ -0,0 +1,162 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/lang/bind.h"
+#include "result_cache.hpp"
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+void append_result(vector<string>* results, const string* packed) {
+  results->push_back(packed ? *packed : "(failed)");
+}
+
+result_cache::waiter_type waiter(vector<string>& results) {
+  return jubatus::util::lang::bind(
+      &append_result, &results, jubatus::util::lang::_1);
+}
+
+}  // namespace
+
+TEST(result_cache, hit) {
+  result_cache c(1024, 0, 0);
+  vector<string> results;
+  string packed;
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  const string value = "v";
+  c.complete("k", &value, true);
+
+  ASSERT_EQ(result_cache::HIT, c.lookup("n", "k", packed, waiter(results)));
+  EXPECT_EQ("v", packed);
+  EXPECT_TRUE(results.empty());
+}
+
+TEST(result_cache, coalesce) {
+  result_cache c(1024, 0, 0);
+  vector<string> results;
+  string packed;
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  ASSERT_EQ(result_cache::WAIT, c.lookup("n", "k", packed, waiter(results)));
+  ASSERT_EQ(result_cache::WAIT, c.lookup("n", "k", packed, waiter(results)));
+
+  c.complete("k", NULL, false);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ("(failed)", results[0]);
+
+  // failed results are not stored
+  EXPECT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+}
+
+TEST(result_cache, abandon_lost_request) {
+  result_cache c(1024, 0, 0.05);
+  vector<string> results;
+  string packed;
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  ASSERT_EQ(result_cache::WAIT, c.lookup("n", "k", packed, waiter(results)));
+
+  // the leader never completes
+  usleep(100000);
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ("(failed)", results[0]);
+  ASSERT_EQ(result_cache::WAIT, c.lookup("n", "k", packed, waiter(results)));
+
+  const string value = "v";
+  c.complete("k", &value, true);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ("v", results[1]);
+
+  map<string, string> status;
+  c.get_status(status);
+  EXPECT_EQ("1", status["cache.abandoned"]);
+}
+
+TEST(result_cache, invalidate) {
+  result_cache c(1024, 0, 0);
+  vector<string> results;
+  string packed;
+  const string value = "v";
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  c.complete("k", &value, true);
+
+  c.invalidate("other");
+  EXPECT_EQ(result_cache::HIT, c.lookup("n", "k", packed, waiter(results)));
+  c.invalidate("n");
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+
+  // the result of a request forwarded before the update is not stored
+  c.invalidate("n");
+  ASSERT_EQ(result_cache::UNCACHED,
+            c.lookup("n", "k", packed, waiter(results)));
+  c.complete("k", &value, true);
+  EXPECT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+}
+
+TEST(result_cache, ttl) {
+  result_cache c(1024, 0.05, 0);
+  vector<string> results;
+  string packed;
+  const string value = "v";
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+  c.complete("k", &value, true);
+  EXPECT_EQ(result_cache::HIT, c.lookup("n", "k", packed, waiter(results)));
+
+  usleep(100000);
+  EXPECT_EQ(result_cache::MISS, c.lookup("n", "k", packed, waiter(results)));
+}
+
+TEST(result_cache, lru) {
+  // each entry uses 2 * 2 (key) + 8 (result) bytes
+  result_cache c(24, 0, 0);
+  vector<string> results;
+  string packed;
+  const string value = "01234567";
+  const char* keys[] = {"k1", "k2", "k3"};
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_EQ(result_cache::MISS,
+              c.lookup("n", keys[i], packed, waiter(results)));
+    c.complete(keys[i], &value, true);
+  }
+  // k1 is used more recently than k2
+  ASSERT_EQ(result_cache::HIT, c.lookup("n", "k1", packed, waiter(results)));
+  ASSERT_EQ(result_cache::MISS, c.lookup("n", "k3", packed, waiter(results)));
+  c.complete("k3", &value, true);
+
+  EXPECT_EQ(result_cache::HIT, c.lookup("n", "k1", packed, waiter(results)));
+  EXPECT_EQ(result_cache::HIT, c.lookup("n", "k3", packed, waiter(results)));
+
+  map<string, string> status;
+  c.get_status(status);
+  EXPECT_EQ("2", status["cache.entries"]);
+  EXPECT_EQ("24", status["cache.bytes"]);
+  EXPECT_EQ(result_cache::MISS, c.lookup("n", "k2", packed, waiter(results)));
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
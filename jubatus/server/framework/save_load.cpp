@@ -20,6 +20,8 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/rwmutex.h"
 #include "jubatus/util/lang/cast.h"
 
 #include "jubatus/core/common/exception.hpp"
@@ -215,26 +217,19 @@ void load_server(std::istream& is,
         core::common::exception::runtime_error(
           "system data is broken"));
   }
-  system_data_container system_data_expected(server, id);
-  if (system_data_actual.version != system_data_expected.version) {
+  if (system_data_actual.version != system_data_container_version) {
     throw JUBATUS_EXCEPTION(
         core::common::exception::runtime_error(
           "invalid system data version: saved version: " +
           lexical_cast<string>(system_data_actual.version) +
           ", expected " +
-          lexical_cast<string>(system_data_expected.version)));
+          lexical_cast<string>(system_data_container_version)));
   }
-  if (system_data_actual.type != system_data_expected.type) {
+  if (system_data_actual.type != server.argv().type) {
     throw JUBATUS_EXCEPTION(
         core::common::exception::runtime_error(
           "server type mismatched: " + system_data_actual.type +
-          ", expected " + system_data_expected.type));
-  }
-  if (system_data_actual.config != system_data_expected.config) {
-    throw JUBATUS_EXCEPTION(
-        core::common::exception::runtime_error(
-          "server config mismatched: " + system_data_actual.config +
-          ", expected " + system_data_expected.config));
+          ", expected " + server.argv().type));
   }
 
   try {
@@ -260,7 +255,20 @@ void load_server(std::istream& is,
             lexical_cast<string>(user_data_version_expected)));
     }
 
+    // reading and verifying the file above do not touch the model, so
+    // RPCs are blocked only while the model is replaced; the config is
+    // compared under the lock, as set_config may change it meanwhile
+    jubatus::util::concurrent::scoped_wlock lk(server.rw_mutex());
+    const std::string config = server.get_config();
+    if (system_data_actual.config != config) {
+      throw JUBATUS_EXCEPTION(
+          core::common::exception::runtime_error(
+            "server config mismatched: " + system_data_actual.config +
+            ", expected " + config));
+    }
+    server.event_model_updated();
     server.get_driver()->unpack(objs[1]);
+    server.event_model_loaded();
   } catch (const msgpack::type_error&) {
     throw JUBATUS_EXCEPTION(
         core::common::exception::runtime_error(
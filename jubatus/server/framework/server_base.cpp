@@ -26,6 +26,7 @@
 
 #include "jubatus/core/common/exception.hpp"
 #include "jubatus/core/framework/mixable.hpp"
+#include "jubatus/util/concurrent/lock.h"
 #include "jubatus/util/system/syscall.h"
 #include "mixer/mixer.hpp"
 #include "save_load.hpp"
@@ -190,15 +191,37 @@ void server_base::event_model_updated() {
 }
 
 void server_base::update_saved_status(const std::string& path) {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
   last_saved_ = jubatus::util::system::time::get_clock_time();
   last_saved_path_ = path;
 }
 
 void server_base::update_loaded_status(const std::string& path) {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
   last_loaded_ = jubatus::util::system::time::get_clock_time();
   last_loaded_path_ = path;
 }
 
+uint64_t server_base::last_saved_sec() const {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
+  return last_saved_.sec;
+}
+
+std::string server_base::last_saved_path() const {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
+  return last_saved_path_;
+}
+
+uint64_t server_base::last_loaded_sec() const {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
+  return last_loaded_.sec;
+}
+
+std::string server_base::last_loaded_path() const {
+  jubatus::util::concurrent::scoped_lock lk(status_mutex_);
+  return last_loaded_path_;
+}
+
 }  // namespace framework
 }  // namespace server
 }  // namespace jubatus
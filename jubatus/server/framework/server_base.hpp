@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 #include "jubatus/util/system/time_util.h"
+#include "jubatus/util/concurrent/mutex.h"
 #include "jubatus/util/concurrent/rwmutex.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
@@ -38,6 +39,8 @@ namespace mixer {
 class mixer;
 }  // namespace mixer
 
+class cht_rebalancer;
+
 class server_base {
  public:
   typedef std::map<std::string, std::string> status_t;
@@ -48,6 +51,11 @@ class server_base {
   virtual mixer::mixer* get_mixer() const = 0;
 
   virtual core::driver::driver_base* get_driver() const = 0;
+
+  // servers which move rows on CHT membership changes return it
+  virtual cht_rebalancer* get_rebalancer() const {
+    return NULL;
+  }
   virtual void get_status(status_t& status) const = 0;
   virtual void set_config(const std::string& config) = 0;
 
@@ -57,6 +65,8 @@ class server_base {
 
   void load_file(const std::string& path);
   void event_model_updated();
+  // called after a model is loaded, with rw_mutex() still locked for write
+  virtual void event_model_loaded() {}
   void update_saved_status(const std::string& path);
   void update_loaded_status(const std::string& path);
 
@@ -75,21 +85,11 @@ class server_base {
     return argv_;
   }
 
-  uint64_t last_saved_sec() const {
-    return last_saved_.sec;
-  }
-
-  const std::string& last_saved_path() const {
-    return last_saved_path_;
-  }
-
-  uint64_t last_loaded_sec() const {
-    return last_loaded_.sec;
-  }
-
-  const std::string& last_loaded_path() const {
-    return last_loaded_path_;
-  }
+  // save and load run concurrently with get_status
+  uint64_t last_saved_sec() const;
+  std::string last_saved_path() const;
+  uint64_t last_loaded_sec() const;
+  std::string last_loaded_path() const;
 
  private:
   const server_argv argv_;
@@ -98,6 +98,7 @@ class server_base {
   std::string last_saved_path_;
   clock_time last_loaded_;
   std::string last_loaded_path_;
+  mutable jubatus::util::concurrent::mutex status_mutex_;
   jubatus::util::concurrent::rw_mutex rw_mutex_;
 };
 
@@ -98,7 +98,7 @@ void server_helper_impl::prepare_for_run(const server_argv& a, bool use_cht) {
     if (use_cht) {
       common::cht::setup_cht_dir(*zk_, a.type, a.name);
       common::cht ht(zk_, a.type, a.name);
-      ht.register_node(a.eth, a.port);
+      ht.register_node(a.eth, a.port, a.cht_weight);
     }
 
     register_actor(*zk_, a.type, a.name, a.eth, a.port);
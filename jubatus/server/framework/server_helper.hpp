@@ -30,8 +30,12 @@
 #include "jubatus/core/common/jsonconfig.hpp"
 #include "mixer/mixer.hpp"
 #include "server_util.hpp"
+#ifdef HAVE_ZOOKEEPER_H
+#include "cht_rebalancer.hpp"
+#endif
 #include "../../config.hpp"
 #include "../common/lock_service.hpp"
+#include "../common/mprpc/rpc_connection_pool.hpp"
 #include "../common/mprpc/rpc_server.hpp"
 #include "../common/signals.hpp"
 #include "../common/config.hpp"
@@ -207,9 +211,19 @@ class server_helper {
       data["connected_zookeeper"] = impl_.zk()->get_connected_host_and_port();
       data["use_cht"] = jubatus::util::lang::lexical_cast<std::string>(
           use_cht_);
+      if (use_cht_) {
+        data["cht_weight"] =
+            jubatus::util::lang::lexical_cast<std::string>(a.cht_weight);
+      }
 
       data["mixer"] = a.mixer;
       server_->get_mixer()->get_status(data);
+      common::mprpc::rpc_connection_pool::shared().get_status(data);
+#ifdef HAVE_ZOOKEEPER_H
+      if (cht_rebalancer* r = server_->get_rebalancer()) {
+        r->get_status(data);
+      }
+#endif
     }
 
     return status;
@@ -237,6 +251,11 @@ class server_helper {
       if (!a.is_standalone()) {
         // Start mixer and register active membership
         server_->get_mixer()->start();
+#ifdef HAVE_ZOOKEEPER_H
+        if (cht_rebalancer* r = server_->get_rebalancer()) {
+          r->start();
+        }
+#endif
       }
 
       // wait for termination
@@ -263,6 +282,11 @@ class server_helper {
     // server itself
     LOG(INFO) << "stopping mixer thread";
     if (!server_->argv().is_standalone()) {
+#ifdef HAVE_ZOOKEEPER_H
+      if (cht_rebalancer* r = server_->get_rebalancer()) {
+        r->stop();
+      }
+#endif
       server_->get_mixer()->stop();
       impl_.prepare_for_stop(server_->argv());
     }
@@ -160,6 +160,18 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
   p.add<std::string>("model_file", 'm',
                      "model data to load at startup", false, "");
   p.add("daemon", 'D', "launch in daemon mode (ignores SIGHUP)");
+  p.add<int>("coalesce_window", '\0',
+             "time to gather concurrent train requests into one update "
+             "(msec, 0 to disable)", false, 0, lower_bound_reader(0));
+  p.add<int>("coalesce_max_batch", '\0',
+             "maximum number of train requests gathered into one update",
+             false, 16, lower_bound_reader(1));
+  p.add<int>("batch_threads", '\0',
+             "worker threads to split large classify/estimate batches "
+             "(0 to disable)", false, 0, lower_bound_reader(0));
+  p.add<int>("batch_min_split", '\0',
+             "minimum number of data in a batch to split it",
+             false, 64, lower_bound_reader(1));
 
   p.add<std::string>("zookeeper", 'z',
                      make_ignored_help("zookeeper location"), false);
@@ -167,7 +179,9 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
                      make_ignored_help("learning machine instance name"),
                      false);
   p.add<std::string>("mixer", 'x',
-                     make_ignored_help("mixer strategy"), false,
+                     make_ignored_help(
+                         "mixer strategy (no_mixer to keep models of "
+                         "servers disjoint)"), false,
                      "linear_mixer");
   p.add<int>("interval_sec", 's',
              make_ignored_help("mix interval by seconds"), false, 16,
@@ -180,6 +194,39 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
   p.add<int>("interconnect_timeout", 'I',
              make_ignored_help("interconnect time out between servers (sec)"),
              false, 10);
+  p.add<int>("mixer_fanout", '\0',
+             make_ignored_help("fan-out of the mix tree (tree_mixer only)"),
+             false, 4, lower_bound_reader(1));
+  p.add<std::string>("mix_compression", '\0',
+             make_ignored_help(
+                 "compression of MIX payloads: none, lz4, zstd[:level]"),
+             false, "none");
+  p.add<std::string>("mix_quantization", '\0',
+             make_ignored_help(
+                 "lossy quantization of diffs: none, fp16, int8 "
+                 "(linear_mixer only)"),
+             false, "none");
+  p.add<double>("mix_sparsify_threshold", '\0',
+             make_ignored_help(
+                 "zero diff values smaller than this in magnitude "
+                 "(linear_mixer only)"),
+             false, 0.0);
+  p.add<int>("mix_sparsify_top_k", '\0',
+             make_ignored_help(
+                 "send only this many diff values of the largest magnitude; "
+                 "0 to send all (linear_mixer only)"),
+             false, 0, lower_bound_reader(0));
+  p.add<int>("cht_weight", '\0',
+             make_ignored_help(
+                 "share of keys of this server in the consistent hash ring "
+                 "relative to others (0: from CPU cores and memory)"),
+             false, 1, cmdline::range(0, common::MAX_CAPACITY_WEIGHT));
+  p.add<int>("rebalance_rate", '\0',
+             make_ignored_help(
+                 "rows per second to move to new owners when CHT members "
+                 "change (0: disabled; recommender only, with "
+                 "converters of types str/num/bin without filters)"),
+             false, 0, lower_bound_reader(0));
 
   // APPLY CHANGES TO JUBAVISOR WHEN ARGUMENTS MODIFIED
 
@@ -209,6 +256,10 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
   configpath = p.get<std::string>("configpath");
   modelpath = p.get<std::string>("model_file");
   daemon = p.exist("daemon");
+  coalesce_window = p.get<int>("coalesce_window");
+  coalesce_max_batch = p.get<int>("coalesce_max_batch");
+  batch_threads = p.get<int>("batch_threads");
+  batch_min_split = p.get<int>("batch_min_split");
 
   // determine listen-address and IPaddr used as ZK 'node-name'
   // TODO(y-oda-oni-juba): check bind_address is valid format
@@ -237,11 +288,28 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
   interval_count = p.get<int>("interval_count");
   zookeeper_timeout = p.get<int>("zookeeper_timeout");
   interconnect_timeout = p.get<int>("interconnect_timeout");
+  mixer_fanout = p.get<int>("mixer_fanout");
+  mix_compression = p.get<std::string>("mix_compression");
+  mix_quantization = p.get<std::string>("mix_quantization");
+  mix_sparsify_threshold = p.get<double>("mix_sparsify_threshold");
+  mix_sparsify_top_k = p.get<int>("mix_sparsify_top_k");
+  cht_weight = p.get<int>("cht_weight");
+  if (cht_weight == 0) {
+    cht_weight = common::get_capacity_weight();
+  }
+  rebalance_rate = p.get<int>("rebalance_rate");
 #else
   z = "";
   name = "";
   interval_sec = 16;
   interval_count = 512;
+  mixer_fanout = 4;
+  mix_compression = "none";
+  mix_quantization = "none";
+  mix_sparsify_threshold = 0;
+  mix_sparsify_top_k = 0;
+  cht_weight = 1;
+  rebalance_rate = 0;
 #endif
 
   if (!is_standalone() && name.empty()) {
@@ -304,6 +372,13 @@ server_argv::server_argv(int args, char** argv, const std::string& type)
   check_ignored_option(p, "interval_count");
   check_ignored_option(p, "zookeeper_timeout");
   check_ignored_option(p, "interconnect_timeout");
+  check_ignored_option(p, "mixer_fanout");
+  check_ignored_option(p, "mix_compression");
+  check_ignored_option(p, "mix_quantization");
+  check_ignored_option(p, "mix_sparsify_threshold");
+  check_ignored_option(p, "mix_sparsify_top_k");
+  check_ignored_option(p, "cht_weight");
+  check_ignored_option(p, "rebalance_rate");
 #endif
 
   boot_message(common::get_program_name());
@@ -322,7 +397,18 @@ server_argv::server_argv()
       log_config(""),
       eth("localhost"),
       interval_sec(5),
-      interval_count(1024) {
+      interval_count(1024),
+      mixer_fanout(4),
+      mix_compression("none"),
+      mix_quantization("none"),
+      mix_sparsify_threshold(0),
+      mix_sparsify_top_k(0),
+      coalesce_window(0),
+      coalesce_max_batch(16),
+      batch_threads(0),
+      batch_min_split(64),
+      cht_weight(1),
+      rebalance_rate(0) {
 }
 
 void server_argv::boot_message(const std::string& progname) const {
@@ -342,6 +428,18 @@ void server_argv::boot_message(const std::string& progname) const {
   ss << "    datadir              : " << datadir << '\n';
   ss << "    logdir               : " << logdir << '\n';
   ss << "    log config           : " << log_config << '\n';
+  if (0 < coalesce_window) {
+    ss << "    coalesce window      : " << coalesce_window << '\n';
+    ss << "    coalesce max batch   : " << coalesce_max_batch << '\n';
+  } else {
+    ss << "    coalesce window      : disabled" << '\n';
+  }
+  if (0 < batch_threads) {
+    ss << "    batch threads        : " << batch_threads << '\n';
+    ss << "    batch min split      : " << batch_min_split << '\n';
+  } else {
+    ss << "    batch threads        : disabled" << '\n';
+  }
 #ifdef HAVE_ZOOKEEPER_H
   ss << "    zookeeper            : " << z << '\n';
   ss << "    name                 : " << name << '\n';
@@ -357,6 +455,21 @@ void server_argv::boot_message(const std::string& progname) const {
   }
   ss << "    zookeeper timeout    : " << zookeeper_timeout << '\n';
   ss << "    interconnect timeout : " << interconnect_timeout << '\n';
+  if (mixer == "tree_mixer") {
+    ss << "    mixer fanout         : " << mixer_fanout << '\n';
+  }
+  ss << "    mix compression      : " << mix_compression << '\n';
+  if (mixer == "linear_mixer") {
+    ss << "    mix quantization     : " << mix_quantization << '\n';
+    ss << "    mix sparsify thresh. : " << mix_sparsify_threshold << '\n';
+    ss << "    mix sparsify top k   : " << mix_sparsify_top_k << '\n';
+  }
+  ss << "    cht weight           : " << cht_weight << '\n';
+  if (0 < rebalance_rate) {
+    ss << "    rebalance rate       : " << rebalance_rate << '\n';
+  } else {
+    ss << "    rebalance rate       : disabled" << '\n';
+  }
 #endif
   LOG(INFO) << ss.str();
 }
@@ -402,6 +515,49 @@ proxy_argv::proxy_argv(int args, char** argv, const std::string& t)
              lower_bound_reader(0));
   p.add<int>("pool_size", 'S', "session-pool maximum size", false, 0,
              lower_bound_reader(0));
+  p.add<std::string>("balancer", '\0',
+                     "how to choose a server for random methods "
+                     "(random or p2c: less loaded of two random servers)",
+                     false, "random", cmdline::oneof<std::string>(
+                         "random", "p2c"));
+  p.add<int>("split_size", '\0',
+             "minimum number of data in each part when a large batch is "
+             "split among servers (0 to disable)",
+             false, 0, lower_bound_reader(0));
+  p.add<int>("io_threads", '\0',
+             "threads of the event loop shared by RPC threads to send "
+             "requests to servers (0: each RPC thread has its own loop)",
+             false, 0, lower_bound_reader(0));
+  p.add<int>("hedge_budget", '\0',
+             "maximum percentage of analysis requests also sent to another "
+             "server when the first one is slow (0 to disable)",
+             false, 0, cmdline::range(0, 100));
+  p.add<int>("hedge_percentile", '\0',
+             "percentile of latency to wait before sending the backup "
+             "request", false, 95, cmdline::range(1, 99));
+  p.add("partitioned", '\0',
+        "servers hold disjoint parts of rows (started with --mixer "
+        "no_mixer), so top-k queries by datum are sent to all of them; "
+        "top-k queries by id are refused, and other random methods (e.g. "
+        "get_all_rows) see the rows of one server only");
+  p.add<int>("eject_failures", '\0',
+             "consecutive failures (including timeouts) of a server to "
+             "stop choosing it for random methods (0 to disable)",
+             false, 0, lower_bound_reader(0));
+  p.add<int>("eject_latency_ratio", '\0',
+             "how many times the latency of a server is longer than the "
+             "median of the cluster to stop choosing it for random methods "
+             "(0 to disable)", false, 0, lower_bound_reader(0));
+  p.add<int>("eject_time", '\0',
+             "time (sec) to stop choosing an unhealthy server, doubled "
+             "while it is ejected again; then it is re-admitted gradually "
+             "over the same time", false, 30, lower_bound_reader(1));
+  p.add<int>("cache_size", '\0',
+             "maximum size (MB) of cached results of analysis methods "
+             "(0 to disable)", false, 0, lower_bound_reader(0));
+  p.add<int>("cache_ttl", '\0',
+             "time (sec) to keep cached results (0: until the model is "
+             "updated through this proxy)", false, 10, lower_bound_reader(0));
   p.add<std::string>("logdir", 'l',
                      "directory to output ZooKeeper logs (instead of stderr)",
                      false, "");
@@ -428,6 +584,17 @@ proxy_argv::proxy_argv(int args, char** argv, const std::string& t)
   z = p.get<std::string>("zookeeper");
   session_pool_expire = p.get<int>("pool_expire");
   session_pool_size = p.get<int>("pool_size");
+  balancer = p.get<std::string>("balancer");
+  split_size = p.get<int>("split_size");
+  io_threads = p.get<int>("io_threads");
+  hedge_budget = p.get<int>("hedge_budget");
+  hedge_percentile = p.get<int>("hedge_percentile");
+  partitioned = p.exist("partitioned");
+  eject_failures = p.get<int>("eject_failures");
+  eject_latency_ratio = p.get<int>("eject_latency_ratio");
+  eject_time = p.get<int>("eject_time");
+  cache_size = p.get<int>("cache_size");
+  cache_ttl = p.get<int>("cache_ttl");
   logdir = p.get<std::string>("logdir");
   log_config = p.get<std::string>("log_config");
 
@@ -480,7 +647,18 @@ proxy_argv::proxy_argv()
       z("localhost:2181"),
       logdir(""),
       log_config(""),
-      eth("") {
+      eth(""),
+      balancer("random"),
+      split_size(0),
+      io_threads(0),
+      hedge_budget(0),
+      hedge_percentile(95),
+      partitioned(false),
+      eject_failures(0),
+      eject_latency_ratio(0),
+      eject_time(30),
+      cache_size(0),
+      cache_ttl(10) {
 }
 
 void proxy_argv::boot_message(const std::string& progname) const {
@@ -496,6 +674,29 @@ void proxy_argv::boot_message(const std::string& progname) const {
   ss << "    logdir               : " << logdir << '\n';
   ss << "    log config           : " << log_config << '\n';
   ss << "    zookeeper            : " << z << '\n';
+  ss << "    balancer             : " << balancer << '\n';
+  if (0 < split_size) {
+    ss << "    split size           : " << split_size << '\n';
+  }
+  if (0 < io_threads) {
+    ss << "    io threads           : " << io_threads << '\n';
+  }
+  if (0 < hedge_budget) {
+    ss << "    hedge budget         : " << hedge_budget << "% at p"
+       << hedge_percentile << '\n';
+  }
+  if (partitioned) {
+    ss << "    partitioned          : true\n";
+  }
+  if (0 < eject_failures || 0 < eject_latency_ratio) {
+    ss << "    eject                : " << eject_failures
+       << " failures or latency ratio " << eject_latency_ratio << ", "
+       << eject_time << " sec\n";
+  }
+  if (0 < cache_size) {
+    ss << "    cache                : " << cache_size << " MB, ttl "
+       << cache_ttl << " sec\n";
+  }
   LOG(INFO) << ss.str();
 }
 
@@ -87,11 +87,26 @@ struct server_argv {
   int interval_count;
   std::string mixer;
   bool daemon;
+  int mixer_fanout;
+  std::string mix_compression;
+  std::string mix_quantization;
+  double mix_sparsify_threshold;
+  int mix_sparsify_top_k;
+  int coalesce_window;
+  int coalesce_max_batch;
+  int batch_threads;
+  int batch_min_split;
+  int cht_weight;
+  int rebalance_rate;
 
   MSGPACK_DEFINE(port, bind_address, bind_if, timeout,
       zookeeper_timeout, interconnect_timeout, threadnum,
       program_name, type, z, name, datadir, logdir, log_config, eth,
-      interval_sec, interval_count, mixer, daemon);
+      interval_sec, interval_count, mixer, daemon, mixer_fanout,
+      mix_compression, mix_quantization, mix_sparsify_threshold,
+      mix_sparsify_top_k,
+      coalesce_window, coalesce_max_batch, batch_threads, batch_min_split,
+      cht_weight, rebalance_rate);
 
   bool is_standalone() const {
     return (z == "");
@@ -123,6 +138,17 @@ struct proxy_argv {
   int session_pool_expire;
   int session_pool_size;
   bool daemon;
+  std::string balancer;
+  int split_size;
+  int io_threads;
+  int hedge_budget;
+  int hedge_percentile;
+  bool partitioned;
+  int eject_failures;
+  int eject_latency_ratio;
+  int eject_time;
+  int cache_size;
+  int cache_ttl;
 
   void boot_message(const std::string& progname) const;
   void set_log_destination(const std::string& progname) const;
@@ -0,0 +1,226 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_UPDATE_COALESCER_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_UPDATE_COALESCER_HPP_
+
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/rwmutex.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/util/lang/function.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/util/system/time_util.h"
+#include "jubatus/core/common/exception.hpp"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * Group commit of concurrent update RPCs.
+ *
+ * The first request to arrive becomes the leader: it waits until the window
+ * elapses or max_batch requests are pending, then applies all of them under
+ * a single acquisition of the model write lock.  The other RPC threads just
+ * wait until their own request is applied, so each RPC still returns its own
+ * result (or throws its own exception) after its data has been trained.
+ *
+ * A window of zero disables coalescing; each request then takes the write
+ * lock by itself as JWLOCK_ does.
+ */
+template <typename Request, typename Result>
+class update_coalescer : jubatus::util::lang::noncopyable {
+ public:
+  typedef jubatus::util::lang::function<Result(const Request&)> apply_func;
+  typedef jubatus::util::lang::function<void()> notify_func;
+
+  // apply is called for each request, preceded by updated, with the write
+  // lock of mutex held
+  update_coalescer(
+      jubatus::util::concurrent::rw_mutex& mutex,
+      const apply_func& apply,
+      const notify_func& updated,
+      double window_sec,
+      size_t max_batch)
+      : mutex_(mutex),
+        apply_(apply),
+        updated_(updated),
+        window_sec_(window_sec),
+        max_batch_(std::max(max_batch, static_cast<size_t>(1))),
+        leader_active_(false),
+        batches_(0),
+        requests_(0),
+        max_batch_size_(0),
+        wait_sec_(0) {
+  }
+
+  bool enabled() const {
+    return window_sec_ > 0 && max_batch_ > 1;
+  }
+
+  Result submit(const Request& request) {
+    if (!enabled()) {
+      jubatus::util::concurrent::scoped_wlock lk(mutex_);
+      updated_();
+      return apply_(request);
+    }
+
+    pending p(request);
+    std::vector<pending*> batch;
+    {
+      jubatus::util::concurrent::scoped_lock lk(m_);
+      queue_.push_back(&p);
+      if (leader_active_) {
+        if (queue_.size() >= max_batch_) {
+          arrived_.notify_all();
+        }
+        while (!p.done) {
+          done_.wait(m_);
+        }
+      } else {
+        leader_active_ = true;
+        const double deadline =
+            to_sec(jubatus::util::system::time::get_clock_time())
+            + window_sec_;
+        while (queue_.size() < max_batch_) {
+          const double rest = deadline
+              - to_sec(jubatus::util::system::time::get_clock_time());
+          if (rest <= 0) {
+            break;
+          }
+          arrived_.wait(m_, rest);
+        }
+        batch.swap(queue_);
+        // requests arriving from now on elect a new leader, which gathers
+        // the next batch while this one holds the write lock
+        leader_active_ = false;
+      }
+    }
+
+    if (!batch.empty()) {
+      commit(batch);
+
+      jubatus::util::concurrent::scoped_lock lk(m_);
+      for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i]->done = true;
+      }
+      done_.notify_all();
+    }
+
+    if (p.error) {
+      p.error->throw_exception();
+    }
+    return p.result;
+  }
+
+  void get_status(
+      std::map<std::string, std::string>& status,
+      const std::string& prefix) const {
+    using jubatus::util::lang::lexical_cast;
+    jubatus::util::concurrent::scoped_lock lk(stats_m_);
+    status[prefix + ".coalesce_window"] = lexical_cast<std::string>(
+        window_sec_);
+    status[prefix + ".coalesce_max_batch"] = lexical_cast<std::string>(
+        max_batch_);
+    status[prefix + ".coalesce_batches"] = lexical_cast<std::string>(
+        batches_);
+    status[prefix + ".coalesce_max_batch_size"] = lexical_cast<std::string>(
+        max_batch_size_);
+    status[prefix + ".coalesce_avg_batch_size"] = lexical_cast<std::string>(
+        batches_ == 0 ? 0.0 : static_cast<double>(requests_) / batches_);
+    status[prefix + ".coalesce_avg_wait_time"] = lexical_cast<std::string>(
+        requests_ == 0 ? 0.0 : wait_sec_ / requests_);
+  }
+
+ private:
+  struct pending {
+    explicit pending(const Request& r)
+        : request(r),
+          result(),
+          arrival(jubatus::util::system::time::get_clock_time()),
+          done(false) {
+    }
+
+    const Request& request;
+    Result result;
+    jubatus::util::system::time::clock_time arrival;
+    jubatus::core::common::exception::exception_thrower_ptr error;
+    bool done;
+  };
+
+  static double to_sec(const jubatus::util::system::time::clock_time& t) {
+    return t.sec + t.usec / 1e6;
+  }
+
+  void commit(const std::vector<pending*>& batch) {
+    const jubatus::util::system::time::clock_time start =
+        jubatus::util::system::time::get_clock_time();
+    {
+      jubatus::util::concurrent::scoped_wlock lk(mutex_);
+      for (size_t i = 0; i < batch.size(); ++i) {
+        updated_();
+        try {
+          batch[i]->result = apply_(batch[i]->request);
+        } catch (...) {
+          batch[i]->error =
+              jubatus::core::common::exception::get_current_exception();
+        }
+      }
+    }
+
+    double wait_sec = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      wait_sec += start - batch[i]->arrival;
+    }
+    jubatus::util::concurrent::scoped_lock lk(stats_m_);
+    ++batches_;
+    requests_ += batch.size();
+    max_batch_size_ = std::max(max_batch_size_,
+                               static_cast<uint64_t>(batch.size()));
+    wait_sec_ += wait_sec;
+  }
+
+  jubatus::util::concurrent::rw_mutex& mutex_;
+  const apply_func apply_;
+  const notify_func updated_;
+  const double window_sec_;
+  const size_t max_batch_;
+
+  jubatus::util::concurrent::mutex m_;
+  jubatus::util::concurrent::condition arrived_;
+  jubatus::util::concurrent::condition done_;
+  std::vector<pending*> queue_;
+  bool leader_active_;
+
+  mutable jubatus::util::concurrent::mutex stats_m_;
+  uint64_t batches_;
+  uint64_t requests_;
+  uint64_t max_batch_size_;
+  double wait_sec_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_UPDATE_COALESCER_HPP_
@@ -0,0 +1,135 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <map>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/rwmutex.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/util/lang/cast.h"
+#include "jubatus/util/lang/shared_ptr.h"
+#include "jubatus/core/common/exception.hpp"
+#include "update_coalescer.hpp"
+
+using std::map;
+using std::string;
+using std::vector;
+using jubatus::util::concurrent::rw_mutex;
+using jubatus::util::concurrent::thread;
+using jubatus::util::lang::bind;
+using jubatus::util::lang::lexical_cast;
+using jubatus::util::lang::shared_ptr;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+class model {
+ public:
+  model()
+      : updated_(0),
+        applied_(0) {
+  }
+
+  // negative requests fail
+  int apply(const int& n) {
+    ++applied_;
+    if (n < 0) {
+      throw JUBATUS_EXCEPTION(core::common::invalid_parameter("negative"));
+    }
+    return n * 2;
+  }
+
+  void updated() {
+    ++updated_;
+  }
+
+  rw_mutex mutex_;
+  int updated_;
+  int applied_;
+};
+
+typedef update_coalescer<int, int> coalescer_t;
+
+void submit(coalescer_t* c, int n, int* result, bool* failed) {
+  try {
+    *result = c->submit(n);
+  } catch (const core::common::exception::jubatus_exception&) {
+    *failed = true;
+  }
+}
+
+}  // namespace
+
+TEST(update_coalescer, disabled) {
+  model m;
+  coalescer_t c(m.mutex_, bind(&model::apply, &m, jubatus::util::lang::_1),
+                bind(&model::updated, &m), 0, 16);
+  EXPECT_FALSE(c.enabled());
+  EXPECT_EQ(6, c.submit(3));
+  EXPECT_EQ(1, m.updated_);
+  EXPECT_EQ(1, m.applied_);
+}
+
+TEST(update_coalescer, concurrent_requests) {
+  const int N = 8;
+  model m;
+  coalescer_t c(m.mutex_, bind(&model::apply, &m, jubatus::util::lang::_1),
+                bind(&model::updated, &m), 0.2, N);
+  ASSERT_TRUE(c.enabled());
+
+  vector<int> results(N);
+  bool failed[N] = {};
+  vector<shared_ptr<thread> > threads;
+  for (int i = 0; i < N; ++i) {
+    // request 3 fails, but only for its own caller
+    const int n = i == 3 ? -1 : i;
+    threads.push_back(shared_ptr<thread>(new thread(
+        bind(&submit, &c, n, &results[i], &failed[i]))));
+    threads.back()->start();
+  }
+  for (int i = 0; i < N; ++i) {
+    threads[i]->join();
+  }
+
+  for (int i = 0; i < N; ++i) {
+    if (i == 3) {
+      EXPECT_TRUE(failed[i]);
+    } else {
+      EXPECT_FALSE(failed[i]);
+      EXPECT_EQ(i * 2, results[i]);
+    }
+  }
+  EXPECT_EQ(N, m.updated_);
+  EXPECT_EQ(N, m.applied_);
+
+  map<string, string> status;
+  c.get_status(status, "train");
+  const int batches = lexical_cast<int>(status["train.coalesce_batches"]);
+  EXPECT_LE(1, batches);
+  EXPECT_GT(N, batches);
+  EXPECT_GE(N, lexical_cast<int>(status["train.coalesce_max_batch_size"]));
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
@@ -0,0 +1,139 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <vector>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/core/common/exception.hpp"
+
+using jubatus::util::concurrent::scoped_lock;
+using jubatus::util::concurrent::thread;
+using jubatus::util::lang::shared_ptr;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+struct worker_pool::task {
+  const range_func* f;
+  size_t begin;
+  size_t end;
+  size_t* remaining;
+  core::common::exception::exception_thrower_ptr error;
+};
+
+worker_pool::worker_pool(size_t threads)
+    : stopping_(false) {
+  for (size_t i = 0; i < threads; ++i) {
+    shared_ptr<thread> t(new thread(
+        jubatus::util::lang::bind(&worker_pool::worker_loop, this)));
+    t->start();
+    threads_.push_back(t);
+  }
+}
+
+worker_pool::~worker_pool() {
+  {
+    scoped_lock lk(m_);
+    stopping_ = true;
+    queued_.notify_all();
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+void worker_pool::parallel_for(
+    size_t n,
+    size_t min_split,
+    const range_func& f) {
+  const size_t parts = std::min(threads_.size() + 1, n);
+  if (parts <= 1 || n < min_split) {
+    f(0, n);
+    return;
+  }
+
+  // part 0 is for the calling thread
+  std::vector<task> tasks(parts);
+  size_t remaining = parts - 1;
+  for (size_t i = 0; i < parts; ++i) {
+    tasks[i].f = &f;
+    tasks[i].begin = n * i / parts;
+    tasks[i].end = n * (i + 1) / parts;
+    tasks[i].remaining = &remaining;
+  }
+  {
+    scoped_lock lk(m_);
+    for (size_t i = 1; i < parts; ++i) {
+      queue_.push_back(&tasks[i]);
+    }
+    queued_.notify_all();
+  }
+
+  run(tasks[0]);
+
+  {
+    scoped_lock lk(m_);
+    while (remaining > 0) {
+      finished_.wait(m_);
+    }
+  }
+
+  for (size_t i = 0; i < parts; ++i) {
+    if (tasks[i].error) {
+      tasks[i].error->throw_exception();
+    }
+  }
+}
+
+void worker_pool::run(task& t) {
+  try {
+    (*t.f)(t.begin, t.end);
+  } catch (...) {
+    t.error = core::common::exception::get_current_exception();
+  }
+}
+
+void worker_pool::worker_loop() {
+  while (true) {
+    task* t;
+    {
+      scoped_lock lk(m_);
+      while (queue_.empty() && !stopping_) {
+        queued_.wait(m_);
+      }
+      if (queue_.empty()) {
+        return;
+      }
+      t = queue_.front();
+      queue_.pop_front();
+    }
+
+    run(*t);
+
+    scoped_lock lk(m_);
+    if (--*t->remaining == 0) {
+      finished_.notify_all();
+    }
+  }
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
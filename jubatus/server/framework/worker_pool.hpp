@@ -0,0 +1,77 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef JUBATUS_SERVER_FRAMEWORK_WORKER_POOL_HPP_
+#define JUBATUS_SERVER_FRAMEWORK_WORKER_POOL_HPP_
+
+#include <deque>
+#include <vector>
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/lang/function.h"
+#include "jubatus/util/lang/noncopyable.h"
+#include "jubatus/util/lang/shared_ptr.h"
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+/**
+ * Fixed set of threads to process one large batch request in parallel.
+ *
+ * parallel_for() splits the index range of a batch into contiguous parts,
+ * runs them on the workers and on the calling thread, and returns when all
+ * of them are done.  Locks held by the caller (e.g. the model read lock)
+ * are kept during the whole call, so every part sees the same model.
+ */
+class worker_pool : jubatus::util::lang::noncopyable {
+ public:
+  typedef jubatus::util::lang::function<void(size_t, size_t)> range_func;
+
+  // no thread is started when threads is 0, and parallel_for() just calls
+  // the function in the caller
+  explicit worker_pool(size_t threads);
+  ~worker_pool();
+
+  size_t size() const {
+    return threads_.size();
+  }
+
+  // calls f(begin, end) for parts of [0, n); the range is split only if n
+  // is at least min_split.  The first exception thrown by f is rethrown.
+  void parallel_for(size_t n, size_t min_split, const range_func& f);
+
+ private:
+  struct task;
+
+  void worker_loop();
+  static void run(task& t);
+
+  jubatus::util::concurrent::mutex m_;
+  jubatus::util::concurrent::condition queued_;
+  jubatus::util::concurrent::condition finished_;
+  std::deque<task*> queue_;
+  bool stopping_;
+  std::vector<jubatus::util::lang::shared_ptr<
+      jubatus::util::concurrent::thread> > threads_;
+};
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
+
+#endif  // JUBATUS_SERVER_FRAMEWORK_WORKER_POOL_HPP_
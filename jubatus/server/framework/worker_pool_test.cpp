@@ -0,0 +1,118 @@
+// Jubatus: Online machine learning framework for distributed environment
+// Copyright (C) 2014 Preferred Infrastructure and Nippon Telegraph and Telephone Corporation.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License version 2.1 as published by the Free Software Foundation.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/lang/bind.h"
+#include "jubatus/core/common/exception.hpp"
+#include "worker_pool.hpp"
+
+using std::vector;
+using jubatus::util::lang::bind;
+using jubatus::util::lang::_1;
+using jubatus::util::lang::_2;
+
+namespace jubatus {
+namespace server {
+namespace framework {
+
+namespace {
+
+class recorder {
+ public:
+  explicit recorder(size_t n)
+      : square(n, -1),
+        calls(0) {
+  }
+
+  void run(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      square[i] = static_cast<int>(i * i);
+    }
+    jubatus::util::concurrent::scoped_lock lk(m_);
+    ++calls;
+  }
+
+  void fail(size_t begin, size_t end) {
+    if (begin == 0) {
+      throw JUBATUS_EXCEPTION(core::common::invalid_parameter("first part"));
+    }
+    run(begin, end);
+  }
+
+  vector<int> square;
+  int calls;
+
+ private:
+  jubatus::util::concurrent::mutex m_;
+};
+
+void expect_squares(const recorder& r) {
+  for (size_t i = 0; i < r.square.size(); ++i) {
+    EXPECT_EQ(static_cast<int>(i * i), r.square[i]) << i;
+  }
+}
+
+}  // namespace
+
+TEST(worker_pool, no_thread) {
+  worker_pool pool(0);
+  recorder r(100);
+  pool.parallel_for(100, 1, bind(&recorder::run, &r, _1, _2));
+  expect_squares(r);
+  EXPECT_EQ(1, r.calls);
+}
+
+TEST(worker_pool, split) {
+  worker_pool pool(3);
+  EXPECT_EQ(3u, pool.size());
+  for (int k = 0; k < 10; ++k) {
+    recorder r(1000);
+    pool.parallel_for(1000, 10, bind(&recorder::run, &r, _1, _2));
+    expect_squares(r);
+    EXPECT_EQ(4, r.calls);
+  }
+}
+
+TEST(worker_pool, small_batch) {
+  worker_pool pool(3);
+  recorder r(5);
+  pool.parallel_for(5, 10, bind(&recorder::run, &r, _1, _2));
+  expect_squares(r);
+  EXPECT_EQ(1, r.calls);
+
+  // fewer data than threads
+  recorder r2(2);
+  pool.parallel_for(2, 1, bind(&recorder::run, &r2, _1, _2));
+  expect_squares(r2);
+  EXPECT_EQ(2, r2.calls);
+}
+
+TEST(worker_pool, exception) {
+  worker_pool pool(2);
+  recorder r(100);
+  EXPECT_THROW(
+      pool.parallel_for(100, 1, bind(&recorder::fail, &r, _1, _2)),
+      core::common::exception::jubatus_exception);
+  // other parts are finished before parallel_for returns
+  EXPECT_EQ(2, r.calls);
+}
+
+}  // namespace framework
+}  // namespace server
+}  // namespace jubatus
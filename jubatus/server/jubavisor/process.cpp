@@ -114,6 +114,26 @@ bool process::spawn_link(int p) {
       "-s", lexical_cast<std::string, int>(server_option_.interval_sec),
       "-i", lexical_cast<std::string, int>(server_option_.interval_count),
       "-x", server_option_.mixer,
+      "--mixer_fanout",
+      lexical_cast<std::string, int>(server_option_.mixer_fanout),
+      "--mix_compression", server_option_.mix_compression,
+      "--mix_quantization", server_option_.mix_quantization,
+      "--mix_sparsify_threshold",
+      lexical_cast<std::string, double>(server_option_.mix_sparsify_threshold),
+      "--mix_sparsify_top_k",
+      lexical_cast<std::string, int>(server_option_.mix_sparsify_top_k),
+      "--coalesce_window",
+      lexical_cast<std::string, int>(server_option_.coalesce_window),
+      "--coalesce_max_batch",
+      lexical_cast<std::string, int>(server_option_.coalesce_max_batch),
+      "--batch_threads",
+      lexical_cast<std::string, int>(server_option_.batch_threads),
+      "--batch_min_split",
+      lexical_cast<std::string, int>(server_option_.batch_min_split),
+      "--cht_weight",
+      lexical_cast<std::string, int>(server_option_.cht_weight),
+      "--rebalance_rate",
+      lexical_cast<std::string, int>(server_option_.rebalance_rate),
     };
     std::vector<const char*> arg_list;
     for (size_t i = 0; i < sizeof(argv) / sizeof(*argv); ++i) {
@@ -33,11 +33,12 @@ int run_proxy(int argc, char* argv[]) {
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
     k.register_async_random<float, jubatus::core::fv_converter::datum>(
-        "calc_score");
+        "calc_score", jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<std::vector<std::string> >("get_all_rows",
-        jubatus::util::lang::function<std::vector<std::string>(
-        std::vector<std::string>, std::vector<std::string>)>(
-        &jubatus::server::framework::concat<std::string>));
+        jubatus::util::lang::function<void(std::vector<std::string>&,
+        std::vector<std::string>&)>(
+        &jubatus::server::framework::concat_into<std::string>),
+        jubatus::server::framework::proxy::ANALYSIS);
     return k.run();
   } catch (const jubatus::core::common::exception::jubatus_exception& e) {
     LOG(FATAL) << "exception in proxy main thread: "
@@ -38,6 +38,7 @@
 #include "../common/logger/logger.hpp"
 #include "../common/membership.hpp"
 #endif
+#include "../common/mprpc/rpc_connection_pool.hpp"
 #include "../framework/mixer/mixer_factory.hpp"
 #include "anomaly_client.hpp"
 
@@ -87,6 +88,7 @@ anomaly_serv::anomaly_serv(
 #ifdef HAVE_ZOOKEEPER_H
   } else {
     zk_ = zk;
+    cht_.reset(new common::cached_cht(zk_, a.type, a.name));
     common::global_id_generator_zk* idgen_zk =
         new common::global_id_generator_zk();
     idgen_.reset(idgen_zk);
@@ -258,8 +260,7 @@ void anomaly_serv::find_from_cht(
     vector<pair<string, int> >& out) {
   out.clear();
 #ifdef HAVE_ZOOKEEPER_H
-  common::cht ht(zk_, argv().type, argv().name);
-  ht.find(key, out, n);  // replication number of local_node
+  cht_->find(key, out, n);  // replication number of local_node
 #else
   // cannot reach here, assertion!
   JUBATUS_ASSERT_UNREACHABLE();
@@ -290,25 +291,17 @@ float anomaly_serv::selective_update(
       return this->overwrite(id, d);
     }
   } else {  // needs no lock
-    client::anomaly c(host, port, argv().name, argv().interconnect_timeout);
-    if (anomaly_->is_updatable()) {
-      return c.update(id, d);
-    } else {
-      return c.overwrite(id, d);
-    }
-  }
-}
-
-bool anomaly_serv::load(const std::string& id) {
-  if (server_base::load(id)) {
-    reset_id_generator();
-    return true;
+    const string method = anomaly_->is_updatable() ? "update" : "overwrite";
+    return common::mprpc::rpc_connection_pool::shared().call_apply<float>(
+        host, port, argv().interconnect_timeout, method,
+        msgpack::type::tuple<const string&, const string&, const datum&>(
+            argv().name, id, d));
   }
-  return false;
 }
 
-void anomaly_serv::load_file(const std::string& path) {
-  server_base::load_file(path);
+void anomaly_serv::event_model_loaded() {
+  // under the same lock as the model, so that add never leases an ID of a
+  // loaded row
   reset_id_generator();
 }
 
@@ -318,7 +311,15 @@ void anomaly_serv::reset_id_generator() {
     idgen_.reset(
         new common::global_id_generator_standalone(counter));
   } else {
-    // TODO(hido): support ID check for distributed mode
+#ifdef HAVE_ZOOKEEPER_H
+    // rows in the loaded model may have IDs not leased from the current
+    // counter in ZooKeeper (e.g. the model was saved in another cluster)
+    common::global_id_generator_zk* idgen_zk =
+        dynamic_cast<common::global_id_generator_zk*>(idgen_.get());
+    if (idgen_zk) {
+      idgen_zk->reset(anomaly_->find_max_int_id() + 1);
+    }
+#endif
   }
 }
 
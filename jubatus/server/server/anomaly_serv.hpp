@@ -23,6 +23,7 @@
 
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/core/driver/anomaly.hpp"
+#include "../common/cht.hpp"
 #include "../common/global_id_generator_base.hpp"
 #include "../common/lock_service.hpp"
 #include "../fv_converter/so_factory.hpp"
@@ -67,8 +68,7 @@ class anomaly_serv : public framework::server_base {
 
   void check_set_config() const;
 
-  virtual bool load(const std::string& id);
-  void load_file(const std::string& path);
+  void event_model_loaded();
 
  private:
   id_with_score add_zk(
@@ -93,6 +93,7 @@ class anomaly_serv : public framework::server_base {
   std::string config_;
 
   jubatus::util::lang::shared_ptr<common::lock_service> zk_;
+  jubatus::util::lang::shared_ptr<common::cached_cht> cht_;
   jubatus::util::lang::shared_ptr<common::global_id_generator_base> idgen_;
   fv_converter::so_factory so_loader_;
 };
@@ -23,22 +23,26 @@ int run_proxy(int argc, char* argv[]) {
         &jubatus::server::framework::pass<int32_t>));
     k.register_async_cht<2, window>("get_result",
         jubatus::util::lang::function<window(window, window)>(
-        &jubatus::server::framework::pass<window>));
+        &jubatus::server::framework::pass<window>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<2, window, double>("get_result_at",
         jubatus::util::lang::function<window(window, window)>(
-        &jubatus::server::framework::pass<window>));
+        &jubatus::server::framework::pass<window>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<std::map<std::string, window> >(
         "get_all_bursted_results",
-        jubatus::util::lang::function<std::map<std::string, window>(
-        std::map<std::string, window>, std::map<std::string, window>)>(
-        &jubatus::server::framework::merge<std::string, window>));
+        jubatus::util::lang::function<void(std::map<std::string, window>&,
+        std::map<std::string, window>&)>(
+        &jubatus::server::framework::merge_into<std::string, window>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<std::map<std::string, window>, double>(
         "get_all_bursted_results_at",
-        jubatus::util::lang::function<std::map<std::string, window>(
-        std::map<std::string, window>, std::map<std::string, window>)>(
-        &jubatus::server::framework::merge<std::string, window>));
+        jubatus::util::lang::function<void(std::map<std::string, window>&,
+        std::map<std::string, window>&)>(
+        &jubatus::server::framework::merge_into<std::string, window>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<std::vector<keyword_with_params> >(
-        "get_all_keywords");
+        "get_all_keywords", jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool, keyword_with_params>("add_keyword",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
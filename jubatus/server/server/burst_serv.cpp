@@ -19,6 +19,9 @@
 #include <vector>
 #include <utility>
 #include "burst_serv.hpp"
+#include "jubatus/util/concurrent/lock.h"
+#include "jubatus/util/data/optional.h"
+#include "jubatus/util/system/time_util.h"
 #include "../framework/mixer/mixer_factory.hpp"
 #include "jubatus/core/common/assert.hpp"
 
@@ -34,6 +37,7 @@ using jubatus::util::lang::_1;
 using jubatus::util::lang::_2;
 using jubatus::util::lang::_3;
 using jubatus::util::text::json::json;
+using jubatus::util::system::time::get_clock_time;
 using jubatus::core::common::jsonconfig::config_cast_check;
 using jubatus::core::burst::burst_options;
 using jubatus::core::burst::burst_result;
@@ -49,10 +53,13 @@ namespace {
 struct burst_serv_config {
   std::string method;
   core::common::jsonconfig::config parameter;
+  // seconds to wait for more documents before calculating results
+  jubatus::util::data::optional<double> calculation_delay;
 
   template<typename Ar>
   void serialize(Ar& ar) {
-    ar & JUBA_MEMBER(method) & JUBA_MEMBER(parameter);
+    ar & JUBA_MEMBER(method) & JUBA_MEMBER(parameter)
+        & JUBA_MEMBER(calculation_delay);
   }
 };
 
@@ -83,16 +90,30 @@ std::map<std::string, window>
   return result;
 }
 
+// separates keywords found in a document; the driver looks for each
+// keyword with std::string::find, and finds it in the found keywords iff
+// it is in the document unless it has the separator
+const char KEYWORD_SEPARATOR = '\0';
+
+bool has_separator(const std::vector<std::string>& keywords) {
+  for (size_t i = 0; i < keywords.size(); ++i) {
+    if (keywords[i].find(KEYWORD_SEPARATOR) != std::string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
 #ifdef HAVE_ZOOKEEPER_H
 const int replication_level = 2;
 
 bool is_assigned(
-    common::cht& cht,
+    const common::cht_ring& ring,
     const std::string& keyword,
     const std::string& host,
     int port) {
   std::vector<std::pair<std::string, int> > nodes;
-  cht.find(keyword, nodes, replication_level);
+  ring.find(keyword, nodes, replication_level);
   for (size_t i = 0; i < nodes.size(); ++i) {
     if (nodes[i].first == host && nodes[i].second == port) {
       return true;
@@ -110,14 +131,37 @@ burst_serv::burst_serv(const server_argv& a,
     : server_base(a),
       mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())),
       zk_(zk),
-      watcher_binded_(false) {
+      watcher_binded_(false),
+      reduce_documents_(true),
+      calc_delay_(0),
+      calc_pending_(false),
+      calc_stopping_(false),
+      calc_count_(0),
+      calculator_(bind(&burst_serv::calculator_loop_, this)) {
+#ifdef HAVE_ZOOKEEPER_H
+  if (!a.is_standalone()) {
+    cht_.reset(new common::cached_cht(zk_, a.type, a.name));
+  }
+#endif
+  calculator_.start();
 }
 
 burst_serv::~burst_serv() {
+  {
+    jubatus::util::concurrent::scoped_lock lk(calc_m_);
+    calc_stopping_ = true;
+    calc_cond_.notify_all();
+  }
+  calculator_.join();
 }
 
 void burst_serv::get_status(status_t& status) const {
   burst_->get_status(status);
+
+  jubatus::util::concurrent::scoped_lock lk(calc_m_);
+  status["results_calculation_delay"] = lexical_cast<std::string>(calc_delay_);
+  status["results_pending"] = lexical_cast<std::string>(calc_pending_);
+  status["results_calculations"] = lexical_cast<std::string>(calc_count_);
 }
 
 void burst_serv::set_config(const std::string& config) {
@@ -131,6 +175,11 @@ void burst_serv::set_config(const std::string& config) {
   burst_.reset(new core::driver::burst(new core::burst::burst(options)));
   mixer_->set_driver(burst_.get());
 
+  {
+    jubatus::util::concurrent::scoped_lock lk(calc_m_);
+    calc_delay_ = conf.calculation_delay ? *conf.calculation_delay : 0;
+  }
+
   LOG(INFO) << "config loaded: " << config;
 }
 
@@ -152,10 +201,26 @@ int burst_serv::add_documents(const std::vector<document>& data) {
   }
 #endif
 
+  update_matcher_();
+  const std::vector<std::string>& keywords = matcher_.keywords();
+  std::vector<size_t> found;
+  std::string found_keywords;
+
   size_t processed = 0;
   for (size_t i = 0; i < data.size(); i++) {
     const document& doc = data[i];
-    if (burst_->add_document(doc.text, doc.pos)) {
+    const std::string* text = &doc.text;
+    if (reduce_documents_) {
+      matcher_.match(doc.text, found);
+      // starts with the separator to pass no empty text for a document
+      found_keywords.assign(1, KEYWORD_SEPARATOR);
+      for (size_t j = 0; j < found.size(); ++j) {
+        found_keywords += keywords[found[j]];
+        found_keywords += KEYWORD_SEPARATOR;
+      }
+      text = &found_keywords;
+    }
+    if (burst_->add_document(*text, doc.pos)) {
       ++processed;
     } else {
       DLOG(INFO) << "add_document failed: "
@@ -167,11 +232,70 @@ int burst_serv::add_documents(const std::vector<document>& data) {
     }
   }
   if (processed > 0) {
-    burst_->calculate_results();
+    request_calculation_();
   }
   return processed;
 }
 
+void burst_serv::update_matcher_() {
+  const core::driver::burst::keyword_list keywords =
+      burst_->get_all_keywords();
+  std::vector<std::string> words(keywords.size());
+  for (size_t i = 0; i < keywords.size(); ++i) {
+    words[i] = keywords[i].keyword;
+  }
+  if (words != matcher_.keywords()) {
+    matcher_ = common::keyword_matcher(words);
+    reduce_documents_ = !has_separator(words);
+  }
+}
+
+void burst_serv::request_calculation_() {
+  {
+    jubatus::util::concurrent::scoped_lock lk(calc_m_);
+    if (0 < calc_delay_) {
+      // the first request starts the delay, which later ones do not extend
+      if (!calc_pending_) {
+        calc_pending_ = true;
+        calc_requested_at_ = get_clock_time();
+        calc_cond_.notify_all();
+      }
+      return;
+    }
+    ++calc_count_;
+  }
+  burst_->calculate_results();
+}
+
+void burst_serv::calculator_loop_() {
+  jubatus::util::concurrent::scoped_lock lk(calc_m_);
+  while (!calc_stopping_) {
+    if (!calc_pending_) {
+      calc_cond_.wait(calc_m_);
+      continue;
+    }
+    const double rest =
+        calc_delay_ - (get_clock_time() - calc_requested_at_);
+    if (0 < rest) {
+      calc_cond_.wait(calc_m_, rest);
+      continue;
+    }
+    calc_pending_ = false;
+
+    // the model lock must not be taken while holding calc_m_, which
+    // add_documents takes under the model lock
+    calc_m_.unlock();
+    try {
+      jubatus::util::concurrent::scoped_wlock wlk(rw_mutex());
+      burst_->calculate_results();
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "failed to calculate results: " << e.what();
+    }
+    calc_m_.lock();
+    ++calc_count_;
+  }
+}
+
 window burst_serv::get_result(const std::string& keyword) const {
   return to_window(burst_->get_result(keyword));
 }
@@ -230,8 +354,7 @@ bool burst_serv::will_process(const std::string& keyword) const {
     return true;
 #ifdef HAVE_ZOOKEEPER_H
   } else {
-    common::cht cht(zk_, a.type, a.name);
-    return is_assigned(cht, keyword, a.eth, a.port);
+    return is_assigned(*cht_->get_ring(), keyword, a.eth, a.port);
   }
 #endif
 }
@@ -241,13 +364,48 @@ void burst_serv::rehash_keywords() {
   if (argv().is_standalone()) {
     return;
   }
+  set_processed_keywords_(std::map<std::string, bool>(), *cht_->get_ring());
+#endif
+}
+
+void burst_serv::rehash_keywords_unlocked_() {
+#ifdef HAVE_ZOOKEEPER_H
+  const server_argv& a = argv();
+  const shared_ptr<const common::cht_ring> ring = cht_->get_ring();
+
+  core::driver::burst::keyword_list keywords;
+  {
+    jubatus::util::concurrent::scoped_rlock lk(rw_mutex());
+    keywords = burst_->get_all_keywords();
+  }
+
+  // looking up all keywords takes long; requests are not blocked meanwhile
+  std::map<std::string, bool> assigned;
+  for (size_t i = 0; i < keywords.size(); ++i) {
+    assigned[keywords[i].keyword] =
+        is_assigned(*ring, keywords[i].keyword, a.eth, a.port);
+  }
 
+  jubatus::util::concurrent::scoped_wlock lk(rw_mutex());
+  set_processed_keywords_(assigned, *ring);
+#endif
+}
+
+void burst_serv::set_processed_keywords_(
+    const std::map<std::string, bool>& assigned,
+    const common::cht_ring& ring) {
+#ifdef HAVE_ZOOKEEPER_H
+  const server_argv& a = argv();
   core::driver::burst::keyword_list keywords = burst_->get_all_keywords();
   std::vector<std::string> processed_keywords;
 
   for (core::driver::burst::keyword_list::iterator iter = keywords.begin();
        iter != keywords.end(); ++iter) {
-    if (will_process(iter->keyword)) {
+    // keywords added after assigned was made are looked up here
+    std::map<std::string, bool>::const_iterator it =
+        assigned.find(iter->keyword);
+    if (it != assigned.end() ? it->second
+        : is_assigned(ring, iter->keyword, a.eth, a.port)) {
       processed_keywords.push_back(iter->keyword);
     }
   }
@@ -275,8 +433,9 @@ void burst_serv::watcher_impl_(int type, int state, const std::string& path) {
   JUBATUS_ASSERT(!argv().is_standalone());
 
   if (type == ZOO_CHILD_EVENT) {
-    jubatus::util::concurrent::scoped_wlock lk(rw_mutex());
-    rehash_keywords();
+    // the CHT entries may be removed after the node entries
+    cht_->reload();
+    rehash_keywords_unlocked_();
   } else {
     LOG(WARNING) << "burst_serv::watcher_impl_ got unexpected event ("
                  << type << "), something wrong: " << path;
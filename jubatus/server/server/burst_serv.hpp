@@ -20,7 +20,13 @@
 #include <map>
 #include <string>
 #include <vector>
+#include "jubatus/util/concurrent/condition.h"
+#include "jubatus/util/concurrent/mutex.h"
+#include "jubatus/util/concurrent/thread.h"
+#include "jubatus/util/system/time_util.h"
 #include "../framework.hpp"
+#include "../common/cht.hpp"
+#include "../common/keyword_matcher.hpp"
 
 #include "jubatus/core/driver/burst.hpp"
 #include "burst_types.hpp"
@@ -67,10 +73,44 @@ class burst_serv : public jubatus::server::framework::server_base {
   std::string config_;
 
   jubatus::util::lang::shared_ptr<common::lock_service> zk_;
+  jubatus::util::lang::shared_ptr<common::cached_cht> cht_;
   bool watcher_binded_;
 
   void bind_watcher_();
   void watcher_impl_(int type, int state, const std::string& path);
+
+  // rehashes keywords without the model lock, which is only taken to
+  // swap the processed keywords
+  void rehash_keywords_unlocked_();
+  // keywords not in assigned are looked up in ring; called with the write
+  // lock held
+  void set_processed_keywords_(
+      const std::map<std::string, bool>& assigned,
+      const common::cht_ring& ring);
+
+  // rebuilds matcher_ if keywords have changed (e.g., by add_keyword, mix
+  // or load); called with the write lock held
+  void update_matcher_();
+
+  // with calculation_delay in the config, results are calculated by a
+  // background thread, once for documents of all add_documents requests
+  // arriving within the delay
+  void request_calculation_();
+  void calculator_loop_();
+
+  // all keywords, to pass only those found in a document to the driver
+  common::keyword_matcher matcher_;
+  // false if a keyword has the separator of found keywords
+  bool reduce_documents_;
+
+  mutable jubatus::util::concurrent::mutex calc_m_;
+  jubatus::util::concurrent::condition calc_cond_;
+  double calc_delay_;  // 0 to calculate in add_documents
+  bool calc_pending_;
+  jubatus::util::system::time::clock_time calc_requested_at_;
+  bool calc_stopping_;
+  uint64_t calc_count_;
+  jubatus::util::concurrent::thread calculator_;
 };
 
 }  // namespace server
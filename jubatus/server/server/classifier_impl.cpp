@@ -52,7 +52,7 @@ class classifier_impl : public jubatus::server::common::mprpc::rpc_server {
   }
 
   int32_t train(const std::vector<labeled_datum>& data) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->train(data);
   }
 
@@ -93,7 +93,7 @@ class classifier_impl : public jubatus::server::common::mprpc::rpc_server {
   }
 
   bool load(const std::string& id) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->load(id);
   }
 
@@ -18,10 +18,18 @@ int run_proxy(int argc, char* argv[]) {
   try {
     jubatus::server::framework::proxy k(
         jubatus::server::framework::proxy_argv(argc, argv, "classifier"));
-    k.register_async_random<int32_t, std::vector<labeled_datum> >("train");
-    k.register_async_random<std::vector<std::vector<estimate_result> >,
-        std::vector<jubatus::core::fv_converter::datum> >("classify");
-    k.register_async_random<std::vector<std::string> >("get_labels");
+    k.register_async_split<int32_t, std::vector<labeled_datum> >("train",
+        jubatus::util::lang::function<int32_t(int32_t, int32_t)>(
+        &jubatus::server::framework::add<int32_t>));
+    k.register_async_split<std::vector<std::vector<estimate_result> >,
+        std::vector<jubatus::core::fv_converter::datum> >("classify",
+        jubatus::util::lang::function<void(std::vector<std::vector<
+        estimate_result> >&, std::vector<std::vector<estimate_result> >&)>(
+        &jubatus::server::framework::concat_into<std::vector<
+        estimate_result> >),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_random<std::vector<std::string> >("get_labels",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<bool, std::string>("set_label");
     k.register_async_broadcast<bool>("clear",
         jubatus::util::lang::function<bool(bool, bool)>(
@@ -21,6 +21,7 @@
 
 #include "jubatus/util/text/json.h"
 #include "jubatus/util/data/optional.h"
+#include "jubatus/util/lang/bind.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "jubatus/core/classifier/classifier_factory.hpp"
@@ -73,7 +74,16 @@ classifier_serv::classifier_serv(
     const framework::server_argv& a,
     const jubatus::util::lang::shared_ptr<lock_service>& zk)
     : server_base(a),
-      mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())) {
+      mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())),
+      train_coalescer_(
+          rw_mutex(),
+          jubatus::util::lang::bind(&classifier_serv::apply_train, this,
+                                    jubatus::util::lang::_1),
+          jubatus::util::lang::bind(
+              &classifier_serv::event_model_updated, this),
+          a.coalesce_window / 1000.0,
+          a.coalesce_max_batch),
+      batch_pool_(a.batch_threads) {
 }
 
 classifier_serv::~classifier_serv() {
@@ -82,6 +92,7 @@ classifier_serv::~classifier_serv() {
 void classifier_serv::get_status(status_t& status) const {
   status_t my_status;
   classifier_->get_status(my_status);
+  train_coalescer_.get_status(my_status, "train");
   status.insert(my_status.begin(), my_status.end());
 }
 
@@ -123,6 +134,10 @@ uint64_t classifier_serv::user_data_version() const {
 }
 
 int classifier_serv::train(const vector<labeled_datum>& data) {
+  return train_coalescer_.submit(data);
+}
+
+int classifier_serv::apply_train(const vector<labeled_datum>& data) {
   check_set_config();
 
   int count = 0;
@@ -142,12 +157,23 @@ vector<vector<estimate_result> > classifier_serv::classify(
     const vector<jubatus::core::fv_converter::datum>& data) const {
   check_set_config();
 
-  vector<vector<estimate_result> > ret;
+  // the caller holds the read lock until all parts are classified
+  vector<vector<estimate_result> > ret(data.size());
+  batch_pool_.parallel_for(data.size(), argv().batch_min_split,
+      jubatus::util::lang::bind(&classifier_serv::classify_range, this,
+          &data, &ret, jubatus::util::lang::_1, jubatus::util::lang::_2));
+  return ret;  // vector<estimate_results> >::ok(ret);
+}
 
-  for (size_t i = 0; i < data.size(); ++i) {
-    classify_result scores = classifier_->classify(data[i]);
+void classifier_serv::classify_range(
+    const vector<jubatus::core::fv_converter::datum>* data,
+    vector<vector<estimate_result> >* ret,
+    size_t begin,
+    size_t end) const {
+  for (size_t i = begin; i < end; ++i) {
+    classify_result scores = classifier_->classify((*data)[i]);
 
-    vector<estimate_result> r;
+    vector<estimate_result>& r = (*ret)[i];
     for (classify_result::const_iterator p = scores.begin();
         p != scores.end(); ++p) {
       // convert to server IDL types
@@ -159,9 +185,7 @@ vector<vector<estimate_result> > classifier_serv::classify(
         LOG(WARNING) << "score is infinite: " << p->label << " = " << p->score;
       }
     }
-    ret.push_back(r);
   }
-  return ret;  // vector<estimate_results> >::ok(ret);
 }
 
 bool classifier_serv::clear() {
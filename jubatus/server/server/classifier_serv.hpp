@@ -24,6 +24,8 @@
 #include "jubatus/core/driver/classifier.hpp"
 #include "classifier_types.hpp"
 #include "../framework/server_base.hpp"
+#include "../framework/update_coalescer.hpp"
+#include "../framework/worker_pool.hpp"
 #include "../fv_converter/so_factory.hpp"
 
 namespace jubatus {
@@ -47,6 +49,7 @@ class classifier_serv : public framework::server_base {
   void get_status(status_t& status) const;
   uint64_t user_data_version() const;
 
+  // takes the write lock by itself to coalesce concurrent requests
   int train(const std::vector<labeled_datum>& data);
   void set_config(const std::string& config);
   std::string get_config() const;
@@ -62,10 +65,19 @@ class classifier_serv : public framework::server_base {
   void check_set_config() const;
 
  private:
+  int apply_train(const std::vector<labeled_datum>& data);
+  void classify_range(
+      const std::vector<jubatus::core::fv_converter::datum>* data,
+      std::vector<std::vector<estimate_result> >* ret,
+      size_t begin,
+      size_t end) const;
+
   jubatus::util::lang::shared_ptr<framework::mixer::mixer> mixer_;
   jubatus::util::lang::shared_ptr<core::driver::classifier> classifier_;
   std::string config_;
   fv_converter::so_factory so_loader_;
+  framework::update_coalescer<std::vector<labeled_datum>, int> train_coalescer_;
+  mutable framework::worker_pool batch_pool_;
 };
 
 }  // namespace server
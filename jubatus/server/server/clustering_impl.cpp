@@ -108,7 +108,7 @@ class clustering_impl : public jubatus::server::common::mprpc::rpc_server {
   }
 
   bool load(const std::string& id) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->load(id);
   }
 
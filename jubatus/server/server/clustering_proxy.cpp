@@ -18,18 +18,24 @@ int run_proxy(int argc, char* argv[]) {
   try {
     jubatus::server::framework::proxy k(
         jubatus::server::framework::proxy_argv(argc, argv, "clustering"));
-    k.register_async_random<bool,
-        std::vector<jubatus::core::fv_converter::datum> >("push");
-    k.register_async_random<uint32_t>("get_revision");
+    k.register_async_split<bool,
+        std::vector<jubatus::core::fv_converter::datum> >("push",
+        jubatus::util::lang::function<bool(bool, bool)>(
+        &jubatus::server::framework::all_and));
+    k.register_async_random<uint32_t>("get_revision",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<std::vector<std::vector<std::pair<double,
-        jubatus::core::fv_converter::datum> > > >("get_core_members");
+        jubatus::core::fv_converter::datum> > > >("get_core_members",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<std::vector<jubatus::core::fv_converter::datum> >(
-        "get_k_center");
+        "get_k_center", jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<jubatus::core::fv_converter::datum,
-        jubatus::core::fv_converter::datum>("get_nearest_center");
+        jubatus::core::fv_converter::datum>("get_nearest_center",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<std::vector<std::pair<double,
         jubatus::core::fv_converter::datum> >,
-        jubatus::core::fv_converter::datum>("get_nearest_members");
+        jubatus::core::fv_converter::datum>("get_nearest_members",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool>("clear",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
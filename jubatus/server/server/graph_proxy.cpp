@@ -35,7 +35,8 @@ int run_proxy(int argc, char* argv[]) {
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
     k.register_async_random<double, std::string, int32_t,
-        jubatus::core::graph::preset_query>("get_centrality");
+        jubatus::core::graph::preset_query>("get_centrality",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool, jubatus::core::graph::preset_query>(
         "add_centrality_query", jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
@@ -49,7 +50,7 @@ int run_proxy(int argc, char* argv[]) {
         "remove_shortest_path_query", jubatus::util::lang::function<bool(bool,
         bool)>(&jubatus::server::framework::all_and));
     k.register_async_random<std::vector<std::string>, shortest_path_query>(
-        "get_shortest_path");
+        "get_shortest_path", jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool>("update_index",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
@@ -59,10 +60,12 @@ int run_proxy(int argc, char* argv[]) {
     k.register_async_cht<2, jubatus::core::graph::node_info>("get_node",
         jubatus::util::lang::function<jubatus::core::graph::node_info(
         jubatus::core::graph::node_info, jubatus::core::graph::node_info)>(
-        &jubatus::server::framework::pass<jubatus::core::graph::node_info>));
+        &jubatus::server::framework::pass<jubatus::core::graph::node_info>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<2, edge, uint64_t>("get_edge",
         jubatus::util::lang::function<edge(edge, edge)>(
-        &jubatus::server::framework::pass<edge>));
+        &jubatus::server::framework::pass<edge>),
+        jubatus::server::framework::proxy::ANALYSIS);
     return k.run();
   } catch (const jubatus::core::common::exception::jubatus_exception& e) {
     LOG(FATAL) << "exception in proxy main thread: "
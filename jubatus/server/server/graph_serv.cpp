@@ -41,6 +41,7 @@
 #include "../common/membership.hpp"
 #include "../common/mprpc/rpc_mclient.hpp"
 #endif
+#include "../common/mprpc/rpc_connection_pool.hpp"
 #ifdef HAVE_ZOOKEEPER_H
 #include "../framework/aggregators.hpp"
 #endif
@@ -113,6 +114,7 @@ graph_serv::graph_serv(
 #ifdef HAVE_ZOOKEEPER_H
   } else {
     zk_ = zk;
+    cht_.reset(new common::cached_cht(zk_, a.type, a.name));
 
     common::global_id_generator_zk* idgen_zk =
         new common::global_id_generator_zk();
@@ -257,7 +259,10 @@ bool graph_serv::remove_node(const std::string& nid_str) {
 
     if (!members.empty()) {
       // create global node
-      common::mprpc::rpc_mclient c(members, argv().interconnect_timeout);
+      common::mprpc::rpc_mclient c(
+          members,
+          argv().interconnect_timeout,
+          common::mprpc::rpc_connection_pool::shared());
 
 #ifndef NDEBUG
       for (size_t i = 0; i < members.size(); i++) {
@@ -312,13 +317,15 @@ edge_id_t graph_serv::create_edge(const std::string& id, const edge& ei) {
       try {
         if (nodes[i].first == argv().eth && nodes[i].second == argv().port) {
         } else {
-          client::graph c(nodes[i].first,
-                          nodes[i].second,
-                          argv().name,
-                          argv().interconnect_timeout);
           DLOG(INFO) << "request to "
               << nodes[i].first << ":" << nodes[i].second;
-          c.create_edge_here(eid, ei);
+          common::mprpc::rpc_connection_pool::shared().call_apply<bool>(
+              nodes[i].first,
+              nodes[i].second,
+              argv().interconnect_timeout,
+              "create_edge_here",
+              msgpack::type::tuple<const string&, edge_id_t, const edge&>(
+                  argv().name, eid, ei));
         }
       } catch (const core::graph::local_node_exists& e) {  // pass through
       } catch (const core::graph::global_node_exists& e) {  // pass through
@@ -510,11 +517,13 @@ void graph_serv::selective_create_node_(
     this->create_node_here(nid_str);
   } else {
     // must not lock here
-    client::graph c(target.first,
-                    target.second,
-                    argv().name,
-                    argv().interconnect_timeout);
-    c.create_node_here(nid_str);
+    common::mprpc::rpc_connection_pool::shared().call_apply<bool>(
+        target.first,
+        target.second,
+        argv().interconnect_timeout,
+        "create_node_here",
+        msgpack::type::tuple<const string&, const string&>(
+            argv().name, nid_str));
   }
 }
 
@@ -524,8 +533,7 @@ void graph_serv::find_from_cht_(
     std::vector<std::pair<std::string, int> >& out) {
   out.clear();
 #ifdef HAVE_ZOOKEEPER_H
-  common::cht ht(zk_, argv().type, argv().name);
-  ht.find(key, out, n);  // replication number of local_node
+  cht_->find(key, out, n);  // replication number of local_node
 #else
   // cannot reach here, assertion!
   JUBATUS_ASSERT_UNREACHABLE();
@@ -25,6 +25,7 @@
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "jubatus/core/driver/graph.hpp"
+#include "../common/cht.hpp"
 #include "../common/global_id_generator_base.hpp"
 #include "../common/lock_service.hpp"
 #include "../framework/server_base.hpp"
@@ -110,6 +111,7 @@ class graph_serv : public framework::server_base {
   std::string config_;
 
   jubatus::util::lang::shared_ptr<common::lock_service> zk_;
+  jubatus::util::lang::shared_ptr<common::cached_cht> cht_;
   jubatus::util::lang::shared_ptr<common::global_id_generator_base> idgen_;
 };
 
@@ -105,7 +105,7 @@ class nearest_neighbor_impl : public jubatus::server::common::mprpc::rpc_server
   }
 
   bool load(const std::string& id) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->load(id);
   }
 
@@ -24,15 +24,34 @@ int run_proxy(int argc, char* argv[]) {
     k.register_async_cht<1, bool, jubatus::core::fv_converter::datum>("set_row",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::pass<bool>));
-    k.register_async_random<std::vector<std::pair<std::string, float> >,
-        std::string, uint32_t>("neighbor_row_from_id");
-    k.register_async_random<std::vector<std::pair<std::string, float> >,
-        jubatus::core::fv_converter::datum, uint32_t>(
-        "neighbor_row_from_datum");
-    k.register_async_random<std::vector<std::pair<std::string, float> >,
-        std::string, int32_t>("similar_row_from_id");
-    k.register_async_random<std::vector<std::pair<std::string, float> >,
-        jubatus::core::fv_converter::datum, int32_t>("similar_row_from_datum");
+    k.register_async_top_k<0, std::vector<std::pair<std::string, float> >,
+        std::string, uint32_t>("neighbor_row_from_id",
+        jubatus::util::lang::function<void(std::vector<std::pair<std::string,
+        float> >&, std::vector<std::pair<std::string, float> >&, size_t)>(
+        &jubatus::server::framework::bottom_k_into<std::pair<std::string,
+        float> >),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_top_k<0, std::vector<std::pair<std::string, float> >,
+        jubatus::core::fv_converter::datum, uint32_t>("neighbor_row_from_datum",
+        jubatus::util::lang::function<void(std::vector<std::pair<std::string,
+        float> >&, std::vector<std::pair<std::string, float> >&, size_t)>(
+        &jubatus::server::framework::bottom_k_into<std::pair<std::string,
+        float> >),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_top_k<0, std::vector<std::pair<std::string, float> >,
+        std::string, int32_t>("similar_row_from_id",
+        jubatus::util::lang::function<void(std::vector<std::pair<std::string,
+        float> >&, std::vector<std::pair<std::string, float> >&, size_t)>(
+        &jubatus::server::framework::top_k_into<std::pair<std::string,
+        float> >),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_top_k<0, std::vector<std::pair<std::string, float> >,
+        jubatus::core::fv_converter::datum, int32_t>("similar_row_from_datum",
+        jubatus::util::lang::function<void(std::vector<std::pair<std::string,
+        float> >&, std::vector<std::pair<std::string, float> >&, size_t)>(
+        &jubatus::server::framework::top_k_into<std::pair<std::string,
+        float> >),
+        jubatus::server::framework::proxy::ANALYSIS);
     return k.run();
   } catch (const jubatus::core::common::exception::jubatus_exception& e) {
     LOG(FATAL) << "exception in proxy main thread: "
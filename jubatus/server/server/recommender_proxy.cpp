@@ -32,26 +32,36 @@ int run_proxy(int argc, char* argv[]) {
         jubatus::util::lang::function<jubatus::core::fv_converter::datum(
         jubatus::core::fv_converter::datum,
         jubatus::core::fv_converter::datum)>(
-        &jubatus::server::framework::pass<jubatus::core::fv_converter::datum>));
+        &jubatus::server::framework::pass<jubatus::core::fv_converter::datum>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<jubatus::core::fv_converter::datum,
-        jubatus::core::fv_converter::datum>("complete_row_from_datum");
-    k.register_async_cht<2, std::vector<id_with_score>, uint32_t>(
-        "similar_row_from_id",
-        jubatus::util::lang::function<std::vector<id_with_score>(
-        std::vector<id_with_score>, std::vector<id_with_score>)>(
-        &jubatus::server::framework::pass<std::vector<id_with_score> >));
-    k.register_async_random<std::vector<id_with_score>,
-        jubatus::core::fv_converter::datum, uint32_t>("similar_row_from_datum");
+        jubatus::core::fv_converter::datum>("complete_row_from_datum",
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_top_k<2, std::vector<id_with_score>, std::string,
+        uint32_t>("similar_row_from_id",
+        jubatus::util::lang::function<void(std::vector<id_with_score>&,
+        std::vector<id_with_score>&, size_t)>(
+        &jubatus::server::framework::top_k_into<id_with_score>),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_top_k<0, std::vector<id_with_score>,
+        jubatus::core::fv_converter::datum, uint32_t>("similar_row_from_datum",
+        jubatus::util::lang::function<void(std::vector<id_with_score>&,
+        std::vector<id_with_score>&, size_t)>(
+        &jubatus::server::framework::top_k_into<id_with_score>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<2, jubatus::core::fv_converter::datum>("decode_row",
         jubatus::util::lang::function<jubatus::core::fv_converter::datum(
         jubatus::core::fv_converter::datum,
         jubatus::core::fv_converter::datum)>(
-        &jubatus::server::framework::pass<jubatus::core::fv_converter::datum>));
-    k.register_async_random<std::vector<std::string> >("get_all_rows");
+        &jubatus::server::framework::pass<jubatus::core::fv_converter::datum>),
+        jubatus::server::framework::proxy::ANALYSIS);
+    k.register_async_random<std::vector<std::string> >("get_all_rows",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<float, jubatus::core::fv_converter::datum,
-        jubatus::core::fv_converter::datum>("calc_similarity");
+        jubatus::core::fv_converter::datum>("calc_similarity",
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_random<float, jubatus::core::fv_converter::datum>(
-        "calc_l2norm");
+        "calc_l2norm", jubatus::server::framework::proxy::ANALYSIS);
     return k.run();
   } catch (const jubatus::core::common::exception::jubatus_exception& e) {
     LOG(FATAL) << "exception in proxy main thread: "
@@ -20,6 +20,7 @@
 #include <utility>
 #include <vector>
 
+#include "jubatus/util/concurrent/lock.h"
 #include "jubatus/util/text/json.h"
 #include "jubatus/util/data/optional.h"
 #include "jubatus/util/lang/shared_ptr.h"
@@ -32,6 +33,7 @@
 #include "jubatus/core/recommender/recommender_factory.hpp"
 #include "jubatus/core/storage/storage_factory.hpp"
 
+#include "../common/mprpc/rpc_connection_pool.hpp"
 #include "../framework/mixer/mixer_factory.hpp"
 
 using std::string;
@@ -51,6 +53,9 @@ namespace server {
 
 namespace {
 
+// update_row of proxies stores rows to 2 servers by CHT
+const size_t ROW_REPLICAS = 2;
+
 struct recommender_serv_config {
   std::string method;
   // TODO(unnonouno): if must use parameter
@@ -63,6 +68,55 @@ struct recommender_serv_config {
   }
 };
 
+// decode_row restores a row exactly only from features of the plain types:
+// strings as a whole with weight 1 ("str"), numbers as they are ("num") and
+// binaries as they are ("bin").  Returns an empty string if the config
+// extracts no other features, or the reason if it does.
+std::string find_lossy_rule(const core::fv_converter::converter_config& c) {
+  if (c.string_filter_rules && !c.string_filter_rules->empty()) {
+    return "string_filter_rules";
+  }
+  if (c.num_filter_rules && !c.num_filter_rules->empty()) {
+    return "num_filter_rules";
+  }
+  if (c.hash_max_size) {
+    return "hash_max_size";
+  }
+  if (c.string_types && c.string_types->count("str")) {
+    return "string_types redefines str";
+  }
+  if (c.num_types && c.num_types->count("num")) {
+    return "num_types redefines num";
+  }
+  if (c.binary_types && c.binary_types->count("bin")) {
+    return "binary_types redefines bin";
+  }
+  if (c.string_rules) {
+    for (size_t i = 0; i < c.string_rules->size(); ++i) {
+      const core::fv_converter::string_rule& r = (*c.string_rules)[i];
+      if (r.type != "str" || r.sample_weight != "bin"
+          || r.global_weight != "bin") {
+        return "string_rules other than type str with bin weights";
+      }
+    }
+  }
+  if (c.num_rules) {
+    for (size_t i = 0; i < c.num_rules->size(); ++i) {
+      if ((*c.num_rules)[i].type != "num") {
+        return "num_rules other than type num";
+      }
+    }
+  }
+  if (c.binary_rules) {
+    for (size_t i = 0; i < c.binary_rules->size(); ++i) {
+      if ((*c.binary_rules)[i].type != "bin") {
+        return "binary_rules other than type bin";
+      }
+    }
+  }
+  return "";
+}
+
 }  // namespace
 
 recommender_serv::recommender_serv(
@@ -71,7 +125,15 @@ recommender_serv::recommender_serv(
     : server_base(a),
       mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())),
       clear_row_cnt_(),
-      update_row_cnt_() {
+      update_row_cnt_(),
+      rows_movable_(false) {
+#ifdef HAVE_ZOOKEEPER_H
+  if (!a.is_standalone() && 0 < a.rebalance_rate) {
+    rebalancer_.reset(new framework::cht_rebalancer(
+        zk, a.type, a.name, std::make_pair(a.eth, a.port), ROW_REPLICAS,
+        a.rebalance_rate, *this));
+  }
+#endif
 }
 
 recommender_serv::~recommender_serv() {
@@ -114,6 +176,14 @@ void recommender_serv::set_config(const std::string &config) {
           core::fv_converter::make_fv_converter(conf.converter, &so_loader_)));
   mixer_->set_driver(recommender_.get());
 
+  // rows are moved as decoded datum, so they must be restored exactly
+  const std::string lossy_rule = find_lossy_rule(conf.converter);
+  rows_movable_ = lossy_rule.empty();
+  if (rebalancer_ && !rows_movable_) {
+    LOG(WARNING) << "rows are not rebalanced, as they cannot be restored "
+                 << "exactly with " << lossy_rule;
+  }
+
   LOG(INFO) << "config loaded: " << config;
 }
 
@@ -210,6 +280,36 @@ std::vector<std::string> recommender_serv::get_all_rows() {
   return recommender_->get_all_rows();
 }
 
+void recommender_serv::get_row_ids(std::vector<std::string>& ids) {
+  jubatus::util::concurrent::scoped_rlock lk(rw_mutex());
+  ids.clear();
+  if (recommender_ && rows_movable_) {
+    ids = recommender_->get_all_rows();
+  }
+}
+
+bool recommender_serv::send_row(const std::string& id, const node_type& to) {
+  datum d;
+  {
+    jubatus::util::concurrent::scoped_rlock lk(rw_mutex());
+    if (!recommender_) {
+      return false;
+    }
+    d = recommender_->decode_row(id);
+  }
+  if (d.string_values_.empty() && d.num_values_.empty()
+      && d.binary_values_.empty()) {
+    // cleared after the rebalancer listed rows
+    return false;
+  }
+
+  // must not lock here
+  return common::mprpc::rpc_connection_pool::shared().call_apply<bool>(
+      to.first, to.second, argv().interconnect_timeout, "update_row",
+      msgpack::type::tuple<const string&, const string&, const datum&>(
+          argv().name, id, d));
+}
+
 float recommender_serv::calc_similarity(const datum& l, const datum& r) {
   check_set_config();
 
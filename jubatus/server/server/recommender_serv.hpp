@@ -22,6 +22,7 @@
 #include <vector>
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/core/driver/recommender.hpp"
+#include "../framework/cht_rebalancer.hpp"
 #include "../framework/server_base.hpp"
 #include "../fv_converter/so_factory.hpp"
 #include "recommender_types.hpp"
@@ -31,7 +32,8 @@ namespace server {
 
 typedef std::vector<std::pair<std::string, float> > similar_result;
 
-class recommender_serv : public framework::server_base {
+class recommender_serv : public framework::server_base,
+                         public framework::rebalance_source {
  public:
   recommender_serv(
       const framework::server_argv& a,
@@ -46,6 +48,10 @@ class recommender_serv : public framework::server_base {
     return recommender_.get();
   }
 
+  framework::cht_rebalancer* get_rebalancer() const {
+    return rebalancer_.get();
+  }
+
   void get_status(status_t& status) const;
   uint64_t user_data_version() const;
 
@@ -75,6 +81,9 @@ class recommender_serv : public framework::server_base {
 
   void check_set_config() const;
 
+  void get_row_ids(std::vector<std::string>& ids);
+  bool send_row(const std::string& id, const node_type& to);
+
  private:
   jubatus::util::lang::shared_ptr<framework::mixer::mixer> mixer_;
   jubatus::util::lang::shared_ptr<core::driver::recommender> recommender_;
@@ -83,6 +92,12 @@ class recommender_serv : public framework::server_base {
 
   uint64_t clear_row_cnt_;
   uint64_t update_row_cnt_;
+  // whether decode_row restores rows exactly, so the rebalancer can send
+  // them to other servers
+  bool rows_movable_;
+
+  // declared last to be stopped before the model is destroyed
+  jubatus::util::lang::shared_ptr<framework::cht_rebalancer> rebalancer_;
 };
 
 }  // namespace server
@@ -44,7 +44,7 @@ class regression_impl : public jubatus::server::common::mprpc::rpc_server {
   }
 
   int32_t train(const std::vector<scored_datum>& train_data) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->train(train_data);
   }
 
@@ -70,7 +70,7 @@ class regression_impl : public jubatus::server::common::mprpc::rpc_server {
   }
 
   bool load(const std::string& id) {
-    JWLOCK_(p_);
+    NOLOCK_(p_);
     return get_p()->load(id);
   }
 
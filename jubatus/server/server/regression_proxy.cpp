@@ -18,9 +18,14 @@ int run_proxy(int argc, char* argv[]) {
   try {
     jubatus::server::framework::proxy k(
         jubatus::server::framework::proxy_argv(argc, argv, "regression"));
-    k.register_async_random<int32_t, std::vector<scored_datum> >("train");
-    k.register_async_random<std::vector<float>,
-        std::vector<jubatus::core::fv_converter::datum> >("estimate");
+    k.register_async_split<int32_t, std::vector<scored_datum> >("train",
+        jubatus::util::lang::function<int32_t(int32_t, int32_t)>(
+        &jubatus::server::framework::add<int32_t>));
+    k.register_async_split<std::vector<float>,
+        std::vector<jubatus::core::fv_converter::datum> >("estimate",
+        jubatus::util::lang::function<void(std::vector<float>&,
+        std::vector<float>&)>(&jubatus::server::framework::concat_into<float>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool>("clear",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
@@ -22,6 +22,7 @@
 
 #include "jubatus/util/text/json.h"
 #include "jubatus/util/data/optional.h"
+#include "jubatus/util/lang/bind.h"
 #include "jubatus/util/lang/shared_ptr.h"
 
 #include "jubatus/core/common/jsonconfig.hpp"
@@ -71,7 +72,16 @@ regression_serv::regression_serv(
     const framework::server_argv& a,
     const jubatus::util::lang::shared_ptr<lock_service>& zk)
     : server_base(a),
-      mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())) {
+      mixer_(create_mixer(a, zk, rw_mutex(), user_data_version())),
+      train_coalescer_(
+          rw_mutex(),
+          jubatus::util::lang::bind(&regression_serv::apply_train, this,
+                                    jubatus::util::lang::_1),
+          jubatus::util::lang::bind(
+              &regression_serv::event_model_updated, this),
+          a.coalesce_window / 1000.0,
+          a.coalesce_max_batch),
+      batch_pool_(a.batch_threads) {
 }
 
 regression_serv::~regression_serv() {
@@ -80,6 +90,7 @@ regression_serv::~regression_serv() {
 void regression_serv::get_status(status_t& status) const {
   status_t my_status;
   regression_->get_status(my_status);
+  train_coalescer_.get_status(my_status, "train");
   status.insert(my_status.begin(), my_status.end());
 }
 
@@ -121,6 +132,10 @@ string regression_serv::get_config() const {
 }
 
 int regression_serv::train(const vector<scored_datum>& data) {
+  return train_coalescer_.submit(data);
+}
+
+int regression_serv::apply_train(const vector<scored_datum>& data) {
   check_set_config();
 
   int count = 0;
@@ -140,12 +155,21 @@ vector<float> regression_serv::estimate(
     const vector<datum>& data) const {
   check_set_config();
 
-  vector<float> ret;
+  vector<float> ret(data.size());
+  batch_pool_.parallel_for(data.size(), argv().batch_min_split,
+      jubatus::util::lang::bind(&regression_serv::estimate_range, this,
+          &data, &ret, jubatus::util::lang::_1, jubatus::util::lang::_2));
+  return ret;  // vector<estimate_results> >::ok(ret);
+}
 
-  for (size_t i = 0; i < data.size(); ++i) {
-    ret.push_back(regression_->estimate(data[i]));
+void regression_serv::estimate_range(
+    const vector<datum>* data,
+    vector<float>* ret,
+    size_t begin,
+    size_t end) const {
+  for (size_t i = begin; i < end; ++i) {
+    (*ret)[i] = regression_->estimate((*data)[i]);
   }
-  return ret;  // vector<estimate_results> >::ok(ret);
 }
 
 bool regression_serv::clear() {
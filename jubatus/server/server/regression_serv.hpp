@@ -24,6 +24,8 @@
 #include "jubatus/util/lang/shared_ptr.h"
 #include "jubatus/core/driver/regression.hpp"
 #include "../framework/server_base.hpp"
+#include "../framework/update_coalescer.hpp"
+#include "../framework/worker_pool.hpp"
 #include "../fv_converter/so_factory.hpp"
 #include "regression_types.hpp"
 
@@ -50,6 +52,7 @@ class regression_serv : public framework::server_base {
 
   void set_config(const std::string& config);
   std::string get_config() const;
+  // takes the write lock by itself to coalesce concurrent requests
   int train(const std::vector<scored_datum>& data);
 
   std::vector<float> estimate(
@@ -60,10 +63,19 @@ class regression_serv : public framework::server_base {
   void check_set_config() const;
 
  private:
+  int apply_train(const std::vector<scored_datum>& data);
+  void estimate_range(
+      const std::vector<core::fv_converter::datum>* data,
+      std::vector<float>* ret,
+      size_t begin,
+      size_t end) const;
+
   jubatus::util::lang::shared_ptr<framework::mixer::mixer> mixer_;
   jubatus::util::lang::shared_ptr<core::driver::regression> regression_;
   std::string config_;
   fv_converter::so_factory so_loader_;
+  framework::update_coalescer<std::vector<scored_datum>, int> train_coalescer_;
+  mutable framework::worker_pool batch_pool_;
 };
 
 }  // namespace server
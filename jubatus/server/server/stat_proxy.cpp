@@ -22,20 +22,26 @@ int run_proxy(int argc, char* argv[]) {
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
     k.register_async_cht<1, double>("sum", jubatus::util::lang::function<double(
-        double, double)>(&jubatus::server::framework::pass<double>));
+        double, double)>(&jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<1, double>("stddev",
         jubatus::util::lang::function<double(double, double)>(
-        &jubatus::server::framework::pass<double>));
+        &jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<1, double>("max", jubatus::util::lang::function<double(
-        double, double)>(&jubatus::server::framework::pass<double>));
+        double, double)>(&jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<1, double>("min", jubatus::util::lang::function<double(
-        double, double)>(&jubatus::server::framework::pass<double>));
+        double, double)>(&jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<1, double>("entropy",
         jubatus::util::lang::function<double(double, double)>(
-        &jubatus::server::framework::pass<double>));
+        &jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_cht<1, double, int32_t, double>("moment",
         jubatus::util::lang::function<double(double, double)>(
-        &jubatus::server::framework::pass<double>));
+        &jubatus::server::framework::pass<double>),
+        jubatus::server::framework::proxy::ANALYSIS);
     k.register_async_broadcast<bool>("clear",
         jubatus::util::lang::function<bool(bool, bool)>(
         &jubatus::server::framework::all_and));
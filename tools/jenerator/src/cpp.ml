@@ -431,6 +431,8 @@ let gen_aggregator names ret_type aggregator =
     gen_template names true "jubatus::server::framework::concat" [t]
   | Map (k, v), Merge ->
     gen_template names true "jubatus::server::framework::merge" [k; v]
+  | _, Add ->
+    gen_template names true "jubatus::server::framework::add" [ret_type]
   | _, Pass ->
     gen_template names true "jubatus::server::framework::pass" [ret_type]
   | _, _ ->
@@ -441,41 +443,107 @@ let gen_aggregator names ret_type aggregator =
     raise (Invalid_argument msg)
 ;;
 
+(* Aggregators which reduce results in place without copying them *)
+let gen_inplace_aggregator names ret_type aggregator =
+  match ret_type, aggregator with
+  | List t, Concat ->
+    Some (gen_template names true "jubatus::server::framework::concat_into" [t])
+  | Map (k, v), Merge ->
+    Some (gen_template names true "jubatus::server::framework::merge_into"
+            [k; v])
+  | _, _ ->
+    None
+;;
+
 let gen_aggregator_function names ret_type aggregator =
-  let agg = gen_aggregator names ret_type aggregator in
   let r = gen_type names true ret_type in
-  (* TODO(unnonouno): Too complicated. Make it simple! *)
-  let func = Printf.sprintf
-    "jubatus::util::lang::function<%s(%s, %s)>" r r r in
-  func ^ "(&" ^ agg ^ ")"
+  match gen_inplace_aggregator names ret_type aggregator with
+  | Some agg ->
+    let func = Printf.sprintf
+      "jubatus::util::lang::function<void(%s&, %s&)>" r r in
+    func ^ "(&" ^ agg ^ ")"
+  | None ->
+    let agg = gen_aggregator names ret_type aggregator in
+    (* TODO(unnonouno): Too complicated. Make it simple! *)
+    let func = Printf.sprintf
+      "jubatus::util::lang::function<%s(%s, %s)>" r r r in
+    func ^ "(&" ^ agg ^ ")"
+;;
+
+(* Aggregators of the best rows, which are merged in partitioned clusters *)
+let gen_top_k_function names ret_type aggregator =
+  match ret_type, aggregator with
+  | List t, Top_k ->
+    Some (gen_template names true "jubatus::server::framework::top_k_into" [t])
+  | List t, Bottom_k ->
+    Some (gen_template names true "jubatus::server::framework::bottom_k_into"
+            [t])
+  | _, (Top_k | Bottom_k) ->
+    let msg = Printf.sprintf
+      "invalid combination of return type and aggretator type: %s and %s"
+      (gen_type names true ret_type) (aggtype_to_string aggregator) in
+    raise (Invalid_argument msg)
+  | _, _ ->
+    None
+;;
+
+(* Requests of analysis methods may be hedged and cached by proxies *)
+let gen_request_kind m =
+  let _, request, _ = get_decorator m in
+  match request with
+  | Analysis -> [ "jubatus::server::framework::proxy::ANALYSIS" ]
+  | Update | Nolock -> []
 ;;
 
 let gen_proxy_register names m ret_type =
   let arg_types = List.map (fun f -> f.field_type) m.method_arguments in
   let method_name_str = gen_string_literal m.method_name in
   let routing, _, agg = get_decorator m in
-  match routing with
-  | Random ->
+  match routing, gen_top_k_function names ret_type agg with
+  | (Random | Cht _), Some agg_func ->
+    (* The last argument is the number of rows to return *)
+    let num = match routing with Cht i -> string_of_int i | _ -> "0" in
+    let arg_strs = List.map (gen_type names true) (ret_type::arg_types) in
+    let func = gen_template_with_strs "k.register_async_top_k" (num::arg_strs) in
+    let r = gen_type names true ret_type in
+    let agg_func = Printf.sprintf
+      "jubatus::util::lang::function<void(%s&, %s&, size_t)>(&%s)" r r agg_func in
+    let call = gen_call func (method_name_str :: agg_func :: gen_request_kind m) in
+    [ (0, call) ]
+
+  | _, Some _ ->
+    raise (Invalid_argument "top_k and bottom_k are only for random and cht")
+
+  | Random, None ->
     let func = gen_template names true "k.register_async_random" (ret_type::arg_types) in
-    let call = gen_call func [method_name_str] in
+    let call = gen_call func (method_name_str :: gen_request_kind m) in
     [ (0, call) ]
 
-  | Cht i ->
+  | Cht i, None ->
     (* When a user use CHT, the first arguemnt is the hashing key *)
     let args = List.tl arg_types in
     let arg_strs = List.map (gen_type names true) (ret_type::args) in
     (* TODO(unnonouno): Is this number really required to be a template argument? *)
     let num = string_of_int i in
     let func = gen_template_with_strs "k.register_async_cht" (num::arg_strs) in
-    let call = gen_call func [method_name_str; gen_aggregator_function names ret_type agg] in
+    let agg_func = gen_aggregator_function names ret_type agg in
+    let call = gen_call func (method_name_str :: agg_func :: gen_request_kind m) in
     [ (0, call) ]
 
-  | Broadcast ->
+  | Broadcast, None ->
     let func = gen_template names true "k.register_async_broadcast" (ret_type::arg_types) in
-    let call = gen_call func [method_name_str; gen_aggregator_function names ret_type agg] in
+    let agg_func = gen_aggregator_function names ret_type agg in
+    let call = gen_call func (method_name_str :: agg_func :: gen_request_kind m) in
+    [ (0, call) ]
+
+  | Split, None ->
+    (* The first argument is a list, split into sub-batches *)
+    let func = gen_template names true "k.register_async_split" (ret_type::arg_types) in
+    let agg_func = gen_aggregator_function names ret_type agg in
+    let call = gen_call func (method_name_str :: agg_func :: gen_request_kind m) in
     [ (0, call) ]
 
-  | Internal -> (* no code generated in proxy *)
+  | Internal, None -> (* no code generated in proxy *)
     []
 ;;
 
@@ -629,7 +697,8 @@ let gen_impl names s =
     ];
     [
       (1,   "bool load(const std::string& id) {");
-      (2,     "JWLOCK_(p_);");
+      (* load_server takes the write lock only while replacing the model *)
+      (2,     "NOLOCK_(p_);");
       (2,     "return get_p()->load(id);");
       (1,   "}");
     ];
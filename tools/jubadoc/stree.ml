@@ -29,12 +29,13 @@ type decl_type = Void | Object | Bool
 
 type field_type = Field of int * decl_type * string * string list
 
-type routing_type = Random | Cht of int | Broadcast | Internal
+type routing_type = Random | Cht of int | Broadcast | Split | Internal
 type reqtype = Update | Analysis | Nolock
 
 (* known_aggregators =
    ["#@all_and"; "#@all_or"; "#@concat"; "#@merge"; "#@ignore";"#@pass"] in  *)
-type aggtype = All_and | All_or | Concat | Merge | Ignore | Pass
+type aggtype =
+    All_and | All_or | Concat | Merge | Add | Top_k | Bottom_k | Ignore | Pass
 
 type decorator_type = Routing of routing_type
 		      | Reqtype of reqtype
@@ -70,6 +71,7 @@ let make_decorator = function
 
   | "#@random"   -> Routing(Random);
   | "#@broadcast" -> Routing(Broadcast);
+  | "#@split"     -> Routing(Split);
   | "#@internal"  -> Routing(Internal);
   | "#@cht"       -> Routing(Cht(2));
 
@@ -77,6 +79,9 @@ let make_decorator = function
   | "#@all_or"   -> Aggtype(All_or);
   | "#@concat"    -> Aggtype(Concat);
   | "#@merge"    -> Aggtype(Merge);
+  | "#@add"       -> Aggtype(Add);
+  | "#@top_k"     -> Aggtype(Top_k);
+  | "#@bottom_k"  -> Aggtype(Bottom_k);
   | "#@ignore"    -> Aggtype(Ignore);
   | "#@pass"      -> Aggtype(Pass);
   | other -> raise (Unknown_type other);;
@@ -91,6 +96,7 @@ let routing_to_string = function
   | Random -> "random";
   | Cht(i) -> "cht("^(string_of_int i)^")";
   | Broadcast -> "broadcast";
+  | Split -> "split";
   | Internal -> "";;
 
 let aggtype_to_string = function
@@ -98,6 +104,9 @@ let aggtype_to_string = function
   | All_or  -> "all_or";
   | Concat  -> "concat";
   | Merge   -> "merge";
+  | Add     -> "add";
+  | Top_k   -> "top_k";
+  | Bottom_k -> "bottom_k";
   | Ignore  -> "ignore"; (* or raise sth? *)
   | Pass -> "pass";;
 